@@ -257,6 +257,21 @@ int unicode_from_utf8(const uint8_t *p, int max_len, const uint8_t **pp)
         *pp = p;
         return c;
     }
+    /* fast path for the 2 and 3 byte sequences */
+    if (c >= 0xc2 && c < 0xe0) {
+        if (max_len >= 2 && (p[0] & 0xc0) == 0x80) {
+            *pp = p + 1;
+            return ((c & 0x1f) << 6) | (p[0] & 0x3f);
+        }
+    } else if (c >= 0xe0 && c < 0xf0) {
+        if (max_len >= 3 && (p[0] & 0xc0) == 0x80 && (p[1] & 0xc0) == 0x80) {
+            c = ((c & 0x0f) << 12) | ((p[0] & 0x3f) << 6) | (p[1] & 0x3f);
+            if (c < 0x800)
+                return -1;
+            *pp = p + 2;
+            return c;
+        }
+    }
     switch(c) {
     case 0xc0: case 0xc1: case 0xc2: case 0xc3:
     case 0xc4: case 0xc5: case 0xc6: case 0xc7:
@@ -303,6 +318,400 @@ int unicode_from_utf8(const uint8_t *p, int max_len, const uint8_t **pp)
     return c;
 }
 
+/* String scanning. The loops are vectorized with SSE2 on x86_64 (always
+   available) and with NEON on AArch64, the tail of the buffers is handled
+   by the scalar code. */
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define USE_SIMD_SSE2
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define USE_SIMD_NEON
+#endif
+
+/* return the number of leading bytes < 0x80 */
+size_t str8_ascii_len(const uint8_t *buf, size_t len)
+{
+    size_t i = 0;
+#if defined(USE_SIMD_SSE2)
+    for(; i + 16 <= len; i += 16) {
+        int m = _mm_movemask_epi8(_mm_loadu_si128((const __m128i *)(buf + i)));
+        if (m != 0)
+            return i + ctz32(m);
+    }
+#elif defined(USE_SIMD_NEON)
+    for(; i + 16 <= len; i += 16) {
+        if (vmaxvq_u8(vld1q_u8(buf + i)) >= 0x80)
+            break;
+    }
+#endif
+    while (i < len && buf[i] < 0x80)
+        i++;
+    return i;
+}
+
+/* return the number of leading characters < 0x80 */
+size_t str16_ascii_len(const uint16_t *buf, size_t len)
+{
+    size_t i = 0;
+#if defined(USE_SIMD_SSE2)
+    const __m128i mask = _mm_set1_epi16(0xff80);
+    for(; i + 8 <= len; i += 8) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(buf + i));
+        int m = _mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(v, mask),
+                                                  _mm_setzero_si128()));
+        if (m != 0xffff)
+            return i + (ctz32(~m) >> 1);
+    }
+#elif defined(USE_SIMD_NEON)
+    for(; i + 8 <= len; i += 8) {
+        if (vmaxvq_u16(vld1q_u16(buf + i)) >= 0x80)
+            break;
+    }
+#endif
+    while (i < len && buf[i] < 0x80)
+        i++;
+    return i;
+}
+
+/* return the number of leading bytes which are printable ASCII
+   characters other than 'sep' and '\\', i.e. the characters of a quoted
+   string which need no processing */
+size_t str8_plain_len(const uint8_t *buf, size_t len, uint8_t sep)
+{
+    size_t i = 0;
+#if defined(USE_SIMD_SSE2)
+    const __m128i vsep = _mm_set1_epi8(sep);
+    const __m128i vbs = _mm_set1_epi8('\\');
+    const __m128i vsp = _mm_set1_epi8(0x20);
+    for(; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(buf + i));
+        /* signed compare: also true for the bytes >= 0x80 */
+        __m128i m = _mm_or_si128(_mm_cmplt_epi8(v, vsp),
+                                 _mm_or_si128(_mm_cmpeq_epi8(v, vsep),
+                                              _mm_cmpeq_epi8(v, vbs)));
+        int mask = _mm_movemask_epi8(m);
+        if (mask != 0)
+            return i + ctz32(mask);
+    }
+#elif defined(USE_SIMD_NEON)
+    const uint8x16_t vsep = vdupq_n_u8(sep);
+    const uint8x16_t vbs = vdupq_n_u8('\\');
+    for(; i + 16 <= len; i += 16) {
+        uint8x16_t v = vld1q_u8(buf + i);
+        uint8x16_t m = vorrq_u8(vorrq_u8(vcltq_u8(v, vdupq_n_u8(0x20)),
+                                         vcgeq_u8(v, vdupq_n_u8(0x80))),
+                                vorrq_u8(vceqq_u8(v, vsep), vceqq_u8(v, vbs)));
+        if (vmaxvq_u8(m) != 0)
+            break;
+    }
+#endif
+    while (i < len) {
+        uint8_t c = buf[i];
+        if (c < 0x20 || c >= 0x80 || c == sep || c == '\\')
+            break;
+        i++;
+    }
+    return i;
+}
+
+/* dst[i] = src[i]. The copy is done from the end so that a buffer can
+   be widened in place (dst == src). */
+void str8_to_str16(uint16_t *dst, const uint8_t *src, size_t len)
+{
+    size_t i = len;
+#if defined(USE_SIMD_SSE2)
+    const __m128i zero = _mm_setzero_si128();
+    for(; i >= 16; i -= 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + i - 16));
+        _mm_storeu_si128((__m128i *)(dst + i - 16), _mm_unpacklo_epi8(v, zero));
+        _mm_storeu_si128((__m128i *)(dst + i - 8), _mm_unpackhi_epi8(v, zero));
+    }
+#elif defined(USE_SIMD_NEON)
+    for(; i >= 16; i -= 16) {
+        uint8x16_t v = vld1q_u8(src + i - 16);
+        vst1q_u16(dst + i - 16, vmovl_u8(vget_low_u8(v)));
+        vst1q_u16(dst + i - 8, vmovl_u8(vget_high_u8(v)));
+    }
+#endif
+    while (i-- > 0)
+        dst[i] = src[i];
+}
+
+/* dst[i] = src[i]. The characters must be < 0x100. */
+void str16_to_str8(uint8_t *dst, const uint16_t *src, size_t len)
+{
+    size_t i = 0;
+#if defined(USE_SIMD_SSE2)
+    for(; i + 16 <= len; i += 16) {
+        __m128i v0 = _mm_loadu_si128((const __m128i *)(src + i));
+        __m128i v1 = _mm_loadu_si128((const __m128i *)(src + i + 8));
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_packus_epi16(v0, v1));
+    }
+#elif defined(USE_SIMD_NEON)
+    for(; i + 16 <= len; i += 16) {
+        vst1q_u8(dst + i, vcombine_u8(vmovn_u16(vld1q_u16(src + i)),
+                                      vmovn_u16(vld1q_u16(src + i + 8))));
+    }
+#endif
+    for(; i < len; i++)
+        dst[i] = src[i];
+}
+
+/* return the number of bytes >= 0x80 */
+size_t str8_count_non_ascii(const uint8_t *buf, size_t len)
+{
+    size_t i = 0, count = 0;
+#if defined(USE_SIMD_SSE2)
+    for(; i + 16 <= len; i += 16) {
+        int m = _mm_movemask_epi8(_mm_loadu_si128((const __m128i *)(buf + i)));
+        count += __builtin_popcount(m);
+    }
+#elif defined(USE_SIMD_NEON)
+    for(; i + 16 <= len; i += 16) {
+        count += vaddvq_u8(vshrq_n_u8(vld1q_u8(buf + i), 7));
+    }
+#endif
+    for(; i < len; i++)
+        count += buf[i] >> 7;
+    return count;
+}
+
+/* UTF-8 conversion. The ASCII runs are handled with the string scanning
+   functions above. */
+
+static inline int utf8_max_len(size_t len)
+{
+    return len < UTF8_CHAR_LEN_MAX ? len : UTF8_CHAR_LEN_MAX;
+}
+
+/* Check that 'buf' is valid UTF-8 for unicode_from_utf8() with code
+   points <= 0x10FFFF. Return -1 if not. Otherwise return 0, the number of
+   UTF-16 code units in *plen16 and in *pis_wide whether a code point is
+   >= 0x100. */
+int utf8_scan(const uint8_t *buf, size_t len, size_t *plen16, BOOL *pis_wide)
+{
+    const uint8_t *p = buf, *p_end = buf + len;
+    size_t len16 = 0, l;
+    int c, c_or = 0;
+
+    while (p < p_end) {
+        if (*p < 0x80) {
+            l = str8_ascii_len(p, p_end - p);
+            p += l;
+            len16 += l;
+        } else {
+            c = unicode_from_utf8(p, utf8_max_len(p_end - p), &p);
+            if (c < 0 || c > 0x10FFFF)
+                return -1;
+            c_or |= c;
+            len16 += 1 + (c >= 0x10000);
+        }
+    }
+    *plen16 = len16;
+    *pis_wide = (c_or >= 0x100);
+    return 0;
+}
+
+/* Decode the UTF-8 buffer 'src' which must have been accepted by
+   utf8_scan() with no code point >= 0x100. */
+void utf8_decode_str8(uint8_t *dst, const uint8_t *src, size_t len)
+{
+    const uint8_t *p = src, *p_end = src + len;
+    size_t l;
+
+    while (p < p_end) {
+        if (*p < 0x80) {
+            l = str8_ascii_len(p, p_end - p);
+            memcpy(dst, p, l);
+            dst += l;
+            p += l;
+        } else {
+            /* only 2 byte sequences */
+            *dst++ = ((p[0] & 0x1f) << 6) | (p[1] & 0x3f);
+            p += 2;
+        }
+    }
+}
+
+/* Decode the UTF-8 buffer 'src' which must have been accepted by
+   utf8_scan(), hence the sequences are not checked again. The code points
+   >= 0x10000 are stored as surrogate pairs. */
+void utf8_decode_str16(uint16_t *dst, const uint8_t *src, size_t len)
+{
+    const uint8_t *p = src, *p_end = src + len;
+    size_t l;
+    int c;
+
+    while (p < p_end) {
+        c = *p;
+        if (c < 0x80) {
+            l = str8_ascii_len(p, p_end - p);
+            str8_to_str16(dst, p, l);
+            dst += l;
+            p += l;
+        } else if (c < 0xe0) {
+            *dst++ = ((c & 0x1f) << 6) | (p[1] & 0x3f);
+            p += 2;
+        } else if (c < 0xf0) {
+            *dst++ = ((c & 0x0f) << 12) | ((p[1] & 0x3f) << 6) | (p[2] & 0x3f);
+            p += 3;
+        } else {
+            c = ((c & 0x07) << 18) | ((p[1] & 0x3f) << 12) |
+                ((p[2] & 0x3f) << 6) | (p[3] & 0x3f);
+            p += 4;
+            c -= 0x10000;
+            *dst++ = (c >> 10) + 0xd800;
+            *dst++ = (c & 0x3ff) + 0xdc00;
+        }
+    }
+}
+
+/* Encode the 8 bit characters of 'src' to UTF-8. 'dst' must have room
+   for len + str8_count_non_ascii(src, len) bytes. Return the number of
+   bytes written. */
+size_t utf8_encode_str8(uint8_t *dst, const uint8_t *src, size_t len)
+{
+    uint8_t *q = dst;
+    size_t i = 0, l;
+    int c;
+
+    while (i < len) {
+        c = src[i];
+        if (c < 0x80) {
+            l = str8_ascii_len(src + i, len - i);
+            memcpy(q, src + i, l);
+            q += l;
+            i += l;
+        } else {
+            *q++ = (c >> 6) | 0xc0;
+            *q++ = (c & 0x3f) | 0x80;
+            i++;
+        }
+    }
+    return q - dst;
+}
+
+/* Encode the UTF-16 characters of 'src' to UTF-8. 'dst' must have room
+   for 3 * len bytes. The unmatched surrogates are kept. If 'cesu8' is
+   TRUE, the surrogate pairs are encoded separately. Return the number of
+   bytes written. */
+size_t utf8_encode_str16(uint8_t *dst, const uint16_t *src, size_t len,
+                         BOOL cesu8)
+{
+    uint8_t *q = dst;
+    size_t i = 0, l;
+    int c, c1;
+
+    while (i < len) {
+        c = src[i];
+        if (c < 0x80) {
+            l = str16_ascii_len(src + i, len - i);
+            str16_to_str8(q, src + i, l);
+            q += l;
+            i += l;
+            continue;
+        }
+        i++;
+        if (c < 0x800) {
+            *q++ = (c >> 6) | 0xc0;
+            *q++ = (c & 0x3f) | 0x80;
+            continue;
+        }
+        if (c >= 0xd800 && c < 0xdc00 && i < len && !cesu8) {
+            c1 = src[i];
+            if (c1 >= 0xdc00 && c1 < 0xe000) {
+                i++;
+                /* surrogate pair */
+                c = (((c & 0x3ff) << 10) | (c1 & 0x3ff)) + 0x10000;
+                *q++ = (c >> 18) | 0xf0;
+                *q++ = ((c >> 12) & 0x3f) | 0x80;
+                *q++ = ((c >> 6) & 0x3f) | 0x80;
+                *q++ = (c & 0x3f) | 0x80;
+                continue;
+            }
+        }
+        *q++ = (c >> 12) | 0xe0;
+        *q++ = ((c >> 6) & 0x3f) | 0x80;
+        *q++ = (c & 0x3f) | 0x80;
+    }
+    return q - dst;
+}
+
+/* return the index of the first character equal to c or len if none */
+size_t str16_chr(const uint16_t *buf, size_t len, uint16_t c)
+{
+    size_t i = 0;
+#if defined(USE_SIMD_SSE2)
+    const __m128i vc = _mm_set1_epi16(c);
+    for(; i + 8 <= len; i += 8) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(buf + i));
+        int m = _mm_movemask_epi8(_mm_cmpeq_epi16(v, vc));
+        if (m != 0)
+            return i + (ctz32(m) >> 1);
+    }
+#elif defined(USE_SIMD_NEON)
+    const uint16x8_t vc = vdupq_n_u16(c);
+    for(; i + 8 <= len; i += 8) {
+        if (vmaxvq_u16(vceqq_u16(vld1q_u16(buf + i), vc)) != 0)
+            break;
+    }
+#endif
+    while (i < len && buf[i] != c)
+        i++;
+    return i;
+}
+
+/* return the index of the first difference or len if none */
+size_t str16_mismatch(const uint16_t *a, const uint16_t *b, size_t len)
+{
+    size_t i = 0;
+#if defined(USE_SIMD_SSE2)
+    for(; i + 8 <= len; i += 8) {
+        __m128i va = _mm_loadu_si128((const __m128i *)(a + i));
+        __m128i vb = _mm_loadu_si128((const __m128i *)(b + i));
+        int m = _mm_movemask_epi8(_mm_cmpeq_epi16(va, vb));
+        if (m != 0xffff)
+            return i + (ctz32(~m) >> 1);
+    }
+#elif defined(USE_SIMD_NEON)
+    for(; i + 8 <= len; i += 8) {
+        if (vminvq_u16(vceqq_u16(vld1q_u16(a + i), vld1q_u16(b + i))) == 0)
+            break;
+    }
+#endif
+    while (i < len && a[i] == b[i])
+        i++;
+    return i;
+}
+
+/* same as str16_mismatch() with a buffer of 8 bit characters */
+size_t str16_8_mismatch(const uint16_t *a, const uint8_t *b, size_t len)
+{
+    size_t i = 0;
+#if defined(USE_SIMD_SSE2)
+    const __m128i zero = _mm_setzero_si128();
+    for(; i + 8 <= len; i += 8) {
+        __m128i va = _mm_loadu_si128((const __m128i *)(a + i));
+        __m128i vb = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(b + i)),
+                                       zero);
+        int m = _mm_movemask_epi8(_mm_cmpeq_epi16(va, vb));
+        if (m != 0xffff)
+            return i + (ctz32(~m) >> 1);
+    }
+#elif defined(USE_SIMD_NEON)
+    for(; i + 8 <= len; i += 8) {
+        uint16x8_t vb = vmovl_u8(vld1_u8(b + i));
+        if (vminvq_u16(vceqq_u16(vld1q_u16(a + i), vb)) == 0)
+            break;
+    }
+#endif
+    while (i < len && a[i] == b[i])
+        i++;
+    return i;
+}
+
 #if 0
 
 #if defined(EMSCRIPTEN) || defined(__ANDROID__)
@@ -629,3 +1038,213 @@ void rqsort(void *base, size_t nmemb, size_t size, cmp_f cmp, void *opaque)
 }
 
 #endif
+
+/* stable merge sort */
+
+#define RMSORT_MIN_RUN 32
+
+typedef struct {
+    size_t start;
+    size_t len;
+} rmsort_run;
+
+typedef struct {
+    uint8_t *base;
+    size_t size;
+    int (*cmp)(const void *, const void *, void *);
+    void *opaque;
+    uint8_t *tmp;
+} rmsort_state;
+
+#define RMSORT_ELT(s, i) ((s)->base + (i) * (s)->size)
+
+/* sort [start, n[ assuming that [0, start[ is sorted */
+static void rmsort_insertion(rmsort_state *s, size_t lo, size_t n,
+                             size_t start)
+{
+    size_t i, l, h, m, size = s->size;
+
+    for(i = start; i < n; i++) {
+        memcpy(s->tmp, RMSORT_ELT(s, lo + i), size);
+        /* position after the elements which compare equal */
+        l = 0;
+        h = i;
+        while (l < h) {
+            m = (l + h) >> 1;
+            if (s->cmp(s->tmp, RMSORT_ELT(s, lo + m), s->opaque) < 0)
+                h = m;
+            else
+                l = m + 1;
+        }
+        memmove(RMSORT_ELT(s, lo + l + 1), RMSORT_ELT(s, lo + l),
+                (i - l) * size);
+        memcpy(RMSORT_ELT(s, lo + l), s->tmp, size);
+    }
+}
+
+/* return the length of the run starting at 'lo'. A strictly descending
+   run is reversed. */
+static size_t rmsort_count_run(rmsort_state *s, size_t lo, size_t n)
+{
+    size_t i, j, size = s->size;
+
+    if (n < 2)
+        return n;
+    i = 2;
+    if (s->cmp(RMSORT_ELT(s, lo + 1), RMSORT_ELT(s, lo), s->opaque) < 0) {
+        while (i < n && s->cmp(RMSORT_ELT(s, lo + i),
+                               RMSORT_ELT(s, lo + i - 1), s->opaque) < 0)
+            i++;
+        for(j = 0; j < i / 2; j++) {
+            memcpy(s->tmp, RMSORT_ELT(s, lo + j), size);
+            memcpy(RMSORT_ELT(s, lo + j), RMSORT_ELT(s, lo + i - 1 - j), size);
+            memcpy(RMSORT_ELT(s, lo + i - 1 - j), s->tmp, size);
+        }
+    } else {
+        while (i < n && s->cmp(RMSORT_ELT(s, lo + i),
+                               RMSORT_ELT(s, lo + i - 1), s->opaque) >= 0)
+            i++;
+    }
+    return i;
+}
+
+/* merge the adjacent sorted ranges [lo, lo + la[ and [lo + la, lo + la + lb[ */
+static void rmsort_merge(rmsort_state *s, size_t lo, size_t la, size_t lb)
+{
+    size_t l, h, m, i, j, k, size = s->size;
+    uint8_t *mid;
+
+    mid = RMSORT_ELT(s, lo + la);
+    if (s->cmp(mid - size, mid, s->opaque) <= 0)
+        return; /* already in order */
+    /* the elements of the first range not greater than the first
+       element of the second one are in place */
+    l = 0;
+    h = la;
+    while (l < h) {
+        m = (l + h) >> 1;
+        if (s->cmp(mid, RMSORT_ELT(s, lo + m), s->opaque) < 0)
+            h = m;
+        else
+            l = m + 1;
+    }
+    lo += l;
+    la -= l;
+    /* the elements of the second range not less than the last element
+       of the first one are in place */
+    l = 0;
+    h = lb;
+    while (l < h) {
+        m = (l + h) >> 1;
+        if (s->cmp(RMSORT_ELT(s, lo + la + m), mid - size, s->opaque) < 0)
+            l = m + 1;
+        else
+            h = m;
+    }
+    lb = l;
+    if (la == 0 || lb == 0)
+        return;
+
+    if (la <= lb) {
+        /* merge from the start, the first range is saved */
+        memcpy(s->tmp, RMSORT_ELT(s, lo), la * size);
+        i = 0;
+        j = lo + la;
+        k = lo;
+        while (i < la && j < lo + la + lb) {
+            if (s->cmp(RMSORT_ELT(s, j), s->tmp + i * size, s->opaque) < 0) {
+                memcpy(RMSORT_ELT(s, k), RMSORT_ELT(s, j), size);
+                j++;
+            } else {
+                memcpy(RMSORT_ELT(s, k), s->tmp + i * size, size);
+                i++;
+            }
+            k++;
+        }
+        memcpy(RMSORT_ELT(s, k), s->tmp + i * size, (la - i) * size);
+    } else {
+        /* merge from the end, the second range is saved */
+        memcpy(s->tmp, RMSORT_ELT(s, lo + la), lb * size);
+        i = la;
+        j = lb;
+        k = lo + la + lb;
+        while (i > 0 && j > 0) {
+            k--;
+            if (s->cmp(s->tmp + (j - 1) * size, RMSORT_ELT(s, lo + i - 1),
+                       s->opaque) < 0) {
+                memcpy(RMSORT_ELT(s, k), RMSORT_ELT(s, lo + i - 1), size);
+                i--;
+            } else {
+                memcpy(RMSORT_ELT(s, k), s->tmp + (j - 1) * size, size);
+                j--;
+            }
+        }
+        memcpy(RMSORT_ELT(s, lo), s->tmp, j * size);
+    }
+}
+
+/* Stable and adaptive merge sort in the style of TimSort, without the
+   galloping mode: the natural runs are extended to RMSORT_MIN_RUN
+   elements with a binary insertion sort and merged so that the run
+   lengths stay balanced. 'tmp' must hold max(nmemb / 2, 1) elements.
+   Reading out of the array bounds cannot happen even if 'cmp' is not
+   consistent. */
+void rmsort(void *base, size_t nmemb, size_t size,
+            int (*cmp)(const void *, const void *, void *),
+            void *arg, void *tmp)
+{
+    /* enough for 2^64 elements since the lengths grow at least like the
+       Fibonacci numbers */
+    rmsort_run stack[96];
+    rmsort_state s_s, *s = &s_s;
+    size_t lo, len, force;
+    int sp, n;
+
+    if (nmemb < 2)
+        return;
+    s->base = base;
+    s->size = size;
+    s->cmp = cmp;
+    s->opaque = arg;
+    s->tmp = tmp;
+    sp = 0;
+    for(lo = 0; lo < nmemb; lo += len) {
+        len = rmsort_count_run(s, lo, nmemb - lo);
+        if (len < RMSORT_MIN_RUN) {
+            force = nmemb - lo;
+            if (force > RMSORT_MIN_RUN)
+                force = RMSORT_MIN_RUN;
+            rmsort_insertion(s, lo, force, len);
+            len = force;
+        }
+        stack[sp].start = lo;
+        stack[sp].len = len;
+        sp++;
+        /* merge while the invariants are not satisfied */
+        while (sp > 1) {
+            n = sp - 2;
+            if ((n > 0 && stack[n - 1].len <= stack[n].len + stack[n + 1].len) ||
+                (n > 1 && stack[n - 2].len <= stack[n - 1].len + stack[n].len)) {
+                if (stack[n - 1].len < stack[n + 1].len)
+                    n--;
+            } else if (stack[n].len > stack[n + 1].len) {
+                break;
+            }
+            rmsort_merge(s, stack[n].start, stack[n].len, stack[n + 1].len);
+            stack[n].len += stack[n + 1].len;
+            if (n + 2 < sp)
+                stack[n + 1] = stack[n + 2];
+            sp--;
+        }
+    }
+    while (sp > 1) {
+        n = sp - 2;
+        if (n > 0 && stack[n - 1].len < stack[n + 1].len)
+            n--;
+        rmsort_merge(s, stack[n].start, stack[n].len, stack[n + 1].len);
+        stack[n].len += stack[n + 1].len;
+        if (n + 2 < sp)
+            stack[n + 1] = stack[n + 2];
+        sp--;
+    }
+}
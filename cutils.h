@@ -278,6 +278,22 @@ static inline void dbuf_set_error(DynBuf *s)
 int unicode_to_utf8(uint8_t *buf, unsigned int c);
 int unicode_from_utf8(const uint8_t *p, int max_len, const uint8_t **pp);
 
+size_t str8_ascii_len(const uint8_t *buf, size_t len);
+size_t str16_ascii_len(const uint16_t *buf, size_t len);
+size_t str8_plain_len(const uint8_t *buf, size_t len, uint8_t sep);
+void str8_to_str16(uint16_t *dst, const uint8_t *src, size_t len);
+void str16_to_str8(uint8_t *dst, const uint16_t *src, size_t len);
+size_t str16_chr(const uint16_t *buf, size_t len, uint16_t c);
+size_t str8_count_non_ascii(const uint8_t *buf, size_t len);
+int utf8_scan(const uint8_t *buf, size_t len, size_t *plen16, BOOL *pis_wide);
+void utf8_decode_str8(uint8_t *dst, const uint8_t *src, size_t len);
+void utf8_decode_str16(uint16_t *dst, const uint8_t *src, size_t len);
+size_t utf8_encode_str8(uint8_t *dst, const uint8_t *src, size_t len);
+size_t utf8_encode_str16(uint8_t *dst, const uint16_t *src, size_t len,
+                         BOOL cesu8);
+size_t str16_mismatch(const uint16_t *a, const uint16_t *b, size_t len);
+size_t str16_8_mismatch(const uint16_t *a, const uint8_t *b, size_t len);
+
 static inline int from_hex(int c)
 {
     if (c >= '0' && c <= '9')
@@ -293,5 +309,8 @@ static inline int from_hex(int c)
 void rqsort(void *base, size_t nmemb, size_t size,
             int (*cmp)(const void *, const void *, void *),
             void *arg);
+void rmsort(void *base, size_t nmemb, size_t size,
+            int (*cmp)(const void *, const void *, void *),
+            void *arg, void *tmp);
 
 #endif  /* CUTILS_H */
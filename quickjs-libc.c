@@ -3899,14 +3899,9 @@ void js_std_loop(JSContext *ctx)
 
     for(;;) {
         /* execute the pending jobs */
-        for(;;) {
-            err = JS_ExecutePendingJob(JS_GetRuntime(ctx), &ctx1);
-            if (err <= 0) {
-                if (err < 0) {
-                    js_std_dump_error(ctx1);
-                }
-                break;
-            }
+        err = JS_ExecutePendingJobs(JS_GetRuntime(ctx), -1, &ctx1);
+        if (err < 0) {
+            js_std_dump_error(ctx1);
         }
 
         if (!os_poll_func || os_poll_func(ctx))
@@ -105,6 +105,7 @@ DEF(      tail_call, 3, 1, 0, npop) /* arguments are not counted in n_pop */
 DEF(    call_method, 3, 2, 1, npop) /* arguments are not counted in n_pop */
 DEF(tail_call_method, 3, 2, 0, npop) /* arguments are not counted in n_pop */
 DEF(     array_from, 3, 0, 1, npop) /* arguments are not counted in n_pop */
+DEF(    object_from, 3, 1, 1, npop) /* values template -> obj. values are not counted in n_pop */
 DEF(          apply, 3, 3, 1, u16)
 DEF(         return, 1, 1, 0, none)
 DEF(   return_undef, 1, 0, 0, none)
@@ -360,6 +361,22 @@ DEF(typeof_is_undefined, 1, 1, 1, none)
 DEF( typeof_is_function, 1, 1, 1, none)
 #endif
 
+/* 'arguments.length' and 'arguments[i]' when the arguments object is
+   not created */
+DEF(get_arguments_length, 1, 0, 1, none)
+DEF(get_arguments_el, 1, 1, 1, none)
+
+/* get_field, get_field2 and put_field with an inline cache, the operand
+   is the index of the cache which holds the atom. Never serialized. */
+DEF(   get_field_ic, 5, 1, 1, u32) /* must come first */
+DEF(  get_field2_ic, 5, 1, 2, u32)
+DEF(   put_field_ic, 5, 2, 0, u32)
+/* get_var, get_var_undef, put_var and put_var_strict with a global
+   variable cache, the operand is the index of the cache */
+DEF(     get_var_ic, 5, 0, 1, u32)
+DEF(     put_var_ic, 5, 1, 0, u32)
+DEF(put_var_strict_ic, 5, 2, 0, u32) /* must come last */
+
 #undef DEF
 #undef def
 #endif  /* DEF */
@@ -48,7 +48,11 @@
 #include "libbf.h"
 #endif
 
-#define OPTIMIZE         1
+/* 0 = no bytecode optimization, 1 = peephole optimizations, 2 = also
+   constant folding and removal of redundant TDZ checks */
+#ifndef OPTIMIZE
+#define OPTIMIZE         2
+#endif
 #define SHORT_OPCODES    1
 #if defined(EMSCRIPTEN)
 #define DIRECT_DISPATCH  0
@@ -203,6 +207,24 @@ typedef enum JSErrorEnum {
 #define JS_MAX_LOCAL_VARS 65536
 #define JS_STACK_SIZE_MAX 65534
 #define JS_STRING_LEN_MAX ((1 << 30) - 1)
+/* number of cached two character strings */
+#define JS_CHAR2_CACHE_SIZE 256
+
+/* number of object shapes remembered by JSON.parse */
+#define JSON_SHAPE_CACHE_SIZE 16
+
+/* arguments stored in the job queue entries */
+#define JS_JOB_INLINE_ARGS 5
+/* the job queue is not shrunk below this size */
+#define JS_JOB_QUEUE_MAX_IDLE_SIZE 256
+/* the job queue is halved after this number of drains using less than a
+   quarter of it */
+#define JS_JOB_QUEUE_SHRINK_DRAINS 16
+
+/* GC object allocations between two young collections */
+#define JS_GC_YOUNG_THRESHOLD 8192
+/* number of GC pauses kept for the statistics */
+#define JS_GC_PAUSE_SAMPLES 256
 
 #define __exception __attribute__((warn_unused_result))
 
@@ -216,6 +238,14 @@ typedef enum {
     JS_GC_PHASE_REMOVE_CYCLES,
 } JSGCPhaseEnum;
 
+/* Values of JSGCObjectHeader.mark. Only the objects of gc_obj_list are
+   collected: the other ones keep mark = 0 and their references to the
+   collected objects are handled like external references. */
+#define GC_MARK_NONE    0 /* not collected or outside of a collection */
+#define GC_MARK_DECREF  1 /* the children have been decremented */
+#define GC_MARK_PENDING 2 /* collected, not processed yet */
+#define GC_MARK_LIVE    3 /* reachable from outside the collected objects */
+
 typedef enum OPCodeEnum OPCodeEnum;
 
 #ifdef CONFIG_BIGNUM
@@ -258,14 +288,31 @@ struct JSRuntime {
     /* list of JSGCObjectHeader.link. List of allocated GC objects (used
        by the garbage collector) */
     struct list_head gc_obj_list;
+    /* list of JSGCObjectHeader.link. GC objects allocated since the last
+       collection. They are moved to gc_obj_list by the next one. */
+    struct list_head gc_young_obj_list;
+    int gc_young_alloc_count; /* GC objects allocated since the last collection */
+    int gc_young_threshold; /* 0 if no young collection */
     /* list of JSGCObjectHeader.link. Used during JS_FreeValueRT() */
     struct list_head gc_zero_ref_count_list;
     struct list_head tmp_obj_list; /* used during GC */
     JSGCPhaseEnum gc_phase : 8;
     size_t malloc_gc_threshold;
+    /* native memory owned by JS objects but allocated outside of
+       js_malloc(), see JS_AdjustExternalMemory() */
+    int64_t external_memory_size;
+    /* GC statistics */
+    int64_t gc_count;
+    int64_t gc_young_count;
+    int64_t gc_pause_max; /* in microseconds */
+    uint32_t gc_pause_samples[JS_GC_PAUSE_SAMPLES]; /* last pauses in microseconds */
 #ifdef DUMP_LEAKS
     struct list_head string_list; /* list of JSString.link */
 #endif
+    /* strings of one 8 bit character, allocated on first use, and
+       direct mapped cache of strings of two 8 bit characters */
+    JSString *char_strings[256];
+    JSString *char2_strings[JS_CHAR2_CACHE_SIZE];
     /* stack limitation */
     uintptr_t stack_size; /* in bytes, 0 if no limit */
     uintptr_t stack_top;
@@ -283,7 +330,13 @@ struct JSRuntime {
     JSHostPromiseRejectionTracker *host_promise_rejection_tracker;
     void *host_promise_rejection_tracker_opaque;
 
-    struct list_head job_list; /* list of JSJobEntry.link */
+    /* circular queue of the pending jobs */
+    struct JSJobEntry *job_queue;
+    uint32_t job_queue_size; /* 0 or a power of two */
+    uint32_t job_head; /* index of the first pending job */
+    uint32_t job_count;
+    uint32_t job_count_max; /* max job_count since the queue was empty */
+    uint32_t job_queue_idle_drains;
 
     JSModuleNormalizeFunc *module_normalize_func;
     JSModuleLoaderFunc *module_loader_func;
@@ -298,6 +351,9 @@ struct JSRuntime {
     int shape_hash_size;
     int shape_hash_count; /* number of hashed shapes */
     JSShape **shape_hash;
+    /* incremented when the shape of a global object is modified. 64
+       bits so that it never wraps around to a version still cached */
+    uint64_t global_var_version;
 #ifdef CONFIG_BIGNUM
     bf_context_t bf_ctx;
     JSNumericOperations bigint_ops;
@@ -424,6 +480,9 @@ struct JSContext {
     int binary_object_size;
 
     JSShape *array_shape;   /* initial shape for Array objects */
+    /* shapes of the last objects created by JSON.parse, see
+       json_build_object() */
+    JSShape *json_shapes[JSON_SHAPE_CACHE_SIZE];
 
     JSValue *class_proto;
     JSValue function_proto;
@@ -587,6 +646,40 @@ typedef enum JSFunctionKindEnum {
     JS_FUNC_ASYNC_GENERATOR = (JS_FUNC_GENERATOR | JS_FUNC_ASYNC),
 } JSFunctionKindEnum;
 
+/* Inline cache of a get_field, get_field2 or put_field instruction. A
+   way matches when the receiver has the cached shape and, if the
+   property is found in the prototype, when the prototype still has the
+   cached prototype shape. Only hashed shapes are cached: since the cache
+   holds a reference to them, a modification of the object (new or
+   deleted property, flag or prototype change) gives it a new shape
+   instead of modifying the cached one. */
+#define JS_PROP_IC_WAYS 4
+#define JS_PROP_IC_MAX_MISSES 32
+
+typedef struct JSPropertyICWay {
+    JSShape *shape; /* shape of the receiver */
+    JSShape *proto_shape; /* shape of the prototype holding the property or NULL */
+    uint32_t prop_idx;
+} JSPropertyICWay;
+
+typedef struct JSPropertyIC {
+    JSAtom atom;
+    uint8_t way_count;
+    uint8_t miss_count; /* the cache is no longer updated after JS_PROP_IC_MAX_MISSES */
+    JSPropertyICWay ways[JS_PROP_IC_WAYS];
+} JSPropertyIC;
+
+/* Cache of a get_var, get_var_undef, put_var or put_var_strict
+   instruction. The property index is valid as long as
+   JSRuntime.global_var_version is unchanged. */
+typedef struct JSGlobalVarIC {
+    uint64_t version; /* 0 if the cache is empty */
+    JSAtom atom;
+    uint32_t prop_idx;
+    uint8_t opcode; /* original opcode */
+    uint8_t is_var_obj; /* TRUE if the property is in global_var_obj */
+} JSGlobalVarIC;
+
 typedef struct JSFunctionBytecode {
     JSGCObjectHeader header; /* must come first */
     uint8_t js_mode;
@@ -617,6 +710,10 @@ typedef struct JSFunctionBytecode {
     JSValue *cpool; /* constant pool (self pointer) */
     int cpool_count;
     int closure_var_count;
+    JSPropertyIC *ic; /* inline caches of the property accesses */
+    int ic_count;
+    JSGlobalVarIC *global_ic; /* caches of the global variable accesses */
+    int global_ic_count;
     struct {
         /* debug info, move to separate structure to save memory? */
         JSAtom filename;
@@ -690,6 +787,9 @@ typedef struct JSAsyncFunctionState {
 typedef struct JSAsyncFunctionData {
     JSGCObjectHeader header; /* must come first */
     JSValue resolving_funcs[2];
+    /* functions resuming the function after 'await', created by the
+       first 'await' (JS_UNDEFINED otherwise) */
+    JSValue resume_funcs[2];
     BOOL is_active; /* true if the async function state is valid */
     JSAsyncFunctionState func_state;
 } JSAsyncFunctionData;
@@ -817,11 +917,11 @@ struct JSModuleDef {
 };
 
 typedef struct JSJobEntry {
-    struct list_head link;
     JSContext *ctx;
     JSJobFunc *job_func;
     int argc;
-    JSValue argv[0];
+    JSValue *ext_argv; /* allocated if argc > JS_JOB_INLINE_ARGS */
+    JSValue argv[JS_JOB_INLINE_ARGS];
 } JSJobEntry;
 
 typedef struct JSProperty {
@@ -843,7 +943,10 @@ typedef struct JSProperty {
 } JSProperty;
 
 #define JS_PROP_INITIAL_SIZE 2
-#define JS_PROP_INITIAL_HASH_SIZE 4 /* must be a power of two */
+#define JS_PROP_INITIAL_HASH_SIZE 16 /* must be a power of two */
+/* shapes with at most this number of allocated properties have no hash
+   table and are searched linearly */
+#define JS_PROP_SMALL_SHAPE_SIZE 8
 #define JS_ARRAY_INITIAL_SIZE 2
 
 typedef struct JSShapeProperty {
@@ -863,6 +966,13 @@ struct JSShape {
        <= n <= 2^31-1. If false, the shape is guaranteed not to have
        small array index properties */
     uint8_t has_small_array_index;
+    /* true if the shape belongs to a global object (such a shape is never
+       hashed). Its modifications increment JSRuntime.global_var_version */
+    uint8_t is_global;
+    /* true if the shape has no hash table (see
+       JS_PROP_SMALL_SHAPE_SIZE). prop_hash_mask then has the bit (atom
+       & 31) set for each property atom. */
+    uint8_t is_small;
     uint32_t hash; /* current hash value */
     uint32_t prop_hash_mask;
     int prop_size; /* allocated properties */
@@ -895,7 +1005,7 @@ struct JSObject {
     JSShape *shape; /* prototype and property names + flag */
     JSProperty *prop; /* array of properties */
     /* byte offsets: 24/40 */
-    struct JSMapRecord *first_weak_ref; /* XXX: use a bit and an external hash table? */
+    struct JSMapWeakRef *first_weak_ref; /* XXX: use a bit and an external hash table? */
     /* byte offsets: 28/48 */
     union {
         void *opaque;
@@ -1142,6 +1252,38 @@ static inline bfdec_t *JS_GetBigDecimal(JSValueConst val)
     return &p->num;
 }
 static JSValue JS_NewBigInt(JSContext *ctx);
+
+#if JS_SHORT_BIG_INT_BITS == 32
+#define JS_SHORT_BIG_INT_MIN INT32_MIN
+#define JS_SHORT_BIG_INT_MAX INT32_MAX
+#else
+#define JS_SHORT_BIG_INT_MIN INT64_MIN
+#define JS_SHORT_BIG_INT_MAX INT64_MAX
+#endif
+
+/* 'v' must be between JS_SHORT_BIG_INT_MIN and JS_SHORT_BIG_INT_MAX */
+static inline JSValue __JS_NewShortBigInt(JSContext *ctx, int64_t v)
+{
+#if JS_SHORT_BIG_INT_BITS == 32
+    return JS_MKVAL(JS_TAG_SHORT_BIG_INT, (int32_t)v);
+#else
+    JSValue val;
+    val.tag = JS_TAG_SHORT_BIG_INT;
+    val.u.short_big_int = v;
+    return val;
+#endif
+}
+
+static inline BOOL js_is_short_big_int(int64_t v)
+{
+    return v >= JS_SHORT_BIG_INT_MIN && v <= JS_SHORT_BIG_INT_MAX;
+}
+
+static inline BOOL tag_is_big_int(uint32_t tag)
+{
+    return tag == JS_TAG_BIG_INT || tag == JS_TAG_SHORT_BIG_INT;
+}
+
 static inline bf_t *JS_GetBigInt(JSValueConst val)
 {
     JSBigFloat *p = JS_VALUE_GET_PTR(val);
@@ -1213,6 +1355,8 @@ static __exception int perform_promise_then(JSContext *ctx,
                                             JSValueConst *cap_resolving_funcs);
 static JSValue js_promise_resolve(JSContext *ctx, JSValueConst this_val,
                                   int argc, JSValueConst *argv, int magic);
+static JSValue promise_reaction_job(JSContext *ctx, int argc,
+                                    JSValueConst *argv);
 static int js_string_compare(JSContext *ctx,
                              const JSString *p1, const JSString *p2);
 static JSValue JS_ToNumber(JSContext *ctx, JSValueConst val);
@@ -1261,29 +1405,50 @@ static JSValue JS_InstantiateFunctionListItem2(JSContext *ctx, JSObject *p,
                                                JSAtom atom, void *opaque);
 void JS_SetUncatchableError(JSContext *ctx, JSValueConst val, BOOL flag);
 
+static inline struct list_head *gc_obj_next(JSRuntime *rt,
+                                            struct list_head *el)
+{
+    el = el->next;
+    if (el == &rt->gc_obj_list)
+        el = rt->gc_young_obj_list.next;
+    return el;
+}
+
+/* iterate over the old and young GC objects */
+#define list_for_each_gc_obj(el, rt)                                \
+    for(el = gc_obj_next(rt, &(rt)->gc_obj_list);                   \
+        el != &(rt)->gc_young_obj_list; el = gc_obj_next(rt, el))
+
 static const JSClassExoticMethods js_arguments_exotic_methods;
 static const JSClassExoticMethods js_string_exotic_methods;
 static const JSClassExoticMethods js_proxy_exotic_methods;
 static const JSClassExoticMethods js_module_ns_exotic_methods;
 static JSClassID js_class_id_alloc = JS_CLASS_INIT_COUNT;
 
+static void gc_run_young(JSRuntime *rt);
+
 static void js_trigger_gc(JSRuntime *rt, size_t size)
 {
     BOOL force_gc;
 #ifdef FORCE_GC_AT_MALLOC
     force_gc = TRUE;
 #else
-    force_gc = ((rt->malloc_state.malloc_size + size) >
-                rt->malloc_gc_threshold);
+    force_gc = ((rt->malloc_state.malloc_size + rt->external_memory_size +
+                 size) > rt->malloc_gc_threshold);
 #endif
     if (force_gc) {
+        size_t used_size;
 #ifdef DUMP_GC
-        printf("GC: size=%" PRIu64 "\n",
-               (uint64_t)rt->malloc_state.malloc_size);
+        printf("GC: size=%" PRIu64 " external=%" PRId64 "\n",
+               (uint64_t)rt->malloc_state.malloc_size,
+               rt->external_memory_size);
 #endif
         JS_RunGC(rt);
-        rt->malloc_gc_threshold = rt->malloc_state.malloc_size +
-            (rt->malloc_state.malloc_size >> 1);
+        used_size = rt->malloc_state.malloc_size + rt->external_memory_size;
+        rt->malloc_gc_threshold = used_size + (used_size >> 1);
+    } else if (rt->gc_young_threshold != 0 &&
+               rt->gc_young_alloc_count >= rt->gc_young_threshold) {
+        gc_run_young(rt);
     }
 }
 
@@ -1292,6 +1457,9 @@ static size_t js_malloc_usable_size_unknown(const void *ptr)
     return 0;
 }
 
+static void *js_def_malloc(JSMallocState *s, size_t size);
+static size_t js_def_slab_usable_size(JSMallocState *s, const void *ptr);
+
 void *js_malloc_rt(JSRuntime *rt, size_t size)
 {
     return rt->mf.js_malloc(&rt->malloc_state, size);
@@ -1309,6 +1477,8 @@ void *js_realloc_rt(JSRuntime *rt, void *ptr, size_t size)
 
 size_t js_malloc_usable_size_rt(JSRuntime *rt, const void *ptr)
 {
+    if (rt->mf.js_malloc == js_def_malloc && rt->malloc_state.opaque)
+        return js_def_slab_usable_size(&rt->malloc_state, ptr);
     return rt->mf.js_malloc_usable_size(ptr);
 }
 
@@ -1636,13 +1806,14 @@ JSRuntime *JS_NewRuntime2(const JSMallocFunctions *mf, void *opaque)
 
     init_list_head(&rt->context_list);
     init_list_head(&rt->gc_obj_list);
+    init_list_head(&rt->gc_young_obj_list);
     init_list_head(&rt->gc_zero_ref_count_list);
     rt->gc_phase = JS_GC_PHASE_NONE;
+    rt->gc_young_threshold = JS_GC_YOUNG_THRESHOLD;
 
 #ifdef DUMP_LEAKS
     init_list_head(&rt->string_list);
 #endif
-    init_list_head(&rt->job_list);
 
     if (JS_InitAtoms(rt))
         goto fail;
@@ -1700,9 +1871,252 @@ static inline size_t js_def_malloc_usable_size(void *ptr)
 #endif
 }
 
+/* Slab allocator used by the default malloc functions for the small
+   blocks (JSObject, JSShape with few properties, short JSString,
+   JSVarRef, small property arrays). Each size class allocates
+   JS_SLAB_CHUNK_SIZE chunks aligned on their size: the chunk of a block
+   is found by masking its address, and a hash table of the chunk
+   addresses tells if a pointer belongs to the slab. The slab is owned by
+   a single runtime, so no locking is needed. */
+#define JS_SLAB_CHUNK_BITS 16
+#define JS_SLAB_CHUNK_SIZE (1 << JS_SLAB_CHUNK_BITS)
+#define JS_SLAB_MAX_SIZE 256
+
+static const uint16_t js_slab_class_size[] = {
+    16, 32, 48, 64, 80, 96, 112, 128, 160, 192, 224, 256,
+};
+
+#define JS_SLAB_CLASS_COUNT countof(js_slab_class_size)
+
+/* size class of a size in units of 16 bytes */
+static const uint8_t js_slab_class_index[JS_SLAB_MAX_SIZE / 16 + 1] = {
+    0, 0, 1, 2, 3, 4, 5, 6, 7, 8, 8, 9, 9, 10, 10, 11, 11,
+};
+
+typedef struct JSSlabChunk {
+    struct list_head link; /* in JSSlabClass.partial_list if not full */
+    void *free_list; /* list of the freed blocks */
+    uint8_t *free_area; /* start of the never allocated blocks */
+    uint8_t *end;
+    int class_idx;
+    int used_count;
+    BOOL is_partial;
+} JSSlabChunk;
+
+typedef struct JSSlabClass {
+    struct list_head partial_list; /* chunks with free blocks */
+} JSSlabClass;
+
+typedef struct JSSlab {
+    JSSlabClass classes[JS_SLAB_CLASS_COUNT];
+    JSSlabChunk **chunk_hash; /* linear probing, NULL if empty */
+    int chunk_hash_bits;
+    int chunk_count;
+} JSSlab;
+
+static void *js_slab_alloc_chunk(void)
+{
+#if defined(_WIN32)
+    return _aligned_malloc(JS_SLAB_CHUNK_SIZE, JS_SLAB_CHUNK_SIZE);
+#else
+    void *ptr;
+    if (posix_memalign(&ptr, JS_SLAB_CHUNK_SIZE, JS_SLAB_CHUNK_SIZE))
+        return NULL;
+    return ptr;
+#endif
+}
+
+static void js_slab_free_chunk(void *ptr)
+{
+#if defined(_WIN32)
+    _aligned_free(ptr);
+#else
+    free(ptr);
+#endif
+}
+
+static inline uint32_t js_slab_hash(const void *chunk, int bits)
+{
+    uint32_t h = (uintptr_t)chunk >> JS_SLAB_CHUNK_BITS;
+    return (h * 0x9e370001) >> (32 - bits);
+}
+
+static JSSlab *js_slab_new(void)
+{
+    JSSlab *slab;
+    int i;
+
+    slab = calloc(1, sizeof(*slab));
+    if (!slab)
+        return NULL;
+    for(i = 0; i < JS_SLAB_CLASS_COUNT; i++)
+        init_list_head(&slab->classes[i].partial_list);
+    slab->chunk_hash_bits = 4;
+    slab->chunk_hash = calloc(1 << slab->chunk_hash_bits,
+                              sizeof(slab->chunk_hash[0]));
+    if (!slab->chunk_hash) {
+        free(slab);
+        return NULL;
+    }
+    return slab;
+}
+
+static void js_slab_free(JSSlab *slab)
+{
+    int i;
+
+    for(i = 0; i < (1 << slab->chunk_hash_bits); i++) {
+        if (slab->chunk_hash[i])
+            js_slab_free_chunk(slab->chunk_hash[i]);
+    }
+    free(slab->chunk_hash);
+    free(slab);
+}
+
+/* return the chunk containing 'ptr' or NULL if not allocated by the slab */
+static inline JSSlabChunk *js_slab_find_chunk(JSSlab *slab, const void *ptr)
+{
+    JSSlabChunk *c, *chunk;
+    uint32_t h, mask;
+
+    chunk = (JSSlabChunk *)((uintptr_t)ptr & ~(uintptr_t)(JS_SLAB_CHUNK_SIZE - 1));
+    mask = (1 << slab->chunk_hash_bits) - 1;
+    for(h = js_slab_hash(chunk, slab->chunk_hash_bits);; h = (h + 1) & mask) {
+        c = slab->chunk_hash[h];
+        if (c == chunk)
+            return c;
+        if (!c)
+            return NULL;
+    }
+}
+
+static void js_slab_hash_insert(JSSlabChunk **tab, int bits, JSSlabChunk *c)
+{
+    uint32_t h, mask = (1 << bits) - 1;
+    for(h = js_slab_hash(c, bits); tab[h]; h = (h + 1) & mask)
+        continue;
+    tab[h] = c;
+}
+
+static int js_slab_hash_add(JSSlab *slab, JSSlabChunk *c)
+{
+    /* keep the load factor below 1/2 */
+    if (2 * (slab->chunk_count + 1) > (1 << slab->chunk_hash_bits)) {
+        JSSlabChunk **tab;
+        int i, bits = slab->chunk_hash_bits + 1;
+        tab = calloc(1 << bits, sizeof(tab[0]));
+        if (!tab)
+            return -1;
+        for(i = 0; i < (1 << slab->chunk_hash_bits); i++) {
+            if (slab->chunk_hash[i])
+                js_slab_hash_insert(tab, bits, slab->chunk_hash[i]);
+        }
+        free(slab->chunk_hash);
+        slab->chunk_hash = tab;
+        slab->chunk_hash_bits = bits;
+    }
+    js_slab_hash_insert(slab->chunk_hash, slab->chunk_hash_bits, c);
+    slab->chunk_count++;
+    return 0;
+}
+
+static void js_slab_hash_remove(JSSlab *slab, JSSlabChunk *c)
+{
+    JSSlabChunk **tab = slab->chunk_hash;
+    uint32_t h, h1, h2, mask = (1 << slab->chunk_hash_bits) - 1;
+
+    for(h = js_slab_hash(c, slab->chunk_hash_bits); tab[h] != c;
+        h = (h + 1) & mask)
+        continue;
+    /* backward shift deletion */
+    for(h1 = (h + 1) & mask; tab[h1]; h1 = (h1 + 1) & mask) {
+        h2 = js_slab_hash(tab[h1], slab->chunk_hash_bits);
+        /* move the entry if its home slot is not in ]h, h1] */
+        if (((h1 - h2) & mask) >= ((h1 - h) & mask)) {
+            tab[h] = tab[h1];
+            h = h1;
+        }
+    }
+    tab[h] = NULL;
+    slab->chunk_count--;
+}
+
+static void *js_slab_malloc(JSSlab *slab, size_t size, size_t *psize)
+{
+    JSSlabClass *cl;
+    JSSlabChunk *c;
+    void *ptr;
+    int class_idx, block_size;
+
+    class_idx = js_slab_class_index[(size + 15) >> 4];
+    block_size = js_slab_class_size[class_idx];
+    cl = &slab->classes[class_idx];
+    if (unlikely(list_empty(&cl->partial_list))) {
+        c = js_slab_alloc_chunk();
+        if (!c)
+            return NULL;
+        if (js_slab_hash_add(slab, c)) {
+            js_slab_free_chunk(c);
+            return NULL;
+        }
+        c->free_list = NULL;
+        c->free_area = (uint8_t *)c + ((sizeof(JSSlabChunk) + 15) & ~15);
+        c->end = (uint8_t *)c + JS_SLAB_CHUNK_SIZE;
+        c->class_idx = class_idx;
+        c->used_count = 0;
+        c->is_partial = TRUE;
+        list_add(&c->link, &cl->partial_list);
+    } else {
+        c = list_entry(cl->partial_list.next, JSSlabChunk, link);
+    }
+    if (c->free_list) {
+        ptr = c->free_list;
+        c->free_list = *(void **)ptr;
+    } else {
+        ptr = c->free_area;
+        c->free_area += block_size;
+    }
+    c->used_count++;
+    if (!c->free_list && c->free_area + block_size > c->end) {
+        list_del(&c->link);
+        c->is_partial = FALSE;
+    }
+    *psize = block_size;
+    return ptr;
+}
+
+static void js_slab_free_block(JSSlab *slab, JSSlabChunk *c, void *ptr)
+{
+    JSSlabClass *cl = &slab->classes[c->class_idx];
+
+    *(void **)ptr = c->free_list;
+    c->free_list = ptr;
+    c->used_count--;
+    if (!c->is_partial) {
+        list_add(&c->link, &cl->partial_list);
+        c->is_partial = TRUE;
+    } else if (c->used_count == 0 &&
+               (cl->partial_list.next != &c->link ||
+                cl->partial_list.prev != &c->link)) {
+        /* release the empty chunk unless it is the last one of its class */
+        list_del(&c->link);
+        js_slab_hash_remove(slab, c);
+        js_slab_free_chunk(c);
+    }
+}
+
+static size_t js_def_slab_usable_size(JSMallocState *s, const void *ptr)
+{
+    JSSlabChunk *c = js_slab_find_chunk(s->opaque, ptr);
+    if (c)
+        return js_slab_class_size[c->class_idx];
+    return js_def_malloc_usable_size((void *)ptr);
+}
+
 static void *js_def_malloc(JSMallocState *s, size_t size)
 {
     void *ptr;
+    size_t block_size;
 
     /* Do not allocate zero bytes: behavior is platform dependent */
     assert(size != 0);
@@ -1710,6 +2124,15 @@ static void *js_def_malloc(JSMallocState *s, size_t size)
     if (unlikely(s->malloc_size + size > s->malloc_limit))
         return NULL;
 
+    if (size <= JS_SLAB_MAX_SIZE && s->opaque) {
+        ptr = js_slab_malloc(s->opaque, size, &block_size);
+        if (ptr) {
+            s->malloc_count++;
+            s->malloc_size += block_size;
+            return ptr;
+        }
+    }
+
     ptr = malloc(size);
     if (!ptr)
         return NULL;
@@ -1721,10 +2144,20 @@ static void *js_def_malloc(JSMallocState *s, size_t size)
 
 static void js_def_free(JSMallocState *s, void *ptr)
 {
+    JSSlabChunk *c;
+
     if (!ptr)
         return;
 
     s->malloc_count--;
+    if (s->opaque) {
+        c = js_slab_find_chunk(s->opaque, ptr);
+        if (c) {
+            s->malloc_size -= js_slab_class_size[c->class_idx];
+            js_slab_free_block(s->opaque, c, ptr);
+            return;
+        }
+    }
     s->malloc_size -= js_def_malloc_usable_size(ptr) + MALLOC_OVERHEAD;
     free(ptr);
 }
@@ -1732,12 +2165,34 @@ static void js_def_free(JSMallocState *s, void *ptr)
 static void *js_def_realloc(JSMallocState *s, void *ptr, size_t size)
 {
     size_t old_size;
+    JSSlabChunk *c;
+    void *new_ptr;
 
     if (!ptr) {
         if (size == 0)
             return NULL;
         return js_def_malloc(s, size);
     }
+    c = NULL;
+    if (s->opaque)
+        c = js_slab_find_chunk(s->opaque, ptr);
+    if (c) {
+        old_size = js_slab_class_size[c->class_idx];
+        if (size == 0) {
+            js_def_free(s, ptr);
+            return NULL;
+        }
+        if (size <= JS_SLAB_MAX_SIZE &&
+            js_slab_class_index[(size + 15) >> 4] == c->class_idx)
+            return ptr;
+        new_ptr = js_def_malloc(s, size);
+        if (!new_ptr)
+            return NULL;
+        memcpy(new_ptr, ptr, min_int(old_size, size));
+        js_def_free(s, ptr);
+        return new_ptr;
+    }
+
     old_size = js_def_malloc_usable_size(ptr);
     if (size == 0) {
         s->malloc_count--;
@@ -1776,7 +2231,15 @@ static const JSMallocFunctions def_malloc_funcs = {
 
 JSRuntime *JS_NewRuntime(void)
 {
-    return JS_NewRuntime2(&def_malloc_funcs, NULL);
+    JSRuntime *rt;
+    JSSlab *slab;
+
+    /* the runtime works without the slab if it cannot be allocated */
+    slab = js_slab_new();
+    rt = JS_NewRuntime2(&def_malloc_funcs, slab);
+    if (!rt && slab)
+        js_slab_free(slab);
+    return rt;
 }
 
 void JS_SetMemoryLimit(JSRuntime *rt, size_t limit)
@@ -1790,6 +2253,26 @@ void JS_SetGCThreshold(JSRuntime *rt, size_t gc_threshold)
     rt->malloc_gc_threshold = gc_threshold;
 }
 
+/* Set the number of GC object allocations after which the objects
+   allocated since the last collection are scanned for cycles. 0 disables
+   the young collections. */
+void JS_SetGCYoungThreshold(JSRuntime *rt, int count)
+{
+    rt->gc_young_threshold = max_int(count, 0);
+}
+
+/* Account for 'delta' bytes of memory kept alive by JS objects but not
+   allocated with js_malloc() (e.g. native objects wrapped by a class
+   finalizer). The external size is added to the malloc size when
+   deciding to trigger the GC. No GC is run by this function itself, so
+   it is safe to call it from a finalizer. */
+void JS_AdjustExternalMemory(JSRuntime *rt, int64_t delta)
+{
+    rt->external_memory_size += delta;
+    if (rt->external_memory_size < 0)
+        rt->external_memory_size = 0;
+}
+
 #define malloc(s) malloc_is_forbidden(s)
 #define free(p) free_is_forbidden(p)
 #define realloc(p,s) realloc_is_forbidden(p,s)
@@ -1811,61 +2294,140 @@ void JS_SetSharedArrayBufferFunctions(JSRuntime *rt,
     rt->sab_funcs = *sf;
 }
 
+static int js_resize_job_queue(JSContext *ctx)
+{
+    JSRuntime *rt = ctx->rt;
+    JSJobEntry *new_queue;
+    uint32_t new_size, n;
+
+    new_size = max_int(16, rt->job_queue_size * 2);
+    new_queue = js_malloc(ctx, sizeof(new_queue[0]) * new_size);
+    if (!new_queue)
+        return -1;
+    /* the pending jobs are moved to the start of the new queue */
+    n = min_uint32(rt->job_count, rt->job_queue_size - rt->job_head);
+    memcpy(new_queue, rt->job_queue + rt->job_head, n * sizeof(new_queue[0]));
+    memcpy(new_queue + n, rt->job_queue,
+           (rt->job_count - n) * sizeof(new_queue[0]));
+    js_free(ctx, rt->job_queue);
+    rt->job_queue = new_queue;
+    rt->job_queue_size = new_size;
+    rt->job_head = 0;
+    return 0;
+}
+
+/* called when the job queue is empty: release the memory used by a
+   past burst of jobs, but only after several drains so that a steady
+   flow of jobs does not reallocate the queue each time */
+static void js_shrink_job_queue(JSRuntime *rt)
+{
+    JSJobEntry *new_queue;
+    uint32_t new_size;
+
+    if (rt->job_count_max > rt->job_queue_size / 4) {
+        rt->job_queue_idle_drains = 0;
+        return;
+    }
+    if (++rt->job_queue_idle_drains < JS_JOB_QUEUE_SHRINK_DRAINS)
+        return;
+    rt->job_queue_idle_drains = 0;
+    new_size = rt->job_queue_size / 2;
+    new_queue = js_realloc_rt(rt, rt->job_queue,
+                              sizeof(new_queue[0]) * new_size);
+    if (!new_queue)
+        return;
+    rt->job_queue = new_queue;
+    rt->job_queue_size = new_size;
+    rt->job_head = 0;
+}
+
 /* return 0 if OK, < 0 if exception */
 int JS_EnqueueJob(JSContext *ctx, JSJobFunc *job_func,
                   int argc, JSValueConst *argv)
 {
     JSRuntime *rt = ctx->rt;
     JSJobEntry *e;
+    JSValue *ext_argv, *tab;
     int i;
 
-    e = js_malloc(ctx, sizeof(*e) + argc * sizeof(JSValue));
-    if (!e)
-        return -1;
+    ext_argv = NULL;
+    if (argc > JS_JOB_INLINE_ARGS) {
+        ext_argv = js_malloc(ctx, argc * sizeof(JSValue));
+        if (!ext_argv)
+            return -1;
+    }
+    if (unlikely(rt->job_count >= rt->job_queue_size)) {
+        if (js_resize_job_queue(ctx)) {
+            js_free(ctx, ext_argv);
+            return -1;
+        }
+    }
+    e = &rt->job_queue[(rt->job_head + rt->job_count) &
+                       (rt->job_queue_size - 1)];
+    rt->job_count++;
+    if (rt->job_count > rt->job_count_max)
+        rt->job_count_max = rt->job_count;
     e->ctx = ctx;
     e->job_func = job_func;
     e->argc = argc;
+    e->ext_argv = ext_argv;
+    tab = ext_argv ? ext_argv : e->argv;
     for(i = 0; i < argc; i++) {
-        e->argv[i] = JS_DupValue(ctx, argv[i]);
+        tab[i] = JS_DupValue(ctx, argv[i]);
     }
-    list_add_tail(&e->link, &rt->job_list);
     return 0;
 }
 
 BOOL JS_IsJobPending(JSRuntime *rt)
 {
-    return !list_empty(&rt->job_list);
+    return rt->job_count != 0;
 }
 
-/* return < 0 if exception, 0 if no job pending, 1 if a job was
-   executed successfully. the context of the job is stored in '*pctx' */
-int JS_ExecutePendingJob(JSRuntime *rt, JSContext **pctx)
+/* Execute the pending jobs in order, including the ones enqueued by
+   the executed jobs, until there is none or 'max_jobs' jobs are
+   executed (no limit if max_jobs < 0). Return the number of executed
+   jobs, or < 0 if a job raised an exception. The context of the last
+   executed job (NULL if none) is stored in '*pctx'. */
+int JS_ExecutePendingJobs(JSRuntime *rt, int max_jobs, JSContext **pctx)
 {
     JSContext *ctx;
-    JSJobEntry *e;
-    JSValue res;
-    int i, ret;
+    JSJobEntry e;
+    JSValue res, *tab;
+    int i, n;
 
-    if (list_empty(&rt->job_list)) {
-        *pctx = NULL;
-        return 0;
+    ctx = NULL;
+    for(n = 0; n != max_jobs && rt->job_count != 0; n++) {
+        /* the job is copied because the queue may be resized while it
+           is executed */
+        e = rt->job_queue[rt->job_head];
+        rt->job_head = (rt->job_head + 1) & (rt->job_queue_size - 1);
+        rt->job_count--;
+        ctx = e.ctx;
+        tab = e.ext_argv ? e.ext_argv : e.argv;
+        res = e.job_func(ctx, e.argc, (JSValueConst *)tab);
+        for(i = 0; i < e.argc; i++)
+            JS_FreeValue(ctx, tab[i]);
+        js_free(ctx, e.ext_argv);
+        if (JS_IsException(res)) {
+            *pctx = ctx;
+            return -1;
+        }
+        JS_FreeValue(ctx, res);
+    }
+    if (rt->job_count == 0) {
+        if (rt->job_queue_size > JS_JOB_QUEUE_MAX_IDLE_SIZE)
+            js_shrink_job_queue(rt);
+        rt->job_count_max = 0;
     }
-
-    /* get the first pending job and execute it */
-    e = list_entry(rt->job_list.next, JSJobEntry, link);
-    list_del(&e->link);
-    ctx = e->ctx;
-    res = e->job_func(e->ctx, e->argc, (JSValueConst *)e->argv);
-    for(i = 0; i < e->argc; i++)
-        JS_FreeValue(ctx, e->argv[i]);
-    if (JS_IsException(res))
-        ret = -1;
-    else
-        ret = 1;
-    JS_FreeValue(ctx, res);
-    js_free(ctx, e);
     *pctx = ctx;
-    return ret;
+    return n;
+}
+
+/* return < 0 if exception, 0 if no job pending, 1 if a job was
+   executed successfully. the context of the job is stored in '*pctx' */
+int JS_ExecutePendingJob(JSRuntime *rt, JSContext **pctx)
+{
+    return JS_ExecutePendingJobs(rt, 1, pctx);
 }
 
 static inline uint32_t atom_get_free(const JSAtomStruct *p)
@@ -1936,21 +2498,37 @@ void JS_SetRuntimeInfo(JSRuntime *rt, const char *s)
 
 void JS_FreeRuntime(JSRuntime *rt)
 {
+#ifdef DUMP_LEAKS
     struct list_head *el, *el1;
+#endif
     int i;
 
     JS_FreeValueRT(rt, rt->current_exception);
 
-    list_for_each_safe(el, el1, &rt->job_list) {
-        JSJobEntry *e = list_entry(el, JSJobEntry, link);
+    while (rt->job_count != 0) {
+        JSJobEntry *e = &rt->job_queue[rt->job_head];
+        JSValue *tab = e->ext_argv ? e->ext_argv : e->argv;
         for(i = 0; i < e->argc; i++)
-            JS_FreeValueRT(rt, e->argv[i]);
-        js_free_rt(rt, e);
+            JS_FreeValueRT(rt, tab[i]);
+        js_free_rt(rt, e->ext_argv);
+        rt->job_head = (rt->job_head + 1) & (rt->job_queue_size - 1);
+        rt->job_count--;
     }
-    init_list_head(&rt->job_list);
+    js_free_rt(rt, rt->job_queue);
+    rt->job_queue = NULL;
+    rt->job_queue_size = 0;
 
     JS_RunGC(rt);
 
+    for(i = 0; i < countof(rt->char_strings); i++) {
+        if (rt->char_strings[i])
+            JS_FreeValueRT(rt, JS_MKPTR(JS_TAG_STRING, rt->char_strings[i]));
+    }
+    for(i = 0; i < countof(rt->char2_strings); i++) {
+        if (rt->char2_strings[i])
+            JS_FreeValueRT(rt, JS_MKPTR(JS_TAG_STRING, rt->char2_strings[i]));
+    }
+
 #ifdef DUMP_LEAKS
     /* leaking objects */
     {
@@ -1991,6 +2569,7 @@ void JS_FreeRuntime(JSRuntime *rt)
     }
 #endif
     assert(list_empty(&rt->gc_obj_list));
+    assert(list_empty(&rt->gc_young_obj_list));
 
     /* free the classes */
     for(i = 0; i < rt->class_count; i++) {
@@ -2118,7 +2697,10 @@ void JS_FreeRuntime(JSRuntime *rt)
 
     {
         JSMallocState ms = rt->malloc_state;
+        BOOL has_slab = (rt->mf.js_malloc == js_def_malloc && ms.opaque);
         rt->mf.js_free(&ms, rt);
+        if (has_slab)
+            js_slab_free(ms.opaque);
     }
 }
 
@@ -2278,6 +2860,10 @@ static void JS_MarkContext(JSRuntime *rt, JSContext *ctx,
 
     if (ctx->array_shape)
         mark_func(rt, &ctx->array_shape->header);
+    for(i = 0; i < JSON_SHAPE_CACHE_SIZE; i++) {
+        if (ctx->json_shapes[i])
+            mark_func(rt, &ctx->json_shapes[i]->header);
+    }
 }
 
 void JS_FreeContext(JSContext *ctx)
@@ -2301,7 +2887,7 @@ void JS_FreeContext(JSContext *ctx)
         JSGCObjectHeader *p;
         printf("JSObjects: {\n");
         JS_DumpObjectHeader(ctx->rt);
-        list_for_each(el, &rt->gc_obj_list) {
+        list_for_each_gc_obj(el, rt) {
             p = list_entry(el, JSGCObjectHeader, link);
             JS_DumpGCObject(rt, p);
         }
@@ -2341,6 +2927,8 @@ void JS_FreeContext(JSContext *ctx)
     JS_FreeValue(ctx, ctx->function_proto);
 
     js_free_shape_null(ctx->rt, ctx->array_shape);
+    for(i = 0; i < JSON_SHAPE_CACHE_SIZE; i++)
+        js_free_shape_null(ctx->rt, ctx->json_shapes[i]);
 
     list_del(&ctx->link);
     remove_gc_object(&ctx->header);
@@ -3466,6 +4054,36 @@ int JS_NewClass(JSRuntime *rt, JSClassID class_id, const JSClassDef *class_def)
     return ret;
 }
 
+/* Strings of one or two 8 bit characters are shared so that indexing
+   and splitting strings usually does not allocate. */
+static JSValue js_new_short_string8(JSContext *ctx, const uint8_t *buf, int len)
+{
+    JSRuntime *rt = ctx->rt;
+    JSString *str, **pstr;
+
+    if (len == 1) {
+        pstr = &rt->char_strings[buf[0]];
+        str = *pstr;
+        if (likely(str))
+            return JS_DupValue(ctx, JS_MKPTR(JS_TAG_STRING, str));
+    } else {
+        pstr = &rt->char2_strings[(buf[0] * 31 + buf[1]) &
+                                  (JS_CHAR2_CACHE_SIZE - 1)];
+        str = *pstr;
+        if (str && str->u.str8[0] == buf[0] && str->u.str8[1] == buf[1])
+            return JS_DupValue(ctx, JS_MKPTR(JS_TAG_STRING, str));
+    }
+    str = js_alloc_string(ctx, len, 0);
+    if (!str)
+        return JS_EXCEPTION;
+    memcpy(str->u.str8, buf, len);
+    str->u.str8[len] = '\0';
+    if (*pstr)
+        JS_FreeValue(ctx, JS_MKPTR(JS_TAG_STRING, *pstr));
+    *pstr = str;
+    return JS_DupValue(ctx, JS_MKPTR(JS_TAG_STRING, str));
+}
+
 static JSValue js_new_string8(JSContext *ctx, const uint8_t *buf, int len)
 {
     JSString *str;
@@ -3473,6 +4091,8 @@ static JSValue js_new_string8(JSContext *ctx, const uint8_t *buf, int len)
     if (len <= 0) {
         return JS_AtomToString(ctx, JS_ATOM_empty_string);
     }
+    if (len <= 2)
+        return js_new_short_string8(ctx, buf, len);
     str = js_alloc_string(ctx, len, 0);
     if (!str)
         return JS_EXCEPTION;
@@ -3517,13 +4137,17 @@ static JSValue js_sub_string(JSContext *ctx, JSString *p, int start, int end)
         }
         if (c > 0xFF)
             return js_new_string16(ctx, p->u.str16 + start, len);
+        if (len <= 2) {
+            uint8_t buf[2];
+            for (i = 0; i < len; i++)
+                buf[i] = p->u.str16[start + i];
+            return js_new_short_string8(ctx, buf, len);
+        }
 
         str = js_alloc_string(ctx, len, 0);
         if (!str)
             return JS_EXCEPTION;
-        for (i = 0; i < len; i++) {
-            str->u.str8[i] = p->u.str16[start + i];
-        }
+        str16_to_str8(str->u.str8, p->u.str16 + start, len);
         str->u.str8[len] = '\0';
         return JS_MKPTR(JS_TAG_STRING, str);
     } else {
@@ -3588,7 +4212,6 @@ static no_inline int string_buffer_widen(StringBuffer *s, int size)
 {
     JSString *str;
     size_t slack;
-    int i;
 
     if (s->error_status)
         return -1;
@@ -3597,9 +4220,8 @@ static no_inline int string_buffer_widen(StringBuffer *s, int size)
     if (!str)
         return string_buffer_set_error(s);
     size += slack >> 1;
-    for(i = s->len; i-- > 0;) {
-        str->u.str16[i] = str->u.str8[i];
-    }
+    /* widened in place */
+    str8_to_str16(str->u.str16, str->u.str8, s->len);
     s->is_wide_char = 1;
     s->size = size;
     s->str = str;
@@ -3720,16 +4342,12 @@ static int string_getc(const JSString *p, int *pidx)
 
 static int string_buffer_write8(StringBuffer *s, const uint8_t *p, int len)
 {
-    int i;
-
     if (s->len + len > s->size) {
         if (string_buffer_realloc(s, s->len + len, 0))
             return -1;
     }
     if (s->is_wide_char) {
-        for (i = 0; i < len; i++) {
-            s->str->u.str16[s->len + i] = p[i];
-        }
+        str8_to_str16(&s->str->u.str16[s->len], p, len);
         s->len += len;
     } else {
         memcpy(&s->str->u.str8[s->len], p, len);
@@ -3756,9 +4374,7 @@ static int string_buffer_write16(StringBuffer *s, const uint16_t *p, int len)
         memcpy(&s->str->u.str16[s->len], p, len << 1);
         s->len += len;
     } else {
-        for (i = 0; i < len; i++) {
-            s->str->u.str8[s->len + i] = p[i];
-        }
+        str16_to_str8(&s->str->u.str8[s->len], p, len);
         s->len += len;
     }
     return 0;
@@ -3850,6 +4466,12 @@ static JSValue string_buffer_end(StringBuffer *s)
         s->str = NULL;
         return JS_AtomToString(s->ctx, JS_ATOM_empty_string);
     }
+    if (s->len <= 2 && !s->is_wide_char) {
+        JSValue ret = js_new_short_string8(s->ctx, str->u.str8, s->len);
+        js_free(s->ctx, str);
+        s->str = NULL;
+        return ret;
+    }
     if (s->len < s->size) {
         /* smaller size so js_realloc should not fail, but OK if it does */
         /* XXX: should add some slack to avoid unnecessary calls */
@@ -3877,26 +4499,51 @@ JSValue JS_NewStringLen(JSContext *ctx, const char *buf, size_t buf_len)
     const uint8_t *p, *p_end, *p_start, *p_next;
     uint32_t c;
     StringBuffer b_s, *b = &b_s;
-    size_t len1;
+    size_t len1, len16;
+    BOOL is_wide;
+    JSString *str;
 
     p_start = (const uint8_t *)buf;
     p_end = p_start + buf_len;
-    p = p_start;
-    while (p < p_end && *p < 128)
-        p++;
+    p = p_start + str8_ascii_len(p_start, buf_len);
     len1 = p - p_start;
     if (len1 > JS_STRING_LEN_MAX)
         return JS_ThrowInternalError(ctx, "string too long");
     if (p == p_end) {
         /* ASCII string */
         return js_new_string8(ctx, (const uint8_t *)buf, buf_len);
+    } else if (!utf8_scan(p, p_end - p, &len16, &is_wide)) {
+        /* valid UTF-8: the result is allocated with its final size */
+        len16 += len1;
+        if (len16 > JS_STRING_LEN_MAX)
+            return JS_ThrowInternalError(ctx, "string too long");
+        if (!is_wide && len16 <= 2) {
+            uint8_t tmp[2];
+            memcpy(tmp, p_start, len1);
+            utf8_decode_str8(tmp + len1, p, p_end - p);
+            return js_new_string8(ctx, tmp, len16);
+        }
+        str = js_alloc_string(ctx, len16, is_wide);
+        if (!str)
+            return JS_EXCEPTION;
+        if (is_wide) {
+            str8_to_str16(str->u.str16, p_start, len1);
+            utf8_decode_str16(str->u.str16 + len1, p, p_end - p);
+        } else {
+            memcpy(str->u.str8, p_start, len1);
+            utf8_decode_str8(str->u.str8 + len1, p, p_end - p);
+            str->u.str8[len16] = '\0';
+        }
+        return JS_MKPTR(JS_TAG_STRING, str);
     } else {
         if (string_buffer_init(ctx, b, buf_len))
             goto fail;
         string_buffer_write8(b, p_start, len1);
         while (p < p_end) {
             if (*p < 128) {
-                string_buffer_putc8(b, *p++);
+                len1 = str8_ascii_len(p, p_end - p);
+                string_buffer_write8(b, p, len1);
+                p += len1;
             } else {
                 /* parse utf-8 sequence, return 0xFFFFFFFF for error */
                 c = unicode_from_utf8(p, p_end - p, &p_next);
@@ -3985,8 +4632,7 @@ const char *JS_ToCStringLen2(JSContext *ctx, size_t *plen, JSValueConst val1, BO
 {
     JSValue val;
     JSString *str, *str_new;
-    int pos, len, c, c1;
-    uint8_t *q;
+    int len, count;
 
     if (JS_VALUE_GET_TAG(val1) != JS_TAG_STRING) {
         val = JS_ToString(ctx, val1);
@@ -4000,7 +4646,6 @@ const char *JS_ToCStringLen2(JSContext *ctx, size_t *plen, JSValueConst val1, BO
     len = str->len;
     if (!str->is_wide_char) {
         const uint8_t *src = str->u.str8;
-        int count;
 
         /* count the number of non-ASCII characters */
         /* Scanning the whole string is required for ASCII strings,
@@ -4008,10 +4653,7 @@ const char *JS_ToCStringLen2(JSContext *ctx, size_t *plen, JSValueConst val1, BO
            than testing each byte, hence this method is faster for ASCII
            strings, which is the most common case.
          */
-        count = 0;
-        for (pos = 0; pos < len; pos++) {
-            count += src[pos] >> 7;
-        }
+        count = str8_count_non_ascii(src, len);
         if (count == 0) {
             if (plen)
                 *plen = len;
@@ -4020,54 +4662,20 @@ const char *JS_ToCStringLen2(JSContext *ctx, size_t *plen, JSValueConst val1, BO
         str_new = js_alloc_string(ctx, len + count, 0);
         if (!str_new)
             goto fail;
-        q = str_new->u.str8;
-        for (pos = 0; pos < len; pos++) {
-            c = src[pos];
-            if (c < 0x80) {
-                *q++ = c;
-            } else {
-                *q++ = (c >> 6) | 0xc0;
-                *q++ = (c & 0x3f) | 0x80;
-            }
-        }
+        count = utf8_encode_str8(str_new->u.str8, src, len);
     } else {
-        const uint16_t *src = str->u.str16;
         /* Allocate 3 bytes per 16 bit code point. Surrogate pairs may
-           produce 4 bytes but use 2 code points.
+           produce 4 bytes but use 2 code points. The unmatched surrogate
+           code points are kept.
          */
         str_new = js_alloc_string(ctx, len * 3, 0);
         if (!str_new)
             goto fail;
-        q = str_new->u.str8;
-        pos = 0;
-        while (pos < len) {
-            c = src[pos++];
-            if (c < 0x80) {
-                *q++ = c;
-            } else {
-                if (c >= 0xd800 && c < 0xdc00) {
-                    if (pos < len && !cesu8) {
-                        c1 = src[pos];
-                        if (c1 >= 0xdc00 && c1 < 0xe000) {
-                            pos++;
-                            /* surrogate pair */
-                            c = (((c & 0x3ff) << 10) | (c1 & 0x3ff)) + 0x10000;
-                        } else {
-                            /* Keep unmatched surrogate code points */
-                            /* c = 0xfffd; */ /* error */
-                        }
-                    } else {
-                        /* Keep unmatched surrogate code points */
-                        /* c = 0xfffd; */ /* error */
-                    }
-                }
-                q += unicode_to_utf8(q, c);
-            }
-        }
+        count = utf8_encode_str16(str_new->u.str8, str->u.str16, len, cesu8);
     }
 
-    *q = '\0';
-    str_new->len = q - str_new->u.str8;
+    str_new->u.str8[count] = '\0';
+    str_new->len = count;
     JS_FreeValue(ctx, val);
     if (plen)
         *plen = str_new->len;
@@ -4090,24 +4698,18 @@ void JS_FreeCString(JSContext *ctx, const char *ptr)
 
 static int memcmp16_8(const uint16_t *src1, const uint8_t *src2, int len)
 {
-    int c, i;
-    for(i = 0; i < len; i++) {
-        c = src1[i] - src2[i];
-        if (c != 0)
-            return c;
-    }
-    return 0;
+    size_t i = str16_8_mismatch(src1, src2, len);
+    if (i == len)
+        return 0;
+    return src1[i] - src2[i];
 }
 
 static int memcmp16(const uint16_t *src1, const uint16_t *src2, int len)
 {
-    int c, i;
-    for(i = 0; i < len; i++) {
-        c = src1[i] - src2[i];
-        if (c != 0)
-            return c;
-    }
-    return 0;
+    size_t i = str16_mismatch(src1, src2, len);
+    if (i == len)
+        return 0;
+    return src1[i] - src2[i];
 }
 
 static int js_string_memcmp(const JSString *p1, const JSString *p2, int len)
@@ -4151,11 +4753,7 @@ static void copy_str16(uint16_t *dst, const JSString *p, int offset, int len)
     if (p->is_wide_char) {
         memcpy(dst, p->u.str16 + offset, len * 2);
     } else {
-        const uint8_t *src1 = p->u.str8 + offset;
-        int i;
-
-        for(i = 0; i < len; i++)
-            dst[i] = src1[i];
+        str8_to_str16(dst, p->u.str8 + offset, len);
     }
 }
 
@@ -4184,12 +4782,59 @@ static JSValue JS_ConcatString1(JSContext *ctx,
     return JS_MKPTR(JS_TAG_STRING, p);
 }
 
+/* Append p2 at the end of *pp1 if the string can be modified in place,
+   i.e. if it has no other reference and is not an atom. The string is
+   reallocated with 50% of slack when it is full so that repeated
+   concatenations to the same string take linear time. Return 1 if done,
+   0 if the string cannot be modified and -1 if exception. */
+static int js_string_append(JSContext *ctx, JSString **pp1, const JSString *p2)
+{
+    JSString *p1 = *pp1;
+    size_t size, new_size;
+    uint32_t len;
+
+    if (p1->header.ref_count != 1 || p1->atom_type != 0 ||
+        p1->is_wide_char < p2->is_wide_char)
+        return 0;
+    len = p1->len + p2->len;
+    if (len > JS_STRING_LEN_MAX) {
+        JS_ThrowInternalError(ctx, "string too long");
+        return -1;
+    }
+    size = sizeof(*p1) + (len << p1->is_wide_char) + 1 - p1->is_wide_char;
+    if (js_malloc_usable_size(ctx, p1) < size) {
+        new_size = size + (size >> 1);
+#ifdef DUMP_LEAKS
+        list_del(&p1->link);
+#endif
+        p1 = js_realloc(ctx, p1, new_size);
+#ifdef DUMP_LEAKS
+        if (!p1)
+            p1 = *pp1;
+        list_add_tail(&p1->link, &ctx->rt->string_list);
+#endif
+        if (!p1)
+            return -1;
+        *pp1 = p1;
+    }
+    if (p1->is_wide_char) {
+        copy_str16(p1->u.str16 + p1->len, p2, 0, p2->len);
+        p1->len = len;
+    } else {
+        memcpy(p1->u.str8 + p1->len, p2->u.str8, p2->len);
+        p1->len = len;
+        p1->u.str8[len] = '\0';
+    }
+    return 1;
+}
+
 /* op1 and op2 are converted to strings. For convience, op1 or op2 =
    JS_EXCEPTION are accepted and return JS_EXCEPTION.  */
 static JSValue JS_ConcatString(JSContext *ctx, JSValue op1, JSValue op2)
 {
     JSValue ret;
     JSString *p1, *p2;
+    int res;
 
     if (unlikely(JS_VALUE_GET_TAG(op1) != JS_TAG_STRING)) {
         op1 = JS_ToStringFree(ctx, op1);
@@ -4212,17 +4857,14 @@ static JSValue JS_ConcatString(JSContext *ctx, JSValue op1, JSValue op2)
     if (p2->len == 0) {
         goto ret_op1;
     }
-    if (p1->header.ref_count == 1 && p1->is_wide_char == p2->is_wide_char
-    &&  js_malloc_usable_size(ctx, p1) >= sizeof(*p1) + ((p1->len + p2->len) << p2->is_wide_char) + 1 - p1->is_wide_char) {
-        /* Concatenate in place in available space at the end of p1 */
-        if (p1->is_wide_char) {
-            memcpy(p1->u.str16 + p1->len, p2->u.str16, p2->len << 1);
-            p1->len += p2->len;
-        } else {
-            memcpy(p1->u.str8 + p1->len, p2->u.str8, p2->len);
-            p1->len += p2->len;
-            p1->u.str8[p1->len] = '\0';
+    res = js_string_append(ctx, &p1, p2);
+    if (res != 0) {
+        if (res < 0) {
+            JS_FreeValue(ctx, op1);
+            JS_FreeValue(ctx, op2);
+            return JS_EXCEPTION;
         }
+        op1 = JS_MKPTR(JS_TAG_STRING, p1);
     ret_op1:
         JS_FreeValue(ctx, op2);
         return op1;
@@ -4233,6 +4875,34 @@ static JSValue JS_ConcatString(JSContext *ctx, JSValue op1, JSValue op2)
     return ret;
 }
 
+/* *pv = *pv + op2 where *pv is a string. Contrary to JS_ConcatString(),
+   *pv is not duplicated so that the string can be extended in place when
+   the variable holds its only reference. op2 is freed. Return -1 if
+   exception and leave *pv unchanged. */
+static int js_concat_string_to(JSContext *ctx, JSValue *pv, JSValue op2)
+{
+    JSString *p1;
+    JSValue ret;
+    int res;
+
+    if (JS_VALUE_GET_TAG(op2) == JS_TAG_STRING) {
+        p1 = JS_VALUE_GET_STRING(*pv);
+        res = js_string_append(ctx, &p1, JS_VALUE_GET_STRING(op2));
+        if (res != 0) {
+            JS_FreeValue(ctx, op2);
+            if (res < 0)
+                return -1;
+            *pv = JS_MKPTR(JS_TAG_STRING, p1);
+            return 0;
+        }
+    }
+    ret = JS_ConcatString(ctx, JS_DupValue(ctx, *pv), op2);
+    if (JS_IsException(ret))
+        return -1;
+    set_value(ctx, pv, ret);
+    return 0;
+}
+
 /* Shape support */
 
 static inline size_t get_shape_size(size_t hash_size, size_t prop_size)
@@ -4251,9 +4921,14 @@ static inline uint32_t *prop_hash_end(JSShape *sh)
     return (uint32_t *)sh;
 }
 
+static inline uint32_t get_shape_hash_size(JSShape *sh)
+{
+    return sh->is_small ? 0 : sh->prop_hash_mask + 1;
+}
+
 static inline void *get_alloc_from_shape(JSShape *sh)
 {
-    return prop_hash_end(sh) - ((intptr_t)sh->prop_hash_mask + 1);
+    return prop_hash_end(sh) - get_shape_hash_size(sh);
 }
 
 static inline JSShapeProperty *get_shape_prop(JSShape *sh)
@@ -4264,6 +4939,7 @@ static inline JSShapeProperty *get_shape_prop(JSShape *sh)
 static int init_shape_hash(JSRuntime *rt)
 {
     rt->shape_hash_bits = 4;   /* 16 shapes */
+    rt->global_var_version = 1;
     rt->shape_hash_size = 1 << rt->shape_hash_bits;
     rt->shape_hash_count = 0;
     rt->shape_hash = js_mallocz_rt(rt, sizeof(rt->shape_hash[0]) *
@@ -4344,17 +5020,24 @@ static void js_shape_hash_unlink(JSRuntime *rt, JSShape *sh)
 
 /* create a new empty shape with prototype 'proto' */
 static no_inline JSShape *js_new_shape2(JSContext *ctx, JSObject *proto,
-                                        int hash_size, int prop_size)
+                                        int prop_size)
 {
     JSRuntime *rt = ctx->rt;
     void *sh_alloc;
     JSShape *sh;
+    int hash_size;
 
     /* resize the shape hash table if necessary */
     if (2 * (rt->shape_hash_count + 1) > rt->shape_hash_size) {
         resize_shape_hash(rt, rt->shape_hash_bits + 1);
     }
 
+    hash_size = 0;
+    if (prop_size > JS_PROP_SMALL_SHAPE_SIZE) {
+        hash_size = JS_PROP_INITIAL_HASH_SIZE;
+        while (hash_size < prop_size)
+            hash_size = 2 * hash_size;
+    }
     sh_alloc = js_malloc(ctx, get_shape_size(hash_size, prop_size));
     if (!sh_alloc)
         return NULL;
@@ -4366,7 +5049,8 @@ static no_inline JSShape *js_new_shape2(JSContext *ctx, JSObject *proto,
     sh->proto = proto;
     memset(prop_hash_end(sh) - hash_size, 0, sizeof(prop_hash_end(sh)[0]) *
            hash_size);
-    sh->prop_hash_mask = hash_size - 1;
+    sh->is_small = (hash_size == 0);
+    sh->prop_hash_mask = hash_size ? hash_size - 1 : 0;
     sh->prop_size = prop_size;
     sh->prop_count = 0;
     sh->deleted_prop_count = 0;
@@ -4375,14 +5059,14 @@ static no_inline JSShape *js_new_shape2(JSContext *ctx, JSObject *proto,
     sh->hash = shape_initial_hash(proto);
     sh->is_hashed = TRUE;
     sh->has_small_array_index = FALSE;
+    sh->is_global = FALSE;
     js_shape_hash_link(ctx->rt, sh);
     return sh;
 }
 
 static JSShape *js_new_shape(JSContext *ctx, JSObject *proto)
 {
-    return js_new_shape2(ctx, proto, JS_PROP_INITIAL_HASH_SIZE,
-                         JS_PROP_INITIAL_SIZE);
+    return js_new_shape2(ctx, proto, JS_PROP_INITIAL_SIZE);
 }
 
 /* The shape is cloned. The new shape is not inserted in the shape
@@ -4395,7 +5079,7 @@ static JSShape *js_clone_shape(JSContext *ctx, JSShape *sh1)
     JSShapeProperty *pr;
     uint32_t i, hash_size;
 
-    hash_size = sh1->prop_hash_mask + 1;
+    hash_size = get_shape_hash_size(sh1);
     size = get_shape_size(hash_size, sh1->prop_size);
     sh_alloc = js_malloc(ctx, size);
     if (!sh_alloc)
@@ -4475,10 +5159,14 @@ static no_inline int resize_properties(JSContext *ctx, JSShape **psh,
             return -1;
         p->prop = new_prop;
     }
-    new_hash_size = sh->prop_hash_mask + 1;
-    while (new_hash_size < new_size)
-        new_hash_size = 2 * new_hash_size;
-    if (new_hash_size != (sh->prop_hash_mask + 1)) {
+    new_hash_size = get_shape_hash_size(sh);
+    if (new_size > JS_PROP_SMALL_SHAPE_SIZE) {
+        if (new_hash_size == 0)
+            new_hash_size = JS_PROP_INITIAL_HASH_SIZE;
+        while (new_hash_size < new_size)
+            new_hash_size = 2 * new_hash_size;
+    }
+    if (new_hash_size != get_shape_hash_size(sh)) {
         JSShape *old_sh;
         /* resize the hash table and the properties */
         old_sh = sh;
@@ -4492,6 +5180,7 @@ static no_inline int resize_properties(JSContext *ctx, JSShape **psh,
                sizeof(JSShape) + sizeof(sh->prop[0]) * old_sh->prop_count);
         list_add_tail(&sh->header.link, &ctx->rt->gc_obj_list);
         new_hash_mask = new_hash_size - 1;
+        sh->is_small = FALSE;
         sh->prop_hash_mask = new_hash_mask;
         memset(prop_hash_end(sh) - new_hash_size, 0,
                sizeof(prop_hash_end(sh)[0]) * new_hash_size);
@@ -4530,6 +5219,7 @@ static int compact_properties(JSContext *ctx, JSObject *p)
     uint32_t new_hash_size, i, j, new_hash_mask, new_size;
     JSShapeProperty *old_pr, *pr;
     JSProperty *prop, *new_prop;
+    uint32_t atom_bits = 0;
 
     sh = p->shape;
     assert(!sh->is_hashed);
@@ -4538,9 +5228,13 @@ static int compact_properties(JSContext *ctx, JSObject *p)
                        sh->prop_count - sh->deleted_prop_count);
     assert(new_size <= sh->prop_size);
 
-    new_hash_size = sh->prop_hash_mask + 1;
-    while ((new_hash_size / 2) >= new_size)
-        new_hash_size = new_hash_size / 2;
+    new_hash_size = get_shape_hash_size(sh);
+    if (new_size <= JS_PROP_SMALL_SHAPE_SIZE) {
+        new_hash_size = 0;
+    } else {
+        while ((new_hash_size / 2) >= new_size)
+            new_hash_size = new_hash_size / 2;
+    }
     new_hash_mask = new_hash_size - 1;
 
     /* resize the hash table and the properties */
@@ -4564,9 +5258,14 @@ static int compact_properties(JSContext *ctx, JSObject *p)
         if (old_pr->atom != JS_ATOM_NULL) {
             pr->atom = old_pr->atom;
             pr->flags = old_pr->flags;
-            h = ((uintptr_t)old_pr->atom & new_hash_mask);
-            pr->hash_next = prop_hash_end(sh)[-h - 1];
-            prop_hash_end(sh)[-h - 1] = j + 1;
+            if (new_hash_size != 0) {
+                h = ((uintptr_t)old_pr->atom & new_hash_mask);
+                pr->hash_next = prop_hash_end(sh)[-h - 1];
+                prop_hash_end(sh)[-h - 1] = j + 1;
+            } else {
+                pr->hash_next = 0;
+                atom_bits |= 1U << (old_pr->atom & 31);
+            }
             prop[j] = prop[i];
             j++;
             pr++;
@@ -4574,7 +5273,8 @@ static int compact_properties(JSContext *ctx, JSObject *p)
         old_pr++;
     }
     assert(j == (sh->prop_count - sh->deleted_prop_count));
-    sh->prop_hash_mask = new_hash_mask;
+    sh->is_small = (new_hash_size == 0);
+    sh->prop_hash_mask = sh->is_small ? atom_bits : new_hash_mask;
     sh->prop_size = new_size;
     sh->deleted_prop_count = 0;
     sh->prop_count = j;
@@ -4626,10 +5326,15 @@ static int add_shape_property(JSContext *ctx, JSShape **psh,
     pr->flags = prop_flags;
     sh->has_small_array_index |= __JS_AtomIsTaggedInt(atom);
     /* add in hash table */
-    hash_mask = sh->prop_hash_mask;
-    h = atom & hash_mask;
-    pr->hash_next = prop_hash_end(sh)[-h - 1];
-    prop_hash_end(sh)[-h - 1] = sh->prop_count;
+    if (!sh->is_small) {
+        hash_mask = sh->prop_hash_mask;
+        h = atom & hash_mask;
+        pr->hash_next = prop_hash_end(sh)[-h - 1];
+        prop_hash_end(sh)[-h - 1] = sh->prop_count;
+    } else {
+        pr->hash_next = 0;
+        sh->prop_hash_mask |= 1U << (atom & 31);
+    }
     return 0;
 }
 
@@ -4718,7 +5423,7 @@ static __maybe_unused void JS_DumpShapes(JSRuntime *rt)
         }
     }
     /* dump non-hashed shapes */
-    list_for_each(el, &rt->gc_obj_list) {
+    list_for_each_gc_obj(el, rt) {
         gp = list_entry(el, JSGCObjectHeader, link);
         if (gp->gc_obj_type == JS_GC_OBJ_TYPE_JS_OBJECT) {
             p = (JSObject *)gp;
@@ -5198,9 +5903,20 @@ static force_inline JSShapeProperty *find_own_property1(JSObject *p,
     JSShapeProperty *pr, *prop;
     intptr_t h;
     sh = p->shape;
+    prop = get_shape_prop(sh);
+    if (sh->is_small) {
+        /* linear search. The deleted properties have a null atom. */
+        if (!(sh->prop_hash_mask & (1U << (atom & 31))))
+            return NULL;
+        for(h = 0; h < sh->prop_count; h++) {
+            pr = &prop[h];
+            if (pr->atom == atom && likely(atom != JS_ATOM_NULL))
+                return pr;
+        }
+        return NULL;
+    }
     h = (uintptr_t)atom & sh->prop_hash_mask;
     h = prop_hash_end(sh)[-h - 1];
-    prop = get_shape_prop(sh);
     while (h) {
         pr = &prop[h - 1];
         if (likely(pr->atom == atom)) {
@@ -5219,9 +5935,25 @@ static force_inline JSShapeProperty *find_own_property(JSProperty **ppr,
     JSShapeProperty *pr, *prop;
     intptr_t h;
     sh = p->shape;
+    prop = get_shape_prop(sh);
+    if (sh->is_small) {
+        /* linear search */
+        if (!(sh->prop_hash_mask & (1U << (atom & 31)))) {
+            *ppr = NULL;
+            return NULL;
+        }
+        for(h = 0; h < sh->prop_count; h++) {
+            pr = &prop[h];
+            if (pr->atom == atom && likely(atom != JS_ATOM_NULL)) {
+                *ppr = &p->prop[h];
+                return pr;
+            }
+        }
+        *ppr = NULL;
+        return NULL;
+    }
     h = (uintptr_t)atom & sh->prop_hash_mask;
     h = prop_hash_end(sh)[-h - 1];
-    prop = get_shape_prop(sh);
     while (h) {
         pr = &prop[h - 1];
         if (likely(pr->atom == atom)) {
@@ -5521,6 +6253,12 @@ void __JS_FreeValueRT(JSRuntime *rt, JSValue v)
                 if (rt->gc_phase == JS_GC_PHASE_NONE) {
                     free_zero_refcount(rt);
                 }
+            } else if (p->mark == GC_MARK_NONE) {
+                /* not in the collected set (e.g. an old object during
+                   a young collection): freed by gc_free_cycles() once
+                   the cycles are removed */
+                list_del(&p->link);
+                list_add_tail(&p->link, &rt->gc_zero_ref_count_list);
             }
         }
         break;
@@ -5568,7 +6306,8 @@ static void add_gc_object(JSRuntime *rt, JSGCObjectHeader *h,
 {
     h->mark = 0;
     h->gc_obj_type = type;
-    list_add_tail(&h->link, &rt->gc_obj_list);
+    list_add_tail(&h->link, &rt->gc_young_obj_list);
+    rt->gc_young_alloc_count++;
 }
 
 static void remove_gc_object(JSGCObjectHeader *h)
@@ -5645,6 +6384,16 @@ static void mark_children(JSRuntime *rt, JSGCObjectHeader *gp,
             for(i = 0; i < b->cpool_count; i++) {
                 JS_MarkValue(rt, b->cpool[i], mark_func);
             }
+            for(i = 0; i < b->ic_count; i++) {
+                JSPropertyICWay *w;
+                int j;
+                for(j = 0; j < b->ic[i].way_count; j++) {
+                    w = &b->ic[i].ways[j];
+                    mark_func(rt, &w->shape->header);
+                    if (w->proto_shape)
+                        mark_func(rt, &w->proto_shape->header);
+                }
+            }
             if (b->realm)
                 mark_func(rt, &b->realm->header);
         }
@@ -5664,6 +6413,8 @@ static void mark_children(JSRuntime *rt, JSGCObjectHeader *gp,
                 async_func_mark(rt, &s->func_state, mark_func);
             JS_MarkValue(rt, s->resolving_funcs[0], mark_func);
             JS_MarkValue(rt, s->resolving_funcs[1], mark_func);
+            JS_MarkValue(rt, s->resume_funcs[0], mark_func);
+            JS_MarkValue(rt, s->resume_funcs[1], mark_func);
         }
         break;
     case JS_GC_OBJ_TYPE_SHAPE:
@@ -5687,9 +6438,11 @@ static void mark_children(JSRuntime *rt, JSGCObjectHeader *gp,
 
 static void gc_decref_child(JSRuntime *rt, JSGCObjectHeader *p)
 {
+    if (p->mark == GC_MARK_NONE)
+        return;
     assert(p->ref_count > 0);
     p->ref_count--;
-    if (p->ref_count == 0 && p->mark == 1) {
+    if (p->ref_count == 0 && p->mark == GC_MARK_DECREF) {
         list_del(&p->link);
         list_add_tail(&p->link, &rt->tmp_obj_list);
     }
@@ -5702,14 +6455,20 @@ static void gc_decref(JSRuntime *rt)
 
     init_list_head(&rt->tmp_obj_list);
 
+    list_for_each(el, &rt->gc_obj_list) {
+        p = list_entry(el, JSGCObjectHeader, link);
+        assert(p->mark == GC_MARK_NONE);
+        p->mark = GC_MARK_PENDING;
+    }
+
     /* decrement the refcount of all the children of all the GC
        objects and move the GC objects with zero refcount to
        tmp_obj_list */
     list_for_each_safe(el, el1, &rt->gc_obj_list) {
         p = list_entry(el, JSGCObjectHeader, link);
-        assert(p->mark == 0);
+        assert(p->mark == GC_MARK_PENDING);
         mark_children(rt, p, gc_decref_child);
-        p->mark = 1;
+        p->mark = GC_MARK_DECREF;
         if (p->ref_count == 0) {
             list_del(&p->link);
             list_add_tail(&p->link, &rt->tmp_obj_list);
@@ -5719,18 +6478,21 @@ static void gc_decref(JSRuntime *rt)
 
 static void gc_scan_incref_child(JSRuntime *rt, JSGCObjectHeader *p)
 {
+    if (p->mark == GC_MARK_NONE)
+        return;
     p->ref_count++;
     if (p->ref_count == 1) {
         /* ref_count was 0: remove from tmp_obj_list and add at the
            end of gc_obj_list */
         list_del(&p->link);
         list_add_tail(&p->link, &rt->gc_obj_list);
-        p->mark = 0; /* reset the mark for the next GC call */
     }
 }
 
 static void gc_scan_incref_child2(JSRuntime *rt, JSGCObjectHeader *p)
 {
+    if (p->mark == GC_MARK_NONE)
+        return;
     p->ref_count++;
 }
 
@@ -5743,7 +6505,7 @@ static void gc_scan(JSRuntime *rt)
     list_for_each(el, &rt->gc_obj_list) {
         p = list_entry(el, JSGCObjectHeader, link);
         assert(p->ref_count > 0);
-        p->mark = 0; /* reset the mark for the next GC call */
+        p->mark = GC_MARK_LIVE;
         mark_children(rt, p, gc_scan_incref_child);
     }
 
@@ -5752,6 +6514,12 @@ static void gc_scan(JSRuntime *rt)
         p = list_entry(el, JSGCObjectHeader, link);
         mark_children(rt, p, gc_scan_incref_child2);
     }
+
+    /* reset the mark for the next GC call */
+    list_for_each(el, &rt->gc_obj_list) {
+        p = list_entry(el, JSGCObjectHeader, link);
+        p->mark = GC_MARK_NONE;
+    }
 }
 
 static void gc_free_cycles(JSRuntime *rt)
@@ -5793,20 +6561,62 @@ static void gc_free_cycles(JSRuntime *rt)
     }
     rt->gc_phase = JS_GC_PHASE_NONE;
 
+    /* the freed objects of the cycles keep their mark. The remaining
+       ones are not collected objects which lost their last reference
+       meanwhile: they are freed normally */
     list_for_each_safe(el, el1, &rt->gc_zero_ref_count_list) {
         p = list_entry(el, JSGCObjectHeader, link);
         assert(p->gc_obj_type == JS_GC_OBJ_TYPE_JS_OBJECT ||
                p->gc_obj_type == JS_GC_OBJ_TYPE_FUNCTION_BYTECODE);
-        js_free_rt(rt, p);
+        if (p->mark != GC_MARK_NONE) {
+            list_del(&p->link);
+            js_free_rt(rt, p);
+        }
     }
 
-    init_list_head(&rt->gc_zero_ref_count_list);
+    free_zero_refcount(rt);
 }
 
-void JS_RunGC(JSRuntime *rt)
+/* move the elements of 'src' at the end of 'dst' */
+static void gc_list_splice_tail(struct list_head *dst, struct list_head *src)
+{
+    if (list_empty(src))
+        return;
+    src->next->prev = dst->prev;
+    dst->prev->next = src->next;
+    src->prev->next = dst;
+    dst->prev = src->prev;
+    init_list_head(src);
+}
+
+/* monotonic time in microseconds */
+static int64_t gc_get_time_us(void)
+{
+#ifdef CLOCK_MONOTONIC
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + (ts.tv_nsec / 1000);
+#else
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+#endif
+}
+
+static void gc_add_pause(JSRuntime *rt, int64_t start_time)
+{
+    int64_t d;
+    d = max_int64(gc_get_time_us() - start_time, 0);
+    rt->gc_pause_max = max_int64(rt->gc_pause_max, d);
+    rt->gc_pause_samples[(rt->gc_count + rt->gc_young_count) %
+                         JS_GC_PAUSE_SAMPLES] = min_int64(d, UINT32_MAX);
+}
+
+/* collect the cycles of gc_obj_list */
+static void gc_collect(JSRuntime *rt)
 {
     /* decrement the reference of the children of each object. mark =
-       1 after this pass. */
+       GC_MARK_DECREF after this pass. */
     gc_decref(rt);
 
     /* keep the GC objects with a non zero refcount and their childs */
@@ -5816,6 +6626,41 @@ void JS_RunGC(JSRuntime *rt)
     gc_free_cycles(rt);
 }
 
+void JS_RunGC(JSRuntime *rt)
+{
+    int64_t start_time;
+
+    start_time = gc_get_time_us();
+    gc_list_splice_tail(&rt->gc_obj_list, &rt->gc_young_obj_list);
+    rt->gc_young_alloc_count = 0;
+    gc_collect(rt);
+    gc_add_pause(rt, start_time);
+    rt->gc_count++;
+}
+
+/* Collect the cycles made only of objects allocated since the last
+   collection. The reference counts being exact, the references from the
+   older objects are seen as external references, so the result is
+   correct without any write barrier. The surviving objects become old. */
+static void gc_run_young(JSRuntime *rt)
+{
+    struct list_head old_list;
+    int64_t start_time;
+
+    start_time = gc_get_time_us();
+    init_list_head(&old_list);
+    gc_list_splice_tail(&old_list, &rt->gc_obj_list);
+    gc_list_splice_tail(&rt->gc_obj_list, &rt->gc_young_obj_list);
+    rt->gc_young_alloc_count = 0;
+
+    gc_collect(rt);
+
+    gc_list_splice_tail(&old_list, &rt->gc_obj_list);
+    gc_list_splice_tail(&rt->gc_obj_list, &old_list);
+    gc_add_pause(rt, start_time);
+    rt->gc_young_count++;
+}
+
 /* Return false if not an object or if the object has already been
    freed (zombie objects are visible in finalizers when freeing
    cycles). */
@@ -5875,6 +6720,14 @@ static void compute_bytecode_size(JSFunctionBytecode *b, JSMemoryUsage_helper *h
     if (!b->read_only_bytecode && b->byte_code_buf) {
         hp->js_func_code_size += b->byte_code_len;
     }
+    if (b->ic) {
+        memory_used_count++;
+        js_func_size += b->ic_count * sizeof(*b->ic);
+    }
+    if (b->global_ic) {
+        memory_used_count++;
+        js_func_size += b->global_ic_count * sizeof(*b->global_ic);
+    }
     if (b->has_debug) {
         js_func_size += sizeof(*b) - offsetof(JSFunctionBytecode, debug);
         if (b->debug.source) {
@@ -5908,6 +6761,31 @@ static void compute_value_size(JSValueConst val, JSMemoryUsage_helper *hp)
     }
 }
 
+static int gc_pause_cmp(const void *a, const void *b, void *opaque)
+{
+    uint32_t v1 = *(const uint32_t *)a;
+    uint32_t v2 = *(const uint32_t *)b;
+    return (v1 > v2) - (v1 < v2);
+}
+
+static void compute_gc_pauses(JSRuntime *rt, JSMemoryUsage *s)
+{
+    uint32_t tab[JS_GC_PAUSE_SAMPLES];
+    int n;
+
+    s->gc_count = rt->gc_count;
+    s->gc_young_count = rt->gc_young_count;
+    s->gc_pause_max = rt->gc_pause_max;
+    n = min_int64(rt->gc_count + rt->gc_young_count, JS_GC_PAUSE_SAMPLES);
+    if (n == 0)
+        return;
+    memcpy(tab, rt->gc_pause_samples, sizeof(tab[0]) * n);
+    rqsort(tab, n, sizeof(tab[0]), gc_pause_cmp, NULL);
+    s->gc_pause_p50 = tab[(n - 1) * 50 / 100];
+    s->gc_pause_p90 = tab[(n - 1) * 90 / 100];
+    s->gc_pause_p99 = tab[(n - 1) * 99 / 100];
+}
+
 void JS_ComputeMemoryUsage(JSRuntime *rt, JSMemoryUsage *s)
 {
     struct list_head *el, *el1;
@@ -5918,6 +6796,8 @@ void JS_ComputeMemoryUsage(JSRuntime *rt, JSMemoryUsage *s)
     s->malloc_count = rt->malloc_state.malloc_count;
     s->malloc_size = rt->malloc_state.malloc_size;
     s->malloc_limit = rt->malloc_state.malloc_limit;
+    s->external_memory_size = rt->external_memory_size;
+    compute_gc_pauses(rt, s);
 
     s->memory_used_count = 2; /* rt + rt->class_array */
     s->memory_used_size = sizeof(JSRuntime) + sizeof(JSValue) * rt->class_count;
@@ -5933,7 +6813,7 @@ void JS_ComputeMemoryUsage(JSRuntime *rt, JSMemoryUsage *s)
 
         /* the hashed shapes are counted separately */
         if (sh && !sh->is_hashed) {
-            int hash_size = sh->prop_hash_mask + 1;
+            int hash_size = get_shape_hash_size(sh);
             s->shape_count++;
             s->shape_size += get_shape_size(hash_size, sh->prop_size);
         }
@@ -5970,7 +6850,7 @@ void JS_ComputeMemoryUsage(JSRuntime *rt, JSMemoryUsage *s)
         }
     }
 
-    list_for_each(el, &rt->gc_obj_list) {
+    list_for_each_gc_obj(el, rt) {
         JSGCObjectHeader *gp = list_entry(el, JSGCObjectHeader, link);
         JSObject *p;
         JSShape *sh;
@@ -6001,7 +6881,7 @@ void JS_ComputeMemoryUsage(JSRuntime *rt, JSMemoryUsage *s)
         }
         /* the hashed shapes are counted separately */
         if (!sh->is_hashed) {
-            int hash_size = sh->prop_hash_mask + 1;
+            int hash_size = get_shape_hash_size(sh);
             s->shape_count++;
             s->shape_size += get_shape_size(hash_size, sh->prop_size);
         }
@@ -6164,7 +7044,7 @@ void JS_ComputeMemoryUsage(JSRuntime *rt, JSMemoryUsage *s)
     for(i = 0; i < rt->shape_hash_size; i++) {
         JSShape *sh;
         for(sh = rt->shape_hash[i]; sh != NULL; sh = sh->shape_hash_next) {
-            int hash_size = sh->prop_hash_mask + 1;
+            int hash_size = get_shape_hash_size(sh);
             s->shape_count++;
             s->shape_size += get_shape_size(hash_size, sh->prop_size);
         }
@@ -6239,7 +7119,7 @@ void JS_DumpMemoryUsage(FILE *fp, const JSMemoryUsage *s, JSRuntime *rt)
             int obj_classes[JS_CLASS_INIT_COUNT + 1] = { 0 };
             int class_id;
             struct list_head *el;
-            list_for_each(el, &rt->gc_obj_list) {
+            list_for_each_gc_obj(el, rt) {
                 JSGCObjectHeader *gp = list_entry(el, JSGCObjectHeader, link);
                 JSObject *p;
                 if (gp->gc_obj_type == JS_GC_OBJ_TYPE_JS_OBJECT) {
@@ -6274,6 +7154,10 @@ void JS_DumpMemoryUsage(FILE *fp, const JSMemoryUsage *s, JSRuntime *rt)
                 MALLOC_OVERHEAD, ((double)(s->malloc_size - s->memory_used_size) /
                                   s->memory_used_count));
     }
+    if (s->external_memory_size) {
+        fprintf(fp, "%-20s %8s %8"PRId64"\n",
+                "external memory", "", s->external_memory_size);
+    }
     if (s->atom_count) {
         fprintf(fp, "%-20s %8"PRId64" %8"PRId64"  (%0.1f per atom)\n",
                 "atoms", s->atom_count, s->atom_size,
@@ -6325,6 +7209,13 @@ void JS_DumpMemoryUsage(FILE *fp, const JSMemoryUsage *s, JSRuntime *rt)
         fprintf(fp, "%-20s %8"PRId64" %8"PRId64"\n",
                 "binary objects", s->binary_object_count, s->binary_object_size);
     }
+    if (s->gc_count || s->gc_young_count) {
+        fprintf(fp, "%-20s %8"PRId64"\n", "GC runs", s->gc_count);
+        fprintf(fp, "%-20s %8"PRId64"\n", "  young GC runs", s->gc_young_count);
+        fprintf(fp, "GC pauses (us): p50=%"PRId64" p90=%"PRId64" p99=%"PRId64" max=%"PRId64"\n",
+                s->gc_pause_p50, s->gc_pause_p90, s->gc_pause_p99,
+                s->gc_pause_max);
+    }
 }
 
 JSValue JS_GetGlobalObject(JSContext *ctx)
@@ -6887,6 +7778,7 @@ static JSValueConst JS_GetPrototypePrimitive(JSContext *ctx, JSValueConst val)
     switch(JS_VALUE_GET_NORM_TAG(val)) {
 #ifdef CONFIG_BIGNUM
     case JS_TAG_BIG_INT:
+    case JS_TAG_SHORT_BIG_INT:
         val = ctx->class_proto[JS_CLASS_BIG_INT];
         break;
     case JS_TAG_BIG_FLOAT:
@@ -7990,6 +8882,9 @@ static JSProperty *add_property(JSContext *ctx,
     JSShape *sh, *new_sh;
 
     sh = p->shape;
+    /* a new global_var_obj property may hide a global_obj one */
+    if (unlikely(sh->is_global))
+        ctx->rt->global_var_version++;
     if (sh->is_hashed) {
         /* try to find an existing shape */
         new_sh = find_hashed_shape_prop(ctx->rt, sh, prop, prop_flags);
@@ -8071,11 +8966,20 @@ static int delete_property(JSContext *ctx, JSObject *p, JSAtom atom)
 
  redo:
     sh = p->shape;
-    h1 = atom & sh->prop_hash_mask;
-    h = prop_hash_end(sh)[-h1 - 1];
     prop = get_shape_prop(sh);
     lpr = NULL;
     lpr_idx = 0;   /* prevent warning */
+    if (sh->is_small) {
+        /* linear search */
+        h1 = 0;
+        for(h = sh->prop_count; h != 0; h--) {
+            if (prop[h - 1].atom == atom && atom != JS_ATOM_NULL)
+                break;
+        }
+    } else {
+        h1 = atom & sh->prop_hash_mask;
+        h = prop_hash_end(sh)[-h1 - 1];
+    }
     while (h != 0) {
         pr = &prop[h - 1];
         if (likely(pr->atom == atom)) {
@@ -8092,7 +8996,7 @@ static int delete_property(JSContext *ctx, JSObject *p, JSAtom atom)
             if (lpr) {
                 lpr = get_shape_prop(sh) + lpr_idx;
                 lpr->hash_next = pr->hash_next;
-            } else {
+            } else if (!sh->is_small) {
                 prop_hash_end(sh)[-h1 - 1] = pr->hash_next;
             }
             sh->deleted_prop_count++;
@@ -8985,6 +9889,8 @@ static int js_shape_prepare_update(JSContext *ctx, JSObject *p,
     uint32_t idx = 0;    /* prevent warning */
 
     sh = p->shape;
+    if (unlikely(sh->is_global))
+        ctx->rt->global_var_version++;
     if (sh->is_hashed) {
         if (sh->header.ref_count != 1) {
             if (pprs)
@@ -9005,6 +9911,20 @@ static int js_shape_prepare_update(JSContext *ctx, JSObject *p,
     return 0;
 }
 
+/* give a private unhashed shape to a global object so that its
+   modifications can be tracked by the global variable caches */
+static void js_shape_set_global(JSContext *ctx, JSValueConst obj)
+{
+    JSObject *p;
+
+    if (JS_VALUE_GET_TAG(obj) != JS_TAG_OBJECT)
+        return;
+    p = JS_VALUE_GET_OBJ(obj);
+    if (js_shape_prepare_update(ctx, p, NULL))
+        return;
+    p->shape->is_global = TRUE;
+}
+
 static int js_update_property_flags(JSContext *ctx, JSObject *p,
                                     JSShapeProperty **pprs, int flags)
 {
@@ -9946,6 +10866,8 @@ static int JS_ToBoolFree(JSContext *ctx, JSValue val)
             return ret;
         }
 #ifdef CONFIG_BIGNUM
+    case JS_TAG_SHORT_BIG_INT:
+        return JS_VALUE_GET_SHORT_BIG_INT(val) != 0;
     case JS_TAG_BIG_INT:
     case JS_TAG_BIG_FLOAT:
         {
@@ -10434,6 +11356,7 @@ static JSValue JS_ToNumberHintFree(JSContext *ctx, JSValue val,
         ret = val;
         break;
     case JS_TAG_BIG_INT:
+    case JS_TAG_SHORT_BIG_INT:
         if (flag != TON_FLAG_NUMERIC) {
             JS_FreeValue(ctx, val);
             return JS_ThrowTypeError(ctx, "cannot convert bigint to number");
@@ -10539,6 +11462,9 @@ static __exception int __JS_ToFloat64Free(JSContext *ctx, double *pres,
         d = JS_VALUE_GET_FLOAT64(val);
         break;
 #ifdef CONFIG_BIGNUM
+    case JS_TAG_SHORT_BIG_INT:
+        d = JS_VALUE_GET_SHORT_BIG_INT(val);
+        break;
     case JS_TAG_BIG_INT:
     case JS_TAG_BIG_FLOAT:
         {
@@ -11019,6 +11945,15 @@ static __exception int JS_ToArrayLengthFree(JSContext *ctx, uint32_t *plen,
         }
         break;
 #ifdef CONFIG_BIGNUM
+    case JS_TAG_SHORT_BIG_INT:
+        {
+            int64_t v;
+            v = JS_VALUE_GET_SHORT_BIG_INT(val);
+            if (v < 0 || v > UINT32_MAX)
+                goto fail;
+            len = v;
+        }
+        break;
     case JS_TAG_BIG_INT:
     case JS_TAG_BIG_FLOAT:
         {
@@ -11140,6 +12075,8 @@ static BOOL JS_NumberIsNegativeOrMinusZero(JSContext *ctx, JSValueConst val)
             return (u.u64 >> 63);
         }
 #ifdef CONFIG_BIGNUM
+    case JS_TAG_SHORT_BIG_INT:
+        return JS_VALUE_GET_SHORT_BIG_INT(val) < 0;
     case JS_TAG_BIG_INT:
         {
             JSBigFloat *p = JS_VALUE_GET_PTR(val);
@@ -11173,6 +12110,12 @@ static JSValue js_bigint_to_string1(JSContext *ctx, JSValueConst val, int radix)
     char *str;
     int saved_sign;
 
+    if (JS_VALUE_GET_TAG(val) == JS_TAG_SHORT_BIG_INT && radix == 10) {
+        char buf[32];
+        snprintf(buf, sizeof(buf), "%" PRId64,
+                 (int64_t)JS_VALUE_GET_SHORT_BIG_INT(val));
+        return JS_NewString(ctx, buf);
+    }
     a = JS_ToBigInt(ctx, &a_s, val);
     if (!a)
         return JS_EXCEPTION;
@@ -11597,6 +12540,7 @@ JSValue JS_ToStringInternal(JSContext *ctx, JSValueConst val, BOOL is_ToProperty
                        JS_DTOA_VAR_FORMAT);
 #ifdef CONFIG_BIGNUM
     case JS_TAG_BIG_INT:
+    case JS_TAG_SHORT_BIG_INT:
         return ctx->rt->bigint_ops.to_string(ctx, val);
     case JS_TAG_BIG_FLOAT:
         return ctx->rt->bigfloat_ops.to_string(ctx, val);
@@ -11643,26 +12587,26 @@ static JSValue JS_ToStringCheckObject(JSContext *ctx, JSValueConst val)
     return JS_ToString(ctx, val);
 }
 
-static JSValue JS_ToQuotedString(JSContext *ctx, JSValueConst val1)
+/* append 'p' as a JSON quoted string */
+static int string_buffer_put_quoted(StringBuffer *b, const JSString *p)
 {
-    JSValue val;
-    JSString *p;
-    int i;
+    int i, n;
     uint32_t c;
-    StringBuffer b_s, *b = &b_s;
     char buf[16];
 
-    val = JS_ToStringCheckObject(ctx, val1);
-    if (JS_IsException(val))
-        return val;
-    p = JS_VALUE_GET_STRING(val);
-
-    if (string_buffer_init(ctx, b, p->len + 2))
-        goto fail;
-
     if (string_buffer_putc8(b, '\"'))
-        goto fail;
+        return -1;
     for(i = 0; i < p->len; ) {
+        if (!p->is_wide_char) {
+            /* copy the run of characters which need no escaping */
+            n = str8_plain_len(p->u.str8 + i, p->len - i, '\"');
+            if (n > 0) {
+                if (string_buffer_write8(b, p->u.str8 + i, n))
+                    return -1;
+                i += n;
+                continue;
+            }
+        }
         c = string_getc(p, &i);
         switch(c) {
         case '\t':
@@ -11684,23 +12628,39 @@ static JSValue JS_ToQuotedString(JSContext *ctx, JSValueConst val1)
         case '\\':
         quote:
             if (string_buffer_putc8(b, '\\'))
-                goto fail;
+                return -1;
             if (string_buffer_putc8(b, c))
-                goto fail;
+                return -1;
             break;
         default:
             if (c < 32 || (c >= 0xd800 && c < 0xe000)) {
                 snprintf(buf, sizeof(buf), "\\u%04x", c);
                 if (string_buffer_puts8(b, buf))
-                    goto fail;
+                    return -1;
             } else {
                 if (string_buffer_putc(b, c))
-                    goto fail;
+                    return -1;
             }
             break;
         }
     }
-    if (string_buffer_putc8(b, '\"'))
+    return string_buffer_putc8(b, '\"');
+}
+
+static JSValue JS_ToQuotedString(JSContext *ctx, JSValueConst val1)
+{
+    JSValue val;
+    JSString *p;
+    StringBuffer b_s, *b = &b_s;
+
+    val = JS_ToStringCheckObject(ctx, val1);
+    if (JS_IsException(val))
+        return val;
+    p = JS_VALUE_GET_STRING(val);
+
+    if (string_buffer_init(ctx, b, p->len + 2))
+        goto fail;
+    if (string_buffer_put_quoted(b, p))
         goto fail;
     JS_FreeValue(ctx, val);
     return string_buffer_end(b);
@@ -11889,6 +12849,9 @@ static __maybe_unused void JS_DumpValueShort(JSRuntime *rt,
         printf("%.14g", JS_VALUE_GET_FLOAT64(val));
         break;
 #ifdef CONFIG_BIGNUM
+    case JS_TAG_SHORT_BIG_INT:
+        printf("%" PRId64 "n", (int64_t)JS_VALUE_GET_SHORT_BIG_INT(val));
+        break;
     case JS_TAG_BIG_INT:
         {
             JSBigFloat *p = JS_VALUE_GET_PTR(val);
@@ -12006,6 +12969,8 @@ JSValue JS_NewBigInt64_1(JSContext *ctx, int64_t v)
 {
     JSValue val;
     bf_t *a;
+    if (js_is_short_big_int(v))
+        return __JS_NewShortBigInt(ctx, v);
     val = JS_NewBigInt(ctx);
     if (JS_IsException(val))
         return val;
@@ -12032,6 +12997,8 @@ JSValue JS_NewBigUint64(JSContext *ctx, uint64_t v)
     JSValue val;
     if (is_math_mode(ctx) && v <= MAX_SAFE_INTEGER) {
         val = JS_NewInt64(ctx, v);
+    } else if (v <= JS_SHORT_BIG_INT_MAX) {
+        val = __JS_NewShortBigInt(ctx, v);
     } else {
         bf_t *a;
         val = JS_NewBigInt(ctx);
@@ -12074,6 +13041,12 @@ static bf_t *JS_ToBigFloat(JSContext *ctx, bf_t *buf, JSValueConst val)
             return NULL;
         }
         break;
+    case JS_TAG_SHORT_BIG_INT:
+        r = buf;
+        bf_init(ctx->bf_ctx, r);
+        if (bf_set_si(r, JS_VALUE_GET_SHORT_BIG_INT(val)))
+            goto fail;
+        break;
     case JS_TAG_BIG_INT:
     case JS_TAG_BIG_FLOAT:
         p = JS_VALUE_GET_PTR(val);
@@ -12185,6 +13158,11 @@ static bf_t *JS_ToBigIntFree(JSContext *ctx, bf_t *buf, JSValue val)
             bf_set_float64(r, d);
         }
         break;
+    case JS_TAG_SHORT_BIG_INT:
+        r = buf;
+        bf_init(ctx->bf_ctx, r);
+        bf_set_si(r, JS_VALUE_GET_SHORT_BIG_INT(val));
+        break;
     case JS_TAG_BIG_INT:
         p = JS_VALUE_GET_PTR(val);
         r = &p->num;
@@ -12227,7 +13205,7 @@ static bf_t *JS_ToBigInt(JSContext *ctx, bf_t *buf, JSValueConst val)
 
 static __maybe_unused JSValue JS_ToBigIntValueFree(JSContext *ctx, JSValue val)
 {
-    if (JS_VALUE_GET_TAG(val) == JS_TAG_BIG_INT) {
+    if (tag_is_big_int(JS_VALUE_GET_TAG(val))) {
         return val;
     } else {
         bf_t a_s, *a, *r;
@@ -12270,6 +13248,10 @@ static int JS_ToBigInt64Free(JSContext *ctx, int64_t *pres, JSValue val)
 {
     bf_t a_s, *a;
 
+    if (JS_VALUE_GET_TAG(val) == JS_TAG_SHORT_BIG_INT) {
+        *pres = JS_VALUE_GET_SHORT_BIG_INT(val);
+        return 0;
+    }
     a = JS_ToBigIntFree(ctx, &a_s, val);
     if (!a) {
         *pres = 0;
@@ -12338,22 +13320,24 @@ static JSValue JS_CompactBigInt1(JSContext *ctx, JSValue val,
     if (JS_VALUE_GET_TAG(val) != JS_TAG_BIG_INT)
         return val; /* fail safe */
     a = JS_GetBigInt(val);
-    if (convert_to_safe_integer && bf_get_int64(&v, a, 0) == 0 &&
-        v >= -MAX_SAFE_INTEGER && v <= MAX_SAFE_INTEGER) {
-        JS_FreeValue(ctx, val);
-        return JS_NewInt64(ctx, v);
-    } else if (a->expn == BF_EXP_ZERO && a->sign) {
-        JSBigFloat *p = JS_VALUE_GET_PTR(val);
-        assert(p->header.ref_count == 1);
-        a->sign = 0;
+    if (bf_get_int64(&v, a, 0) == 0) {
+        if (convert_to_safe_integer &&
+            v >= -MAX_SAFE_INTEGER && v <= MAX_SAFE_INTEGER) {
+            JS_FreeValue(ctx, val);
+            return JS_NewInt64(ctx, v);
+        }
+        /* a big int is never equal to a short big int */
+        if (js_is_short_big_int(v)) {
+            JS_FreeValue(ctx, val);
+            return __JS_NewShortBigInt(ctx, v);
+        }
     }
     return val;
 }
 
-/* Convert the big int to a safe integer if in math mode. normalize
-   the zero representation. Could also be used to convert the bigint
-   to a short bigint value. The reference count of the value must be
-   1. Cannot fail */
+/* Convert the big int to a safe integer if in math mode, otherwise to
+   a short big int if it is small enough. The reference count of the
+   value must be 1. Cannot fail */
 static JSValue JS_CompactBigInt(JSContext *ctx, JSValue val)
 {
     return JS_CompactBigInt1(ctx, val, is_math_mode(ctx));
@@ -12697,6 +13681,121 @@ static JSValue throw_bf_exception(JSContext *ctx, int status)
     return JS_ThrowRangeError(ctx, "%s", str);
 }
 
+/* Operations on short big ints without overflow. Return FALSE if
+   the generic code must be used. */
+static BOOL js_unary_arith_short_bigint(JSContext *ctx, JSValue *pres,
+                                        OPCodeEnum op, int64_t a)
+{
+    int64_t r;
+
+    switch(op) {
+    case OP_inc:
+        if (a == INT64_MAX)
+            return FALSE;
+        r = a + 1;
+        break;
+    case OP_dec:
+        if (a == INT64_MIN)
+            return FALSE;
+        r = a - 1;
+        break;
+    case OP_neg:
+        if (a == INT64_MIN)
+            return FALSE;
+        r = -a;
+        break;
+    case OP_not:
+        r = ~a;
+        break;
+    default:
+        return FALSE;
+    }
+    if (!js_is_short_big_int(r))
+        return FALSE;
+    *pres = __JS_NewShortBigInt(ctx, r);
+    return TRUE;
+}
+
+static BOOL js_binary_arith_short_bigint(JSContext *ctx, OPCodeEnum op,
+                                         JSValue *pres, int64_t a, int64_t b)
+{
+    int64_t r;
+
+    switch(op) {
+    case OP_add:
+        r = (uint64_t)a + (uint64_t)b;
+        if (((a ^ r) & (b ^ r)) < 0)
+            return FALSE;
+        break;
+    case OP_sub:
+        r = (uint64_t)a - (uint64_t)b;
+        if (((a ^ b) & (a ^ r)) < 0)
+            return FALSE;
+        break;
+    case OP_mul:
+#if JS_SHORT_BIG_INT_BITS == 32
+        r = a * b;
+#else
+        {
+            int128_t r1 = (int128_t)a * b;
+            if (r1 < INT64_MIN || r1 > INT64_MAX)
+                return FALSE;
+            r = r1;
+        }
+#endif
+        break;
+    case OP_div:
+        if (b == 0 || b == -1)
+            return FALSE;
+        r = a / b;
+        break;
+    case OP_mod:
+        if (b == 0 || b == -1)
+            return FALSE;
+        r = a % b;
+        break;
+    case OP_shl:
+    case OP_sar:
+        if (b == INT64_MIN)
+            return FALSE;
+        if (op == OP_sar)
+            b = -b;
+        if (b >= 0) {
+            if (b >= 64) {
+                if (a != 0)
+                    return FALSE;
+                r = 0;
+            } else {
+                r = (uint64_t)a << b;
+                if ((r >> b) != a)
+                    return FALSE;
+            }
+        } else {
+            b = -b;
+            if (b >= 64)
+                r = a >> 63;
+            else
+                r = a >> b;
+        }
+        break;
+    case OP_and:
+        r = a & b;
+        break;
+    case OP_or:
+        r = a | b;
+        break;
+    case OP_xor:
+        r = a ^ b;
+        break;
+    default:
+        return FALSE;
+    }
+    if (!js_is_short_big_int(r))
+        return FALSE;
+    *pres = __JS_NewShortBigInt(ctx, r);
+    return TRUE;
+}
+
 static int js_unary_arith_bigint(JSContext *ctx,
                                  JSValue *pres, OPCodeEnum op, JSValue op1)
 {
@@ -12709,6 +13808,10 @@ static int js_unary_arith_bigint(JSContext *ctx,
         JS_FreeValue(ctx, op1);
         return -1;
     }
+    if (JS_VALUE_GET_TAG(op1) == JS_TAG_SHORT_BIG_INT && !is_math_mode(ctx) &&
+        js_unary_arith_short_bigint(ctx, pres, op,
+                                    JS_VALUE_GET_SHORT_BIG_INT(op1)))
+        return 0;
     res = JS_NewBigInt(ctx);
     if (JS_IsException(res)) {
         JS_FreeValue(ctx, op1);
@@ -12900,6 +14003,7 @@ static no_inline __exception int js_unary_arith_slow(JSContext *ctx,
         }
         break;
     case JS_TAG_BIG_INT:
+    case JS_TAG_SHORT_BIG_INT:
     handle_bigint:
         if (ctx->rt->bigint_ops.unary_arith(ctx, sp - 1, op, op1))
             goto exception;
@@ -12980,7 +14084,7 @@ static no_inline int js_not_slow(JSContext *ctx, JSValue *sp)
     op1 = JS_ToNumericFree(ctx, op1);
     if (JS_IsException(op1))
         goto exception;
-    if (is_math_mode(ctx) || JS_VALUE_GET_TAG(op1) == JS_TAG_BIG_INT) {
+    if (is_math_mode(ctx) || tag_is_big_int(JS_VALUE_GET_TAG(op1))) {
         if (ctx->rt->bigint_ops.unary_arith(ctx, sp - 1, OP_not, op1))
             goto exception;
     } else {
@@ -13063,6 +14167,12 @@ static int js_binary_arith_bigint(JSContext *ctx, OPCodeEnum op,
     int ret;
     JSValue res;
 
+    if (JS_VALUE_GET_TAG(op1) == JS_TAG_SHORT_BIG_INT &&
+        JS_VALUE_GET_TAG(op2) == JS_TAG_SHORT_BIG_INT && !is_math_mode(ctx) &&
+        js_binary_arith_short_bigint(ctx, op, pres,
+                                     JS_VALUE_GET_SHORT_BIG_INT(op1),
+                                     JS_VALUE_GET_SHORT_BIG_INT(op2)))
+        return 0;
     res = JS_NewBigInt(ctx);
     if (JS_IsException(res))
         goto fail;
@@ -13411,7 +14521,7 @@ static no_inline __exception int js_binary_arith_slow(JSContext *ctx, JSValue *s
     } else if (tag1 == JS_TAG_BIG_FLOAT || tag2 == JS_TAG_BIG_FLOAT) {
         if (ctx->rt->bigfloat_ops.binary_arith(ctx, op, sp - 2, op1, op2))
             goto exception;
-    } else if (tag1 == JS_TAG_BIG_INT || tag2 == JS_TAG_BIG_INT) {
+    } else if (tag_is_big_int(tag1) || tag_is_big_int(tag2)) {
     handle_bigint:
         if (ctx->rt->bigint_ops.binary_arith(ctx, op, sp - 2, op1, op2))
             goto exception;
@@ -13552,7 +14662,7 @@ static no_inline __exception int js_add_slow(JSContext *ctx, JSValue *sp)
     } else if (tag1 == JS_TAG_BIG_FLOAT || tag2 == JS_TAG_BIG_FLOAT) {
         if (ctx->rt->bigfloat_ops.binary_arith(ctx, OP_add, sp - 2, op1, op2))
             goto exception;
-    } else if (tag1 == JS_TAG_BIG_INT || tag2 == JS_TAG_BIG_INT) {
+    } else if (tag_is_big_int(tag1) || tag_is_big_int(tag2)) {
     handle_bigint:
         if (ctx->rt->bigint_ops.binary_arith(ctx, OP_add, sp - 2, op1, op2))
             goto exception;
@@ -13624,8 +14734,8 @@ static no_inline __exception int js_binary_logic_slow(JSContext *ctx,
 
     tag1 = JS_VALUE_GET_TAG(op1);
     tag2 = JS_VALUE_GET_TAG(op2);
-    if (tag1 == JS_TAG_BIG_INT || tag2 == JS_TAG_BIG_INT) {
-        if (tag1 != tag2) {
+    if (tag_is_big_int(tag1) || tag_is_big_int(tag2)) {
+        if (tag_is_big_int(tag1) != tag_is_big_int(tag2)) {
             JS_FreeValue(ctx, op1);
             JS_FreeValue(ctx, op2);
             JS_ThrowTypeError(ctx, "both operands must be bigint");
@@ -13831,18 +14941,37 @@ static no_inline int js_relational_slow(JSContext *ctx, JSValue *sp,
                (tag2 <= JS_TAG_NULL || tag2 == JS_TAG_FLOAT64)) {
         /* fast path for float64/int */
         goto float64_compare;
+    } else if (tag1 == JS_TAG_SHORT_BIG_INT && tag2 == JS_TAG_SHORT_BIG_INT) {
+        int64_t v1, v2;
+        v1 = JS_VALUE_GET_SHORT_BIG_INT(op1);
+        v2 = JS_VALUE_GET_SHORT_BIG_INT(op2);
+        switch(op) {
+        case OP_lt:
+            res = (v1 < v2);
+            break;
+        case OP_lte:
+            res = (v1 <= v2);
+            break;
+        case OP_gt:
+            res = (v1 > v2);
+            break;
+        default:
+        case OP_gte:
+            res = (v1 >= v2);
+            break;
+        }
     } else {
-        if (((tag1 == JS_TAG_BIG_INT && tag2 == JS_TAG_STRING) ||
-             (tag2 == JS_TAG_BIG_INT && tag1 == JS_TAG_STRING)) &&
+        if (((tag_is_big_int(tag1) && tag2 == JS_TAG_STRING) ||
+             (tag_is_big_int(tag2) && tag1 == JS_TAG_STRING)) &&
             !is_math_mode(ctx)) {
             if (tag1 == JS_TAG_STRING) {
                 op1 = JS_StringToBigInt(ctx, op1);
-                if (JS_VALUE_GET_TAG(op1) != JS_TAG_BIG_INT)
+                if (!tag_is_big_int(JS_VALUE_GET_TAG(op1)))
                     goto invalid_bigint_string;
             }
             if (tag2 == JS_TAG_STRING) {
                 op2 = JS_StringToBigInt(ctx, op2);
-                if (JS_VALUE_GET_TAG(op2) != JS_TAG_BIG_INT) {
+                if (!tag_is_big_int(JS_VALUE_GET_TAG(op2))) {
                 invalid_bigint_string:
                     JS_FreeValue(ctx, op1);
                     JS_FreeValue(ctx, op2);
@@ -13874,7 +15003,7 @@ static no_inline int js_relational_slow(JSContext *ctx, JSValue *sp,
             res = ctx->rt->bigfloat_ops.compare(ctx, op, op1, op2);
             if (res < 0)
                 goto exception;
-        } else if (tag1 == JS_TAG_BIG_INT || tag2 == JS_TAG_BIG_INT) {
+        } else if (tag_is_big_int(tag1) || tag_is_big_int(tag2)) {
             res = ctx->rt->bigint_ops.compare(ctx, op, op1, op2);
             if (res < 0)
                 goto exception;
@@ -13922,6 +15051,7 @@ static no_inline int js_relational_slow(JSContext *ctx, JSValue *sp,
 static BOOL tag_is_number(uint32_t tag)
 {
     return (tag == JS_TAG_INT || tag == JS_TAG_BIG_INT ||
+            tag == JS_TAG_SHORT_BIG_INT ||
             tag == JS_TAG_FLOAT64 || tag == JS_TAG_BIG_FLOAT ||
             tag == JS_TAG_BIG_DECIMAL);
 }
@@ -13957,6 +15087,10 @@ static no_inline __exception int js_eq_slow(JSContext *ctx, JSValue *sp,
                 d2 = JS_VALUE_GET_INT(op2);
             }
             res = (d1 == d2);
+        } else if (tag1 == JS_TAG_SHORT_BIG_INT &&
+                   tag2 == JS_TAG_SHORT_BIG_INT) {
+            res = (JS_VALUE_GET_SHORT_BIG_INT(op1) ==
+                   JS_VALUE_GET_SHORT_BIG_INT(op2));
         } else if (tag1 == JS_TAG_BIG_DECIMAL || tag2 == JS_TAG_BIG_DECIMAL) {
             res = ctx->rt->bigdecimal_ops.compare(ctx, OP_eq, op1, op2);
             if (res < 0)
@@ -13994,16 +15128,16 @@ static no_inline __exception int js_eq_slow(JSContext *ctx, JSValue *sp,
     } else if ((tag1 == JS_TAG_STRING && tag_is_number(tag2)) ||
                (tag2 == JS_TAG_STRING && tag_is_number(tag1))) {
 
-        if ((tag1 == JS_TAG_BIG_INT || tag2 == JS_TAG_BIG_INT) &&
+        if ((tag_is_big_int(tag1) || tag_is_big_int(tag2)) &&
             !is_math_mode(ctx)) {
             if (tag1 == JS_TAG_STRING) {
                 op1 = JS_StringToBigInt(ctx, op1);
-                if (JS_VALUE_GET_TAG(op1) != JS_TAG_BIG_INT)
+                if (!tag_is_big_int(JS_VALUE_GET_TAG(op1)))
                     goto invalid_bigint_string;
             }
             if (tag2 == JS_TAG_STRING) {
                 op2 = JS_StringToBigInt(ctx, op2);
-                if (JS_VALUE_GET_TAG(op2) != JS_TAG_BIG_INT) {
+                if (!tag_is_big_int(JS_VALUE_GET_TAG(op2))) {
                 invalid_bigint_string:
                     JS_FreeValue(ctx, op1);
                     JS_FreeValue(ctx, op2);
@@ -14102,8 +15236,8 @@ static no_inline int js_shr_slow(JSContext *ctx, JSValue *sp)
     }
     /* XXX: could forbid >>> in bignum mode */
     if (!is_math_mode(ctx) &&
-        (JS_VALUE_GET_TAG(op1) == JS_TAG_BIG_INT ||
-         JS_VALUE_GET_TAG(op2) == JS_TAG_BIG_INT)) {
+        (tag_is_big_int(JS_VALUE_GET_TAG(op1)) ||
+         tag_is_big_int(JS_VALUE_GET_TAG(op2)))) {
         JS_ThrowTypeError(ctx, "bigint operands are forbidden for >>>");
         JS_FreeValue(ctx, op1);
         JS_FreeValue(ctx, op2);
@@ -14660,6 +15794,12 @@ static BOOL js_strict_eq2(JSContext *ctx, JSValue op1, JSValue op2,
         }
         goto done_no_free;
 #ifdef CONFIG_BIGNUM
+    case JS_TAG_SHORT_BIG_INT:
+        /* the big ints which fit are always short big ints */
+        res = (tag1 == tag2 &&
+               JS_VALUE_GET_SHORT_BIG_INT(op1) ==
+               JS_VALUE_GET_SHORT_BIG_INT(op2));
+        break;
     case JS_TAG_BIG_INT:
         {
             bf_t a_s, *a, b_s, *b;
@@ -14823,6 +15963,7 @@ static __exception int js_operator_typeof(JSContext *ctx, JSValueConst op1)
     switch(tag) {
 #ifdef CONFIG_BIGNUM
     case JS_TAG_BIG_INT:
+    case JS_TAG_SHORT_BIG_INT:
         atom = JS_ATOM_bigint;
         break;
     case JS_TAG_BIG_FLOAT:
@@ -15564,12 +16705,24 @@ static BOOL js_get_fast_array(JSContext *ctx, JSValueConst obj,
     return FALSE;
 }
 
+/* return TRUE if %ArrayIteratorPrototype%.next is the built-in one */
+static BOOL js_array_iterator_next_is_builtin(JSContext *ctx)
+{
+    JSShapeProperty *prs;
+    JSProperty *pr;
+
+    prs = find_own_property(&pr, JS_VALUE_GET_OBJ(ctx->class_proto[JS_CLASS_ARRAY_ITERATOR]),
+                            JS_ATOM_next);
+    return prs && (prs->flags & JS_PROP_TMASK) == JS_PROP_NORMAL &&
+        JS_IsCFunction(ctx, pr->u.value, (JSCFunction *)js_array_iterator_next, 0);
+}
+
 static __exception int js_append_enumerate(JSContext *ctx, JSValue *sp)
 {
     JSValue iterator, enumobj, method, value;
-    int is_array_iterator;
     JSValue *arrp;
-    uint32_t i, count32, pos;
+    uint32_t i, count32, pos, len;
+    JSObject *p;
 
     if (JS_VALUE_GET_TAG(sp[-2]) != JS_TAG_INT) {
         JS_ThrowInternalError(ctx, "invalid index for append");
@@ -15579,20 +16732,58 @@ static __exception int js_append_enumerate(JSContext *ctx, JSValue *sp)
     pos = JS_VALUE_GET_INT(sp[-2]);
 
     /* XXX: further optimisations:
-       - use ctx->array_proto_values?
-       - check if array_iterator_prototype next method is built-in and
-         avoid constructing actual iterator object?
        - build this into js_for_of_start and use in all `for (x of o)` loops
      */
     iterator = JS_GetProperty(ctx, sp[-1], JS_ATOM_Symbol_iterator);
     if (JS_IsException(iterator))
         return -1;
-    is_array_iterator = JS_IsCFunction(ctx, iterator,
-                                       (JSCFunction *)js_create_array_iterator,
-                                       JS_ITERATOR_KIND_VALUE);
-    JS_FreeValue(ctx, iterator);
+    /* fast arrays iterated with the built-in iterator are copied
+       without creating the iterator object */
+    if (JS_IsCFunction(ctx, iterator, (JSCFunction *)js_create_array_iterator,
+                       JS_ITERATOR_KIND_VALUE)
+    &&  js_get_fast_array(ctx, sp[-1], &arrp, &count32)
+    &&  js_array_iterator_next_is_builtin(ctx)) {
+        if (js_get_length32(ctx, &len, sp[-1])) {
+            JS_FreeValue(ctx, iterator);
+            return -1;
+        }
+        /* if len > count32, the elements >= count32 might be read in
+           the prototypes and might have side effects */
+        if (len == count32) {
+            JS_FreeValue(ctx, iterator);
+            p = JS_VALUE_GET_OBJ(sp[-3]);
+            if (p->class_id == JS_CLASS_ARRAY && p->fast_array &&
+                p->extensible && p->u.array.count == pos &&
+                JS_VALUE_GET_TAG(p->prop[0].u.value) == JS_TAG_INT &&
+                count32 <= INT32_MAX - pos) {
+                if (pos + count32 > p->u.array.u1.size &&
+                    expand_fast_array(ctx, p, pos + count32))
+                    return -1;
+                for (i = 0; i < count32; i++)
+                    p->u.array.u.values[pos + i] = JS_DupValue(ctx, arrp[i]);
+                pos += count32;
+                p->u.array.count = pos;
+                if (pos > JS_VALUE_GET_INT(p->prop[0].u.value))
+                    p->prop[0].u.value = JS_NewInt32(ctx, pos);
+            } else {
+                for (i = 0; i < count32; i++) {
+                    if (JS_DefinePropertyValueUint32(ctx, sp[-3], pos++,
+                                                     JS_DupValue(ctx, arrp[i]), JS_PROP_C_W_E) < 0)
+                        return -1;
+                }
+            }
+            sp[-2] = JS_NewInt32(ctx, pos);
+            return 0;
+        }
+    }
 
-    enumobj = JS_GetIterator(ctx, sp[-1], FALSE);
+    if (!JS_IsFunction(ctx, iterator)) {
+        JS_FreeValue(ctx, iterator);
+        JS_ThrowTypeError(ctx, "value is not iterable");
+        return -1;
+    }
+    enumobj = JS_GetIterator2(ctx, sp[-1], iterator);
+    JS_FreeValue(ctx, iterator);
     if (JS_IsException(enumobj))
         return -1;
     method = JS_GetProperty(ctx, enumobj, JS_ATOM_next);
@@ -15600,36 +16791,17 @@ static __exception int js_append_enumerate(JSContext *ctx, JSValue *sp)
         JS_FreeValue(ctx, enumobj);
         return -1;
     }
-    if (is_array_iterator
-    &&  JS_IsCFunction(ctx, method, (JSCFunction *)js_array_iterator_next, 0)
-    &&  js_get_fast_array(ctx, sp[-1], &arrp, &count32)) {
-        uint32_t len;
-        if (js_get_length32(ctx, &len, sp[-1]))
+    for (;;) {
+        BOOL done;
+        value = JS_IteratorNext(ctx, enumobj, method, 0, NULL, &done);
+        if (JS_IsException(value))
             goto exception;
-        /* if len > count32, the elements >= count32 might be read in
-           the prototypes and might have side effects */
-        if (len != count32)
-            goto general_case;
-        /* Handle fast arrays explicitly */
-        for (i = 0; i < count32; i++) {
-            if (JS_DefinePropertyValueUint32(ctx, sp[-3], pos++,
-                                             JS_DupValue(ctx, arrp[i]), JS_PROP_C_W_E) < 0)
-                goto exception;
-        }
-    } else {
-    general_case:
-        for (;;) {
-            BOOL done;
-            value = JS_IteratorNext(ctx, enumobj, method, 0, NULL, &done);
-            if (JS_IsException(value))
-                goto exception;
-            if (done) {
-                /* value is JS_UNDEFINED */
-                break;
-            }
-            if (JS_DefinePropertyValueUint32(ctx, sp[-3], pos++, value, JS_PROP_C_W_E) < 0)
-                goto exception;
+        if (done) {
+            /* value is JS_UNDEFINED */
+            break;
         }
+        if (JS_DefinePropertyValueUint32(ctx, sp[-3], pos++, value, JS_PROP_C_W_E) < 0)
+            goto exception;
     }
     /* Note: could raise an error if too many elements */
     sp[-2] = JS_NewInt32(ctx, pos);
@@ -16189,6 +17361,196 @@ static JSValue js_call_bound_function(JSContext *ctx, JSValueConst func_obj,
     }
 }
 
+/* return the property cached for the object 'p' or NULL */
+static force_inline JSProperty *js_ic_lookup(JSPropertyIC *ic, JSObject *p)
+{
+    JSPropertyICWay *w;
+    JSShape *sh;
+    JSObject *p1;
+    int i;
+
+    sh = p->shape;
+    for(i = 0; i < ic->way_count; i++) {
+        w = &ic->ways[i];
+        if (w->shape == sh) {
+            if (!w->proto_shape)
+                return &p->prop[w->prop_idx];
+            /* the shape of 'p' is not specific to its class: check
+               that no exotic behavior precedes the prototype lookup */
+            p1 = sh->proto;
+            if (p1->shape == w->proto_shape &&
+                (!p->is_exotic || p->class_id == JS_CLASS_ARRAY))
+                return &p1->prop[w->prop_idx];
+            return NULL;
+        }
+    }
+    return NULL;
+}
+
+static void js_ic_add_way(JSPropertyIC *ic, JSRuntime *rt, JSShape *sh,
+                          JSShape *proto_sh, uint32_t prop_idx)
+{
+    JSPropertyICWay *w;
+    int i;
+
+    for(i = 0; i < ic->way_count; i++) {
+        if (ic->ways[i].shape == sh)
+            break;
+    }
+    if (i == JS_PROP_IC_WAYS)
+        i = ic->miss_count % JS_PROP_IC_WAYS;
+    w = &ic->ways[i];
+    if (i < ic->way_count) {
+        js_free_shape(rt, w->shape);
+        if (w->proto_shape)
+            js_free_shape(rt, w->proto_shape);
+    } else {
+        ic->way_count++;
+    }
+    w->shape = js_dup_shape(sh);
+    w->proto_shape = proto_sh ? js_dup_shape(proto_sh) : NULL;
+    w->prop_idx = prop_idx;
+}
+
+/* update the cache of get_field or get_field2 before the slow path */
+static void js_ic_update_get(JSContext *ctx, JSPropertyIC *ic,
+                             JSValueConst obj)
+{
+    JSObject *p, *p1;
+    JSShapeProperty *prs;
+    JSProperty *pr;
+
+    if (JS_VALUE_GET_TAG(obj) != JS_TAG_OBJECT ||
+        ic->miss_count >= JS_PROP_IC_MAX_MISSES)
+        return;
+    ic->miss_count++;
+    p = JS_VALUE_GET_OBJ(obj);
+    if (!p->shape->is_hashed)
+        return;
+    prs = find_own_property(&pr, p, ic->atom);
+    if (prs) {
+        if (!(prs->flags & JS_PROP_TMASK))
+            js_ic_add_way(ic, ctx->rt, p->shape, NULL, pr - p->prop);
+        return;
+    }
+    if ((p->is_exotic && p->class_id != JS_CLASS_ARRAY) ||
+        __JS_AtomIsTaggedInt(ic->atom))
+        return;
+    p1 = p->shape->proto;
+    if (!p1 || !p1->shape->is_hashed)
+        return;
+    prs = find_own_property(&pr, p1, ic->atom);
+    if (prs && !(prs->flags & JS_PROP_TMASK))
+        js_ic_add_way(ic, ctx->rt, p->shape, p1->shape, pr - p1->prop);
+}
+
+/* update the cache of put_field before the slow path. Only the writable
+   own properties are cached. */
+static void js_ic_update_put(JSContext *ctx, JSPropertyIC *ic,
+                             JSValueConst obj)
+{
+    JSObject *p;
+    JSShapeProperty *prs;
+    JSProperty *pr;
+
+    if (JS_VALUE_GET_TAG(obj) != JS_TAG_OBJECT ||
+        ic->miss_count >= JS_PROP_IC_MAX_MISSES)
+        return;
+    ic->miss_count++;
+    p = JS_VALUE_GET_OBJ(obj);
+    if (!p->shape->is_hashed)
+        return;
+    prs = find_own_property(&pr, p, ic->atom);
+    if (prs && (prs->flags & (JS_PROP_TMASK | JS_PROP_WRITABLE |
+                              JS_PROP_LENGTH)) == JS_PROP_WRITABLE)
+        js_ic_add_way(ic, ctx->rt, p->shape, NULL, pr - p->prop);
+}
+
+/* return the global variable property cached in 'ic' or NULL */
+static force_inline JSProperty *js_global_ic_lookup(JSContext *ctx,
+                                                    JSGlobalVarIC *ic)
+{
+    JSObject *p;
+
+    if (unlikely(ic->version != ctx->rt->global_var_version))
+        return NULL;
+    if (ic->is_var_obj)
+        p = JS_VALUE_GET_OBJ(ctx->global_var_obj);
+    else
+        p = JS_VALUE_GET_OBJ(ctx->global_obj);
+    return &p->prop[ic->prop_idx];
+}
+
+/* update the global variable cache before the slow path. As in
+   JS_GetGlobalVar(), global_var_obj is looked up first. Only the data
+   properties are cached, and only the writable ones for the writes. */
+static void js_global_ic_update(JSContext *ctx, JSGlobalVarIC *ic)
+{
+    JSObject *p;
+    JSShapeProperty *prs;
+    JSProperty *pr;
+    int mask, flags;
+
+    ic->version = 0;
+    ic->is_var_obj = TRUE;
+    p = JS_VALUE_GET_OBJ(ctx->global_var_obj);
+    prs = find_own_property(&pr, p, ic->atom);
+    if (!prs) {
+        ic->is_var_obj = FALSE;
+        p = JS_VALUE_GET_OBJ(ctx->global_obj);
+        prs = find_own_property(&pr, p, ic->atom);
+        if (!prs)
+            return;
+    }
+    if (ic->opcode == OP_get_var || ic->opcode == OP_get_var_undef) {
+        mask = JS_PROP_TMASK;
+        flags = 0;
+    } else {
+        mask = JS_PROP_TMASK | JS_PROP_WRITABLE | JS_PROP_LENGTH;
+        flags = JS_PROP_WRITABLE;
+    }
+    if ((prs->flags & mask) != flags)
+        return;
+    ic->version = ctx->rt->global_var_version;
+    ic->prop_idx = pr - p->prop;
+}
+
+/* Return the variable overwritten by the put_loc, put_arg or put_var_ref
+   opcode at 'pc', or NULL if it is another opcode. */
+static JSValue *js_get_put_var_target(const uint8_t *pc, JSValue *var_buf,
+                                      JSValue *arg_buf, JSVarRef **var_refs)
+{
+    switch(pc[0]) {
+    case OP_put_loc:
+    case OP_put_loc_check:
+        return &var_buf[get_u16(pc + 1)];
+    case OP_put_loc8:
+        return &var_buf[pc[1]];
+    case OP_put_loc0:
+    case OP_put_loc1:
+    case OP_put_loc2:
+    case OP_put_loc3:
+        return &var_buf[pc[0] - OP_put_loc0];
+    case OP_put_arg:
+        return &arg_buf[get_u16(pc + 1)];
+    case OP_put_arg0:
+    case OP_put_arg1:
+    case OP_put_arg2:
+    case OP_put_arg3:
+        return &arg_buf[pc[0] - OP_put_arg0];
+    case OP_put_var_ref:
+    case OP_put_var_ref_check:
+        return var_refs[get_u16(pc + 1)]->pvalue;
+    case OP_put_var_ref0:
+    case OP_put_var_ref1:
+    case OP_put_var_ref2:
+    case OP_put_var_ref3:
+        return var_refs[pc[0] - OP_put_var_ref0]->pvalue;
+    default:
+        return NULL;
+    }
+}
+
 /* argument of OP_special_object */
 typedef enum {
     OP_SPECIAL_OBJECT_ARGUMENTS,
@@ -16204,6 +17566,29 @@ typedef enum {
 #define FUNC_RET_YIELD      1
 #define FUNC_RET_YIELD_STAR 2
 
+/* return TRUE if the frame of the current function can be reused to
+   call 'func_obj' in tail position. It is done only in strict mode
+   when the exceptions are not caught in the current function. */
+static BOOL js_can_reuse_frame(JSFunctionBytecode *b, JSValueConst func_obj,
+                               const JSValue *stack_buf, const JSValue *sp)
+{
+    const JSValue *pval;
+    JSObject *p;
+
+    if (!(b->js_mode & JS_MODE_STRICT) || b->func_kind != JS_FUNC_NORMAL)
+        return FALSE;
+    if (JS_VALUE_GET_TAG(func_obj) != JS_TAG_OBJECT)
+        return FALSE;
+    p = JS_VALUE_GET_OBJ(func_obj);
+    if (p->class_id != JS_CLASS_BYTECODE_FUNCTION)
+        return FALSE;
+    for(pval = stack_buf; pval < sp; pval++) {
+        if (JS_VALUE_GET_TAG(*pval) == JS_TAG_CATCH_OFFSET)
+            return FALSE;
+    }
+    return TRUE;
+}
+
 /* argv[] is modified if (flags & JS_CALL_FLAG_COPY_ARGV) = 0. */
 static JSValue JS_CallInternal(JSContext *caller_ctx, JSValueConst func_obj,
                                JSValueConst this_obj, JSValueConst new_target,
@@ -16218,7 +17603,12 @@ static JSValue JS_CallInternal(JSContext *caller_ctx, JSValueConst func_obj,
     int opcode, arg_allocated_size, i;
     JSValue *local_buf, *stack_buf, *var_buf, *arg_buf, *sp, ret_val, *pval;
     JSVarRef **var_refs;
-    size_t alloca_size;
+    size_t alloca_size = 0;
+    /* frame of the function called in tail position: the initial frame
+       if it is large enough, otherwise a heap buffer */
+    JSValue *frame_buf = NULL, *tc_buf = NULL;
+    JSValue tc_func = JS_UNDEFINED, tc_this = JS_UNDEFINED;
+    size_t tc_buf_size = 0;
 
 #if !DIRECT_DISPATCH
 #define SWITCH(pc)      switch (opcode = *pc++)
@@ -16301,7 +17691,7 @@ static JSValue JS_CallInternal(JSContext *caller_ctx, JSValueConst func_obj,
     init_list_head(&sf->var_ref_list);
     var_refs = p->u.func.var_refs;
 
-    local_buf = alloca(alloca_size);
+    local_buf = frame_buf = alloca(alloca_size);
     if (unlikely(arg_allocated_size)) {
         int n = min_int(argc, b->arg_count);
         arg_buf = local_buf;
@@ -16649,6 +18039,9 @@ static JSValue JS_CallInternal(JSContext *caller_ctx, JSValueConst func_obj,
             has_call_argc:
                 call_argv = sp - call_argc;
                 sf->cur_pc = pc;
+                if (opcode == OP_tail_call &&
+                    js_can_reuse_frame(b, call_argv[-1], stack_buf, call_argv - 1))
+                    goto tail_call;
                 ret_val = JS_CallInternal(ctx, call_argv[-1], JS_UNDEFINED,
                                           JS_UNDEFINED, call_argc, call_argv, 0);
                 if (unlikely(JS_IsException(ret_val)))
@@ -16685,6 +18078,9 @@ static JSValue JS_CallInternal(JSContext *caller_ctx, JSValueConst func_obj,
                 pc += 2;
                 call_argv = sp - call_argc;
                 sf->cur_pc = pc;
+                if (opcode == OP_tail_call_method &&
+                    js_can_reuse_frame(b, call_argv[-1], stack_buf, call_argv - 2))
+                    goto tail_call;
                 ret_val = JS_CallInternal(ctx, call_argv[-1], call_argv[-2],
                                           JS_UNDEFINED, call_argc, call_argv, 0);
                 if (unlikely(JS_IsException(ret_val)))
@@ -16697,6 +18093,101 @@ static JSValue JS_CallInternal(JSContext *caller_ctx, JSValueConst func_obj,
                 *sp++ = ret_val;
             }
             BREAK;
+        tail_call:
+            /* the frame of the current function is replaced by the
+               frame of the callee, allocated on the heap */
+            {
+                JSObject *p1 = JS_VALUE_GET_OBJ(call_argv[-1]);
+                JSFunctionBytecode *b1 = p1->u.func.function_bytecode;
+                JSValue *new_buf, *func_slot;
+                int n_args;
+                size_t n;
+
+                if (js_poll_interrupts(ctx))
+                    goto exception;
+                n_args = max_int(call_argc, b1->arg_count);
+                n = n_args + b1->var_count + b1->stack_size;
+                if (n <= alloca_size / sizeof(JSValue)) {
+                    new_buf = frame_buf;
+                } else if (n <= tc_buf_size) {
+                    new_buf = tc_buf;
+                } else {
+                    new_buf = js_malloc(ctx, sizeof(JSValue) * n);
+                    if (!new_buf)
+                        goto exception;
+                }
+                if (unlikely(!list_empty(&sf->var_ref_list))) {
+                    close_var_refs(rt, sf);
+                    init_list_head(&sf->var_ref_list);
+                }
+                /* free the current frame except the callee, 'this' and
+                   the arguments */
+                func_slot = call_argv - 1 - (opcode == OP_tail_call_method);
+                for(pval = local_buf; pval < func_slot; pval++)
+                    JS_FreeValueRT(rt, *pval);
+                JS_FreeValueRT(rt, tc_func);
+                JS_FreeValueRT(rt, tc_this);
+                tc_func = call_argv[-1];
+                if (opcode == OP_tail_call_method)
+                    tc_this = call_argv[-2];
+                else
+                    tc_this = JS_UNDEFINED;
+                memmove(new_buf, call_argv, sizeof(JSValue) * call_argc);
+                if (new_buf != frame_buf && new_buf != tc_buf) {
+                    js_free_rt(rt, tc_buf);
+                    tc_buf = new_buf;
+                    tc_buf_size = n;
+                }
+
+                func_obj = tc_func;
+                this_obj = tc_this;
+                new_target = JS_UNDEFINED;
+                argc = call_argc;
+                argv = new_buf;
+                p = p1;
+                b = b1;
+                var_refs = p->u.func.var_refs;
+                ctx = b->realm;
+                local_buf = arg_buf = new_buf;
+                for(i = call_argc; i < n_args; i++)
+                    arg_buf[i] = JS_UNDEFINED;
+                var_buf = arg_buf + n_args;
+                for(i = 0; i < b->var_count; i++)
+                    var_buf[i] = JS_UNDEFINED;
+                stack_buf = var_buf + b->var_count;
+                sp = stack_buf;
+                pc = b->byte_code_buf;
+                sf->js_mode = b->js_mode;
+                sf->arg_count = n_args;
+                sf->cur_func = (JSValue)func_obj;
+                sf->arg_buf = arg_buf;
+                sf->var_buf = var_buf;
+            }
+            BREAK;
+        CASE(OP_object_from):
+            {
+                JSObject *p1;
+                int i;
+
+                /* the object gets the shape of the template object,
+                   which holds the properties in the order of the
+                   values */
+                call_argc = get_u16(pc);
+                pc += 2;
+                p1 = JS_VALUE_GET_OBJ(sp[-1]);
+                ret_val = JS_NewObjectFromShape(ctx, js_dup_shape(p1->shape),
+                                                JS_CLASS_OBJECT);
+                if (unlikely(JS_IsException(ret_val)))
+                    goto exception;
+                JS_FreeValue(ctx, *--sp);
+                call_argv = sp - call_argc;
+                p1 = JS_VALUE_GET_OBJ(ret_val);
+                for(i = 0; i < call_argc; i++)
+                    p1->prop[i].u.value = call_argv[i];
+                sp -= call_argc;
+                *sp++ = ret_val;
+            }
+            BREAK;
         CASE(OP_array_from):
             {
                 int i, ret;
@@ -16965,6 +18456,77 @@ static JSValue JS_CallInternal(JSContext *caller_ctx, JSValueConst func_obj,
             }
             BREAK;
 
+        CASE(OP_get_var_ic):
+            {
+                JSValue val;
+                JSGlobalVarIC *ic;
+                JSProperty *pr;
+                ic = &b->global_ic[get_u32(pc)];
+                pc += 4;
+
+                pr = js_global_ic_lookup(ctx, ic);
+                if (likely(pr != NULL && !JS_IsUninitialized(pr->u.value))) {
+                    val = JS_DupValue(ctx, pr->u.value);
+                } else {
+                    js_global_ic_update(ctx, ic);
+                    val = JS_GetGlobalVar(ctx, ic->atom,
+                                          ic->opcode - OP_get_var_undef);
+                    if (unlikely(JS_IsException(val)))
+                        goto exception;
+                }
+                *sp++ = val;
+            }
+            BREAK;
+
+        CASE(OP_put_var_ic):
+            {
+                int ret;
+                JSGlobalVarIC *ic;
+                JSProperty *pr;
+                ic = &b->global_ic[get_u32(pc)];
+                pc += 4;
+
+                pr = js_global_ic_lookup(ctx, ic);
+                if (likely(pr != NULL && !JS_IsUninitialized(pr->u.value))) {
+                    set_value(ctx, &pr->u.value, sp[-1]);
+                    sp--;
+                } else {
+                    js_global_ic_update(ctx, ic);
+                    ret = JS_SetGlobalVar(ctx, ic->atom, sp[-1], 0);
+                    sp--;
+                    if (unlikely(ret < 0))
+                        goto exception;
+                }
+            }
+            BREAK;
+
+        CASE(OP_put_var_strict_ic):
+            {
+                int ret;
+                JSGlobalVarIC *ic;
+                JSProperty *pr;
+                ic = &b->global_ic[get_u32(pc)];
+                pc += 4;
+
+                /* sp[-2] is JS_TRUE or JS_FALSE */
+                if (unlikely(!JS_VALUE_GET_INT(sp[-2]))) {
+                    JS_ThrowReferenceErrorNotDefined(ctx, ic->atom);
+                    goto exception;
+                }
+                pr = js_global_ic_lookup(ctx, ic);
+                if (likely(pr != NULL && !JS_IsUninitialized(pr->u.value))) {
+                    set_value(ctx, &pr->u.value, sp[-1]);
+                    sp -= 2;
+                } else {
+                    js_global_ic_update(ctx, ic);
+                    ret = JS_SetGlobalVar(ctx, ic->atom, sp[-1], 2);
+                    sp -= 2;
+                    if (unlikely(ret < 0))
+                        goto exception;
+                }
+            }
+            BREAK;
+
         CASE(OP_check_define_var):
             {
                 JSAtom atom;
@@ -17585,6 +19147,74 @@ static JSValue JS_CallInternal(JSContext *caller_ctx, JSValueConst func_obj,
             }
             BREAK;
 
+        CASE(OP_get_field_ic):
+            {
+                JSValue val;
+                JSPropertyIC *ic;
+                JSProperty *pr;
+                ic = &b->ic[get_u32(pc)];
+                pc += 4;
+
+                if (likely(JS_VALUE_GET_TAG(sp[-1]) == JS_TAG_OBJECT) &&
+                    (pr = js_ic_lookup(ic, JS_VALUE_GET_OBJ(sp[-1]))) != NULL) {
+                    val = JS_DupValue(ctx, pr->u.value);
+                } else {
+                    js_ic_update_get(ctx, ic, sp[-1]);
+                    val = JS_GetProperty(ctx, sp[-1], ic->atom);
+                    if (unlikely(JS_IsException(val)))
+                        goto exception;
+                }
+                JS_FreeValue(ctx, sp[-1]);
+                sp[-1] = val;
+            }
+            BREAK;
+
+        CASE(OP_get_field2_ic):
+            {
+                JSValue val;
+                JSPropertyIC *ic;
+                JSProperty *pr;
+                ic = &b->ic[get_u32(pc)];
+                pc += 4;
+
+                if (likely(JS_VALUE_GET_TAG(sp[-1]) == JS_TAG_OBJECT) &&
+                    (pr = js_ic_lookup(ic, JS_VALUE_GET_OBJ(sp[-1]))) != NULL) {
+                    val = JS_DupValue(ctx, pr->u.value);
+                } else {
+                    js_ic_update_get(ctx, ic, sp[-1]);
+                    val = JS_GetProperty(ctx, sp[-1], ic->atom);
+                    if (unlikely(JS_IsException(val)))
+                        goto exception;
+                }
+                *sp++ = val;
+            }
+            BREAK;
+
+        CASE(OP_put_field_ic):
+            {
+                int ret;
+                JSPropertyIC *ic;
+                JSProperty *pr;
+                ic = &b->ic[get_u32(pc)];
+                pc += 4;
+
+                if (likely(JS_VALUE_GET_TAG(sp[-2]) == JS_TAG_OBJECT) &&
+                    (pr = js_ic_lookup(ic, JS_VALUE_GET_OBJ(sp[-2]))) != NULL) {
+                    set_value(ctx, &pr->u.value, sp[-1]);
+                    JS_FreeValue(ctx, sp[-2]);
+                    sp -= 2;
+                } else {
+                    js_ic_update_put(ctx, ic, sp[-2]);
+                    ret = JS_SetPropertyInternal(ctx, sp[-2], ic->atom, sp[-1],
+                                                 JS_PROP_THROW_STRICT);
+                    JS_FreeValue(ctx, sp[-2]);
+                    sp -= 2;
+                    if (unlikely(ret < 0))
+                        goto exception;
+                }
+            }
+            BREAK;
+
         CASE(OP_private_symbol):
             {
                 JSAtom atom;
@@ -17775,6 +19405,43 @@ static JSValue JS_CallInternal(JSContext *caller_ctx, JSValueConst func_obj,
             }
             BREAK;
 
+        CASE(OP_get_arguments_length):
+            *sp++ = JS_NewInt32(ctx, argc);
+            BREAK;
+
+        CASE(OP_get_arguments_el):
+            {
+                JSValue val, args;
+                uint32_t idx;
+
+                if (likely(JS_VALUE_GET_TAG(sp[-1]) == JS_TAG_INT &&
+                           (idx = JS_VALUE_GET_INT(sp[-1])) < argc)) {
+                    /* the mapped arguments are the current values of
+                       the parameters */
+                    if (idx < b->arg_count)
+                        sp[-1] = JS_DupValue(ctx, arg_buf[idx]);
+                    else
+                        sp[-1] = JS_DupValue(ctx, argv[idx]);
+                } else {
+                    /* other properties: use a temporary object */
+                    if (!(b->js_mode & JS_MODE_STRICT) &&
+                        b->has_simple_parameter_list) {
+                        args = js_build_mapped_arguments(ctx, argc, (JSValueConst *)argv,
+                                                         sf, min_int(argc, b->arg_count));
+                    } else {
+                        args = js_build_arguments(ctx, argc, (JSValueConst *)argv);
+                    }
+                    if (unlikely(JS_IsException(args)))
+                        goto exception;
+                    val = JS_GetPropertyValue(ctx, args, sp[-1]);
+                    JS_FreeValue(ctx, args);
+                    sp[-1] = val;
+                    if (unlikely(JS_IsException(val)))
+                        goto exception;
+                }
+            }
+            BREAK;
+
         CASE(OP_get_array_el2):
             {
                 JSValue val;
@@ -17924,7 +19591,7 @@ static JSValue JS_CallInternal(JSContext *caller_ctx, JSValueConst func_obj,
 
         CASE(OP_add):
             {
-                JSValue op1, op2;
+                JSValue op1, op2, *pv;
                 op1 = sp[-2];
                 op2 = sp[-1];
                 if (likely(JS_VALUE_IS_BOTH_INT(op1, op2))) {
@@ -17938,6 +19605,24 @@ static JSValue JS_CallInternal(JSContext *caller_ctx, JSValueConst func_obj,
                     sp[-2] = __JS_NewFloat64(ctx, JS_VALUE_GET_FLOAT64(op1) +
                                              JS_VALUE_GET_FLOAT64(op2));
                     sp--;
+                } else if (JS_VALUE_GET_TAG(op1) == JS_TAG_STRING &&
+                           JS_VALUE_GET_TAG(op2) == JS_TAG_STRING &&
+                           JS_VALUE_GET_STRING(op1)->header.ref_count == 2 &&
+                           (pv = js_get_put_var_target(pc, var_buf, arg_buf,
+                                                       var_refs)) != NULL &&
+                           JS_VALUE_GET_TAG(*pv) == JS_TAG_STRING &&
+                           JS_VALUE_GET_PTR(*pv) == JS_VALUE_GET_PTR(op1)) {
+                    /* 'x = x + y': the reference of x is dropped since x
+                       is overwritten by the next opcode, so that the
+                       string can be extended in place */
+                    *pv = JS_UNDEFINED;
+                    JS_VALUE_GET_STRING(op1)->header.ref_count--;
+                    if (js_concat_string_to(ctx, &sp[-2], op2)) {
+                        *pv = JS_DupValue(ctx, sp[-2]);
+                        sp--;
+                        goto exception;
+                    }
+                    sp--;
                 } else {
                 add_slow:
                     if (js_add_slow(ctx, sp))
@@ -17969,10 +19654,8 @@ static JSValue JS_CallInternal(JSContext *caller_ctx, JSValueConst func_obj,
                     op1 = JS_ToPrimitiveFree(ctx, op1, HINT_NONE);
                     if (JS_IsException(op1))
                         goto exception;
-                    op1 = JS_ConcatString(ctx, JS_DupValue(ctx, *pv), op1);
-                    if (JS_IsException(op1))
+                    if (js_concat_string_to(ctx, pv, op1))
                         goto exception;
-                    set_value(ctx, pv, op1);
                 } else {
                     JSValue ops[2];
                 add_loc_slow:
@@ -18714,6 +20397,10 @@ static JSValue JS_CallInternal(JSContext *caller_ctx, JSValueConst func_obj,
         for(pval = local_buf; pval < sp; pval++) {
             JS_FreeValue(ctx, *pval);
         }
+        JS_FreeValueRT(rt, tc_func);
+        JS_FreeValueRT(rt, tc_this);
+        if (tc_buf)
+            js_free_rt(rt, tc_buf);
     }
     rt->current_stack_frame = sf->prev_frame;
     return ret_val;
@@ -19163,10 +20850,19 @@ static JSValue js_generator_function_call(JSContext *ctx, JSValueConst func_obj,
 
 static void js_async_function_terminate(JSRuntime *rt, JSAsyncFunctionData *s)
 {
+    JSValue func;
+    int i;
+
     if (s->is_active) {
         async_func_free(rt, &s->func_state);
         s->is_active = FALSE;
     }
+    /* the resume functions reference 's' */
+    for(i = 0; i < 2; i++) {
+        func = s->resume_funcs[i];
+        s->resume_funcs[i] = JS_UNDEFINED;
+        JS_FreeValueRT(rt, func);
+    }
 }
 
 static void js_async_function_free0(JSRuntime *rt, JSAsyncFunctionData *s)
@@ -19227,6 +20923,42 @@ static int js_async_function_resolve_create(JSContext *ctx,
     return 0;
 }
 
+/* Resume the async function 's' when 'value' is resolved. The resume
+   functions are shared by all the 'await' of the function. As an
+   optimization, no promise is created if 'value' is not an object. */
+static int js_async_function_await(JSContext *ctx, JSAsyncFunctionData *s,
+                                   JSValueConst value)
+{
+    JSValue promise;
+    JSValueConst args[5], resolving_funcs1[2];
+    int res;
+
+    if (JS_IsUndefined(s->resume_funcs[0])) {
+        if (js_async_function_resolve_create(ctx, s, s->resume_funcs))
+            return -1;
+    }
+    /* Note: no need to create 'thrownawayCapability' as in the spec */
+    resolving_funcs1[0] = JS_UNDEFINED;
+    resolving_funcs1[1] = JS_UNDEFINED;
+    if (!JS_IsObject(value)) {
+        /* same job as a reaction of an already fulfilled promise */
+        args[0] = resolving_funcs1[0];
+        args[1] = resolving_funcs1[1];
+        args[2] = s->resume_funcs[0];
+        args[3] = JS_FALSE;
+        args[4] = value;
+        return JS_EnqueueJob(ctx, promise_reaction_job, 5, args);
+    }
+    promise = js_promise_resolve(ctx, ctx->promise_ctor, 1, &value, 0);
+    if (JS_IsException(promise))
+        return -1;
+    res = perform_promise_then(ctx, promise,
+                               (JSValueConst *)s->resume_funcs,
+                               resolving_funcs1);
+    JS_FreeValue(ctx, promise);
+    return res;
+}
+
 static void js_async_function_resume(JSContext *ctx, JSAsyncFunctionData *s)
 {
     JSValue func_ret, ret2;
@@ -19253,31 +20985,12 @@ static void js_async_function_resume(JSContext *ctx, JSAsyncFunctionData *s)
             JS_FreeValue(ctx, value);
             js_async_function_terminate(ctx->rt, s);
         } else {
-            JSValue promise, resolving_funcs[2], resolving_funcs1[2];
-            int i, res;
+            int res;
 
             /* await */
             JS_FreeValue(ctx, func_ret); /* not used */
-            promise = js_promise_resolve(ctx, ctx->promise_ctor,
-                                         1, (JSValueConst *)&value, 0);
+            res = js_async_function_await(ctx, s, value);
             JS_FreeValue(ctx, value);
-            if (JS_IsException(promise))
-                goto fail;
-            if (js_async_function_resolve_create(ctx, s, resolving_funcs)) {
-                JS_FreeValue(ctx, promise);
-                goto fail;
-            }
-
-            /* Note: no need to create 'thrownawayCapability' as in
-               the spec */
-            for(i = 0; i < 2; i++)
-                resolving_funcs1[i] = JS_UNDEFINED;
-            res = perform_promise_then(ctx, promise,
-                                       (JSValueConst *)resolving_funcs,
-                                       (JSValueConst *)resolving_funcs1);
-            JS_FreeValue(ctx, promise);
-            for(i = 0; i < 2; i++)
-                JS_FreeValue(ctx, resolving_funcs[i]);
             if (res)
                 goto fail;
         }
@@ -19325,6 +21038,8 @@ static JSValue js_async_function_call(JSContext *ctx, JSValueConst func_obj,
     s->is_active = FALSE;
     s->resolving_funcs[0] = JS_UNDEFINED;
     s->resolving_funcs[1] = JS_UNDEFINED;
+    s->resume_funcs[0] = JS_UNDEFINED;
+    s->resume_funcs[1] = JS_UNDEFINED;
 
     promise = JS_NewPromiseCapability(ctx, s->resolving_funcs);
     if (JS_IsException(promise))
@@ -21247,6 +22962,20 @@ static __exception int json_next_token(JSParseState *s)
         }
         /* fall through */
     case '\"':
+        {
+            /* fast path for the strings without escape sequences */
+            size_t len = str8_plain_len(p + 1, s->buf_end - p - 1, c);
+            if (p[1 + len] == c) {
+                JSValue str = js_new_string8(s->ctx, p + 1, len);
+                if (JS_IsException(str))
+                    goto fail;
+                s->token.val = TOK_STRING;
+                s->token.u.str.sep = c;
+                s->token.u.str.str = str;
+                p += len + 2;
+                break;
+            }
+        }
         if (js_parse_string(s, c, TRUE, p + 1, &s->token, &p))
             goto fail;
         break;
@@ -21373,6 +23102,24 @@ static __exception int json_next_token(JSParseState *s)
         {
             JSValue ret;
             int flags, radix;
+            const uint8_t *q, *q0;
+            uint32_t v;
+
+            /* fast path for the integers of at most 9 digits */
+            q = q0 = p + (*p == '-');
+            v = 0;
+            while (is_digit(*q) && q - q0 < 9)
+                v = v * 10 + (*q++ - '0');
+            c = *q;
+            if (*p != '+' && !is_digit(c) && c != '.' &&
+                !lre_js_is_ident_next(c) &&
+                !(*p == '-' && v == 0)) {
+                s->token.val = TOK_NUMBER;
+                s->token.u.num.val = JS_NewInt32(s->ctx,
+                                                 *p == '-' ? -(int32_t)v : v);
+                p = q;
+                break;
+            }
             if (!s->ext_json) {
                 flags = 0;
                 radix = 10;
@@ -22650,18 +24397,80 @@ static void set_object_name_computed(JSParseState *s)
     }
 }
 
+/* maximum number of fields of an object literal created from a
+   template */
+#define OBJECT_TEMPLATE_MAX_FIELDS 32
+
+/* Remove the OP_object and OP_define_field instructions of an object
+   literal whose properties are all static fields. The field values are
+   left on the stack and OP_object_from creates the object with the
+   shape of a template object stored in the constant pool, so that its
+   property array is allocated once with its final size. Nothing is done
+   if a field name is duplicated. */
+static __exception int js_emit_object_template(JSParseState *s, int object_pos,
+                                               const int *field_pos,
+                                               int field_count)
+{
+    JSContext *ctx = s->ctx;
+    JSFunctionDef *fd = s->cur_func;
+    JSValue obj;
+    JSObject *p;
+    JSProperty *pr;
+    JSAtom atom;
+    int i, idx;
+
+    obj = JS_NewObject(ctx);
+    if (JS_IsException(obj))
+        return -1;
+    p = JS_VALUE_GET_OBJ(obj);
+    for(i = 0; i < field_count; i++) {
+        atom = get_u32(fd->byte_code.buf + field_pos[i] + 1);
+        if (find_own_property(&pr, p, atom)) {
+            JS_FreeValue(ctx, obj);
+            return 0;
+        }
+        if (JS_DefinePropertyValue(ctx, obj, atom, JS_UNDEFINED,
+                                   JS_PROP_C_W_E) < 0) {
+            JS_FreeValue(ctx, obj);
+            return -1;
+        }
+    }
+    idx = cpool_add(s, obj);
+    if (idx < 0) {
+        JS_FreeValue(ctx, obj);
+        return -1;
+    }
+    fd->byte_code.buf[object_pos] = OP_nop;
+    for(i = 0; i < field_count; i++) {
+        atom = get_u32(fd->byte_code.buf + field_pos[i] + 1);
+        JS_FreeAtom(ctx, atom);
+        memset(fd->byte_code.buf + field_pos[i], OP_nop, 5);
+    }
+    emit_op(s, OP_push_const);
+    emit_u32(s, idx);
+    emit_op(s, OP_object_from);
+    emit_u16(s, field_count);
+    return 0;
+}
+
 static __exception int js_parse_object_literal(JSParseState *s)
 {
     JSAtom name = JS_ATOM_NULL;
     const uint8_t *start_ptr;
     int start_line, prop_type;
-    BOOL has_proto;
+    BOOL has_proto, is_template, is_field;
+    int object_pos, field_count;
+    int field_pos[OBJECT_TEMPLATE_MAX_FIELDS];
 
     if (next_token(s))
         goto fail;
-    /* XXX: add an initial length that will be patched back */
     emit_op(s, OP_object);
+    object_pos = s->cur_func->last_opcode_pos;
     has_proto = FALSE;
+    /* the literal is created from a template if it only has static
+       fields */
+    is_template = TRUE;
+    field_count = 0;
     while (s->token.val != '}') {
         /* specific case for getter/setter */
         start_ptr = s->token.ptr;
@@ -22677,6 +24486,7 @@ static __exception int js_parse_object_literal(JSParseState *s)
             emit_u8(s, 2 | (1 << 2) | (0 << 5));
             emit_op(s, OP_drop); /* pop excludeList */
             emit_op(s, OP_drop); /* pop src object */
+            is_template = FALSE;
             goto next;
         }
 
@@ -22684,6 +24494,7 @@ static __exception int js_parse_object_literal(JSParseState *s)
         if (prop_type < 0)
             goto fail;
 
+        is_field = FALSE;
         if (prop_type == PROP_TYPE_VAR) {
             /* shortcut for x: x */
             emit_op(s, OP_scope_get_var);
@@ -22691,6 +24502,7 @@ static __exception int js_parse_object_literal(JSParseState *s)
             emit_u16(s, s->cur_func->scope_level);
             emit_op(s, OP_define_field);
             emit_atom(s, name);
+            is_field = TRUE;
         } else if (s->token.val == '(') {
             BOOL is_getset = (prop_type == PROP_TYPE_GET ||
                               prop_type == PROP_TYPE_SET);
@@ -22726,6 +24538,7 @@ static __exception int js_parse_object_literal(JSParseState *s)
                 op_flags = OP_DEFINE_METHOD_METHOD;
             }
             emit_u8(s, op_flags | OP_DEFINE_METHOD_ENUMERABLE);
+            is_template = FALSE;
         } else {
             if (js_parse_expect(s, ':'))
                 goto fail;
@@ -22735,6 +24548,7 @@ static __exception int js_parse_object_literal(JSParseState *s)
                 set_object_name_computed(s);
                 emit_op(s, OP_define_array_el);
                 emit_op(s, OP_drop);
+                is_template = FALSE;
             } else if (name == JS_ATOM___proto__) {
                 if (has_proto) {
                     js_parse_error(s, "duplicate __proto__ property name");
@@ -22742,12 +24556,21 @@ static __exception int js_parse_object_literal(JSParseState *s)
                 }
                 emit_op(s, OP_set_proto);
                 has_proto = TRUE;
+                is_template = FALSE;
             } else {
                 set_object_name(s, name);
                 emit_op(s, OP_define_field);
                 emit_atom(s, name);
+                is_field = TRUE;
             }
         }
+        if (is_field) {
+            if (field_count < OBJECT_TEMPLATE_MAX_FIELDS)
+                field_pos[field_count] = s->cur_func->last_opcode_pos;
+            else
+                is_template = FALSE;
+            field_count++;
+        }
         JS_FreeAtom(s->ctx, name);
     next:
         name = JS_ATOM_NULL;
@@ -22758,6 +24581,10 @@ static __exception int js_parse_object_literal(JSParseState *s)
     }
     if (js_parse_expect(s, '}'))
         goto fail;
+    if (is_template && field_count > 0) {
+        if (js_emit_object_template(s, object_pos, field_pos, field_count))
+            goto fail;
+    }
     return 0;
  fail:
     JS_FreeAtom(s->ctx, name);
@@ -31280,6 +33107,33 @@ static int find_jump_target(JSFunctionDef *s, int label, int *pop, int *pline)
     return label;
 }
 
+/* return TRUE if the code at 'pos' returns the stack top value,
+   following the labels and the jumps */
+static BOOL code_is_return(JSFunctionDef *s, int pos)
+{
+    const uint8_t *bc_buf = s->byte_code.buf;
+    int bc_len = s->byte_code.size;
+    int i, op;
+
+    /* limit the number of followed jumps in case of cycle */
+    for (i = 0; i < 10; i++) {
+        for (;;) {
+            if (pos >= bc_len)
+                return FALSE;
+            op = bc_buf[pos];
+            if (op != OP_line_num && op != OP_label)
+                break;
+            pos += opcode_info[op].size;
+        }
+        if (op == OP_return)
+            return TRUE;
+        if (op != OP_goto)
+            break;
+        pos = s->label_slots[get_u32(bc_buf + pos + 1)].pos2;
+    }
+    return FALSE;
+}
+
 static void push_short_int(DynBuf *bc_out, int val)
 {
 #if SHORT_OPCODES
@@ -31360,6 +33214,278 @@ static void put_short_code(DynBuf *bc_out, int op, int idx)
     dbuf_put_u16(bc_out, idx);
 }
 
+/* Transform the TDZ checks of the local variables which are known to
+   be initialized into plain accesses. A variable is known to be
+   initialized after a store or a checked access in the same basic
+   block. The code is modified in place. */
+static __exception int remove_redundant_checks(JSContext *ctx,
+                                               JSFunctionDef *s)
+{
+    uint8_t *bc_buf = s->byte_code.buf;
+    int bc_len = s->byte_code.size;
+    uint32_t *init_gen, gen;
+    int pos, op, idx;
+
+    if (s->var_count == 0)
+        return 0;
+    /* the variable 'idx' is initialized if init_gen[idx] == gen */
+    init_gen = js_mallocz(ctx, sizeof(init_gen[0]) * s->var_count);
+    if (!init_gen)
+        return -1;
+    gen = 1;
+    for(pos = 0; pos < bc_len; pos += opcode_info[op].size) {
+        op = bc_buf[pos];
+        switch(op) {
+        case OP_label:
+            /* start of a basic block unless the label is not used */
+            if (s->label_slots[get_u32(bc_buf + pos + 1)].ref_count > 0)
+                gen++;
+            break;
+        case OP_gosub:
+            gen++;
+            break;
+        case OP_set_loc_uninitialized:
+            idx = get_u16(bc_buf + pos + 1);
+            init_gen[idx] = 0;
+            break;
+        case OP_get_loc_check:
+        case OP_put_loc_check:
+            idx = get_u16(bc_buf + pos + 1);
+            if (init_gen[idx] == gen)
+                bc_buf[pos] = op - OP_get_loc_check + OP_get_loc;
+            init_gen[idx] = gen;
+            break;
+        case OP_put_loc:
+        case OP_set_loc:
+        case OP_put_loc_check_init:
+            idx = get_u16(bc_buf + pos + 1);
+            init_gen[idx] = gen;
+            break;
+        default:
+            break;
+        }
+    }
+    js_free(ctx, init_gen);
+    return 0;
+}
+
+/* return the position of the instruction which pops the value pushed
+   just before 'pos', or -1 if it is not in the same straight line code */
+static int find_value_use(JSFunctionDef *s, int pos)
+{
+    const uint8_t *bc_buf = s->byte_code.buf;
+    int bc_len = s->byte_code.size;
+    const JSOpCode *oi;
+    int op, n_pop, depth;
+
+    depth = 0;
+    for(; pos < bc_len; pos += oi->size) {
+        op = bc_buf[pos];
+        oi = &opcode_info[op];
+        switch(oi->fmt) {
+        case OP_FMT_label:
+        case OP_FMT_label_u16:
+        case OP_FMT_atom_label_u8:
+        case OP_FMT_atom_label_u16:
+            return -1;
+        default:
+            break;
+        }
+        switch(op) {
+        case OP_tail_call:
+        case OP_tail_call_method:
+        case OP_return:
+        case OP_return_undef:
+        case OP_return_async:
+        case OP_throw:
+        case OP_throw_error:
+        case OP_ret:
+            return -1;
+        default:
+            break;
+        }
+        n_pop = oi->n_pop;
+        if (oi->fmt == OP_FMT_npop || oi->fmt == OP_FMT_npop_u16)
+            n_pop += get_u16(bc_buf + pos + 1);
+        if (n_pop > depth)
+            return pos;
+        depth += oi->n_push - n_pop;
+    }
+    return -1;
+}
+
+/* Check if the 'arguments' object is only used in 'arguments.length'
+   and 'arguments[expr]'. In this case it is not created and these
+   expressions read the arguments in the frame. '*pel_tab' is set to
+   NULL or to a table where the get_array_el reading an argument are
+   marked. */
+static __exception int find_arguments_uses(JSContext *ctx, JSFunctionDef *s,
+                                           uint8_t **pel_tab)
+{
+    const uint8_t *bc_buf = s->byte_code.buf;
+    int bc_len = s->byte_code.size;
+    BOOL is_mapped;
+    uint8_t *el_tab;
+    CodeContext cc;
+    int pos, op, idx, i;
+
+    *pel_tab = NULL;
+    if (s->arguments_var_idx < 0 || s->arguments_arg_idx >= 0 ||
+        s->has_eval_call || s->vars[s->arguments_var_idx].is_captured)
+        return 0;
+    /* the unmapped arguments are a copy of the initial argument values */
+    is_mapped = !(s->js_mode & JS_MODE_STRICT) && s->has_simple_parameter_list;
+    if (!is_mapped) {
+        for(i = 0; i < s->arg_count; i++) {
+            if (s->args[i].is_captured)
+                return 0;
+        }
+    }
+    cc.bc_buf = bc_buf;
+    cc.bc_len = bc_len;
+    for(pos = 0; pos < bc_len; pos += opcode_info[op].size) {
+        op = bc_buf[pos];
+        switch(opcode_info[op].fmt) {
+        case OP_FMT_loc:
+            idx = get_u16(bc_buf + pos + 1);
+            if (idx != s->arguments_var_idx)
+                break;
+            if (op != OP_get_loc)
+                return 0;
+            if (code_match(&cc, pos + 3, OP_get_field, -1) &&
+                cc.atom == JS_ATOM_length)
+                break;
+            i = find_value_use(s, pos + 3);
+            if (i < 0 || bc_buf[i] != OP_get_array_el)
+                return 0;
+            break;
+        case OP_FMT_arg:
+            if (op != OP_get_arg && !is_mapped)
+                return 0;
+            break;
+        default:
+            break;
+        }
+        if (op == OP_make_loc_ref &&
+            get_u16(bc_buf + pos + 5) == s->arguments_var_idx)
+            return 0;
+        if (op == OP_make_arg_ref && !is_mapped)
+            return 0;
+    }
+    el_tab = js_mallocz(ctx, bc_len);
+    if (!el_tab)
+        return -1;
+    for(pos = 0; pos < bc_len; pos += opcode_info[op].size) {
+        op = bc_buf[pos];
+        if (op == OP_get_loc &&
+            get_u16(bc_buf + pos + 1) == s->arguments_var_idx &&
+            !(code_match(&cc, pos + 3, OP_get_field, -1) &&
+              cc.atom == JS_ATOM_length)) {
+            el_tab[find_value_use(s, pos + 3)] = 1;
+        }
+    }
+    *pel_tab = el_tab;
+    return 0;
+}
+
+/* return TRUE if the local variable 'idx' is always stored by the
+   code at 'pos' before it can be read */
+static BOOL code_overwrites_loc(const uint8_t *bc_buf, int bc_len,
+                                int pos, int idx)
+{
+    int op;
+
+    for(; pos < bc_len; pos += opcode_info[op].size) {
+        op = bc_buf[pos];
+        switch(op) {
+        case OP_put_loc:
+            if (get_u16(bc_buf + pos + 1) == idx)
+                return TRUE;
+            break;
+        case OP_set_loc_uninitialized:
+            if (get_u16(bc_buf + pos + 1) == idx)
+                return FALSE;
+            break;
+        case OP_line_num:
+        case OP_push_i32:
+        case OP_push_const:
+        case OP_push_atom_value:
+        case OP_undefined:
+        case OP_null:
+        case OP_push_false:
+        case OP_push_true:
+        case OP_fclosure:
+            break;
+        default:
+            /* may read the variable or throw an exception */
+            return FALSE;
+        }
+    }
+    return FALSE;
+}
+
+/* fold 'a op b'. Return FALSE if the result is not an int32 */
+static BOOL fold_int32_binary_op(int op, int32_t a, int32_t b, int32_t *pres)
+{
+    int64_t r;
+
+    switch(op) {
+    case OP_add:
+        r = (int64_t)a + b;
+        break;
+    case OP_sub:
+        r = (int64_t)a - b;
+        break;
+    case OP_mul:
+        r = (int64_t)a * b;
+        if (r == 0 && (a | b) < 0)
+            return FALSE; /* -0 */
+        break;
+    case OP_and:
+        r = a & b;
+        break;
+    case OP_or:
+        r = a | b;
+        break;
+    case OP_xor:
+        r = a ^ b;
+        break;
+    case OP_shl:
+        r = (int32_t)((uint32_t)a << (b & 31));
+        break;
+    case OP_sar:
+        r = a >> (b & 31);
+        break;
+    default:
+        return FALSE;
+    }
+    if (r != (int32_t)r)
+        return FALSE;
+    *pres = r;
+    return TRUE;
+}
+
+/* return the atom of the concatenation of 'a1' and 'a2' or JS_ATOM_NULL */
+/* return JS_ATOM_NULL with no pending exception if error: the caller
+   then keeps the unoptimized code */
+static JSAtom concat_atom_strings(JSContext *ctx, JSAtom a1, JSAtom a2)
+{
+    JSValue str;
+    JSAtom atom;
+
+    str = JS_ConcatString(ctx, JS_AtomToString(ctx, a1),
+                          JS_AtomToString(ctx, a2));
+    if (JS_IsException(str))
+        goto fail;
+    atom = JS_NewAtomStr(ctx, JS_VALUE_GET_STRING(str));
+    if (atom == JS_ATOM_NULL)
+        goto fail;
+    return atom;
+ fail:
+    JS_FreeValue(ctx, JS_GetException(ctx));
+    return JS_ATOM_NULL;
+}
+
 /* peephole optimizations and resolve goto/labels */
 static __exception int resolve_labels(JSContext *ctx, JSFunctionDef *s)
 {
@@ -31370,6 +33496,7 @@ static __exception int resolve_labels(JSContext *ctx, JSFunctionDef *s)
     RelocEntry *re, *re_next;
     CodeContext cc;
     int label;
+    uint8_t *args_el_tab = NULL;
 #if SHORT_OPCODES
     JumpSlot *jp;
 #endif
@@ -31378,6 +33505,9 @@ static __exception int resolve_labels(JSContext *ctx, JSFunctionDef *s)
 
     line_num = s->line_num;
 
+    if (OPTIMIZE >= 2 && remove_redundant_checks(ctx, s))
+        return -1;
+
     cc.bc_buf = bc_buf = s->byte_code.buf;
     cc.bc_len = bc_len = s->byte_code.size;
     js_dbuf_init(ctx, &bc_out);
@@ -31398,6 +33528,9 @@ static __exception int resolve_labels(JSContext *ctx, JSFunctionDef *s)
         s->line_number_last_pc = 0;
     }
 
+    if (OPTIMIZE >= 2 && find_arguments_uses(ctx, s, &args_el_tab))
+        goto fail;
+
     /* initialize the 'home_object' variable if needed */
     if (s->home_object_var_idx >= 0) {
         dbuf_putc(&bc_out, OP_special_object);
@@ -31428,7 +33561,7 @@ static __exception int resolve_labels(JSContext *ctx, JSFunctionDef *s)
         }
     }
     /* initialize the 'arguments' variable if needed */
-    if (s->arguments_var_idx >= 0) {
+    if (s->arguments_var_idx >= 0 && !args_el_tab) {
         if ((s->js_mode & JS_MODE_STRICT) || !s->has_simple_parameter_list) {
             dbuf_putc(&bc_out, OP_special_object);
             dbuf_putc(&bc_out, OP_SPECIAL_OBJECT_ARGUMENTS);
@@ -31514,6 +33647,14 @@ static __exception int resolve_labels(JSContext *ctx, JSFunctionDef *s)
                     pos_next = skip_dead_code(s, bc_buf, bc_len, cc.pos, &line_num);
                     break;
                 }
+                /* also when the return is reached through labels and
+                   jumps, as in 'return c ? f() : g()' */
+                if (code_is_return(s, pos_next)) {
+                    add_pc2line_info(s, bc_out.size, line_num);
+                    put_short_code(&bc_out, op + 1, argc);
+                    pos_next = skip_dead_code(s, bc_buf, bc_len, pos_next, &line_num);
+                    break;
+                }
                 add_pc2line_info(s, bc_out.size, line_num);
                 put_short_code(&bc_out, op, argc);
                 break;
@@ -31760,8 +33901,33 @@ static __exception int resolve_labels(JSContext *ctx, JSFunctionDef *s)
 
         case OP_push_i32:
             if (OPTIMIZE) {
-                /* transform i32(val) neg -> i32(-val) */
                 val = get_i32(bc_buf + pos + 1);
+                /* the integer semantics are different in math mode */
+                if (OPTIMIZE >= 2 && !(s->js_mode & JS_MODE_MATH)) {
+                    /* constant folding:
+                       i32(a) neg -> i32(-a)
+                       i32(a) i32(b) binop -> i32(a binop b)
+                     */
+                    for(;;) {
+                        if (val != INT32_MIN && val != 0 &&
+                            code_match(&cc, pos_next, OP_neg, -1)) {
+                            val = -val;
+                        } else if ((code_match(&cc, pos_next, OP_push_i32, M4(OP_add, OP_sub, OP_mul, OP_and), -1) ||
+                                    code_match(&cc, pos_next, OP_push_i32, M4(OP_or, OP_xor, OP_shl, OP_sar), -1)) &&
+                                   fold_int32_binary_op(cc.op, val, cc.label, &val)) {
+                        } else {
+                            break;
+                        }
+                        if (cc.line_num >= 0) line_num = cc.line_num;
+                        pos_next = cc.pos;
+                    }
+                    /* i32(a) to_propkey -> i32(a) */
+                    if (code_match(&cc, pos_next, OP_to_propkey, -1)) {
+                        if (cc.line_num >= 0) line_num = cc.line_num;
+                        pos_next = cc.pos;
+                    }
+                }
+                /* transform i32(val) neg -> i32(-val) */
                 if ((val != INT32_MIN && val != 0)
                 &&  code_match(&cc, pos_next, OP_neg, -1)) {
                     if (cc.line_num >= 0) line_num = cc.line_num;
@@ -31820,6 +33986,26 @@ static __exception int resolve_labels(JSContext *ctx, JSFunctionDef *s)
         case OP_push_atom_value:
             if (OPTIMIZE) {
                 JSAtom atom = get_u32(bc_buf + pos + 1);
+                if (OPTIMIZE >= 2) {
+                    /* static string concatenation:
+                       push_atom_value(a) push_atom_value(b) add -> push_atom_value(a + b)
+                     */
+                    while (code_match(&cc, pos_next, OP_push_atom_value, OP_add, -1)) {
+                        JSAtom atom1 = concat_atom_strings(ctx, atom, cc.atom);
+                        if (atom1 == JS_ATOM_NULL)
+                            break;
+                        JS_FreeAtom(ctx, atom);
+                        JS_FreeAtom(ctx, cc.atom);
+                        atom = atom1;
+                        if (cc.line_num >= 0) line_num = cc.line_num;
+                        pos_next = cc.pos;
+                    }
+                    /* push_atom_value(a) to_propkey -> push_atom_value(a) */
+                    if (code_match(&cc, pos_next, OP_to_propkey, -1)) {
+                        if (cc.line_num >= 0) line_num = cc.line_num;
+                        pos_next = cc.pos;
+                    }
+                }
                 /* remove push/drop pairs generated by the parser */
                 if (code_match(&cc, pos_next, OP_drop, -1)) {
                     JS_FreeAtom(ctx, atom);
@@ -31827,14 +34013,27 @@ static __exception int resolve_labels(JSContext *ctx, JSFunctionDef *s)
                     pos_next = cc.pos;
                     break;
                 }
+                add_pc2line_info(s, bc_out.size, line_num);
 #if SHORT_OPCODES
                 if (atom == JS_ATOM_empty_string) {
                     JS_FreeAtom(ctx, atom);
-                    add_pc2line_info(s, bc_out.size, line_num);
                     dbuf_putc(&bc_out, OP_push_empty_string);
                     break;
                 }
 #endif
+                dbuf_putc(&bc_out, OP_push_atom_value);
+                dbuf_put_u32(&bc_out, atom);
+                break;
+            }
+            goto no_change;
+
+        case OP_set_loc_uninitialized:
+            if (OPTIMIZE >= 2) {
+                /* remove the store if the variable is initialized
+                   before it can be read */
+                if (code_overwrites_loc(bc_buf, bc_len, pos_next,
+                                        get_u16(bc_buf + pos + 1)))
+                    break;
             }
             goto no_change;
 
@@ -31939,6 +34138,19 @@ static __exception int resolve_labels(JSContext *ctx, JSFunctionDef *s)
             goto no_change;
 
         case OP_get_loc:
+            if (args_el_tab &&
+                get_u16(bc_buf + pos + 1) == s->arguments_var_idx) {
+                /* the 'arguments' object is not created */
+                if (code_match(&cc, pos_next, OP_get_field, -1) &&
+                    cc.atom == JS_ATOM_length) {
+                    if (cc.line_num >= 0) line_num = cc.line_num;
+                    JS_FreeAtom(ctx, cc.atom);
+                    add_pc2line_info(s, bc_out.size, line_num);
+                    dbuf_putc(&bc_out, OP_get_arguments_length);
+                    pos_next = cc.pos;
+                }
+                break;
+            }
             if (OPTIMIZE) {
                 /* transformation:
                    get_loc(n) post_dec put_loc(n) drop -> dec_loc(n)
@@ -32130,6 +34342,14 @@ static __exception int resolve_labels(JSContext *ctx, JSFunctionDef *s)
             goto no_change;
 #endif
 
+        case OP_get_array_el:
+            if (args_el_tab && args_el_tab[pos]) {
+                add_pc2line_info(s, bc_out.size, line_num);
+                dbuf_putc(&bc_out, OP_get_arguments_el);
+                break;
+            }
+            goto no_change;
+
         default:
         no_change:
             add_pc2line_info(s, bc_out.size, line_num);
@@ -32138,6 +34358,8 @@ static __exception int resolve_labels(JSContext *ctx, JSFunctionDef *s)
         }
     }
 
+    js_free(ctx, args_el_tab);
+
     /* check that there were no missing labels */
     for(i = 0; i < s->label_count; i++) {
         assert(label_slots[i].first_reloc == NULL);
@@ -32238,6 +34460,7 @@ static __exception int resolve_labels(JSContext *ctx, JSFunctionDef *s)
     return 0;
  fail:
     /* XXX: not safe */
+    js_free(ctx, args_el_tab);
     dbuf_free(&bc_out);
     return -1;
 }
@@ -32471,6 +34694,101 @@ static int add_module_variables(JSContext *ctx, JSFunctionDef *fd)
 /* create a function object from a function definition. The function
    definition is freed. All the child functions are also created. It
    must be done this way to resolve all the variables. */
+/* Replace get_field, get_field2, put_field and the global variable
+   accesses with the opcodes using an inline cache. The caches take the
+   ownership of the atoms. Nothing is done if the bytecode is read-only or
+   if there is not enough memory. */
+static void js_bytecode_init_ic(JSContext *ctx, JSFunctionBytecode *b)
+{
+    uint8_t *bc_buf;
+    int pos, len, op, ic_count, global_ic_count;
+    JSPropertyIC *ic;
+    JSGlobalVarIC *global_ic;
+
+    if (b->read_only_bytecode)
+        return;
+    bc_buf = b->byte_code_buf;
+    ic_count = 0;
+    global_ic_count = 0;
+    for(pos = 0; pos < b->byte_code_len; pos += len) {
+        op = bc_buf[pos];
+        len = short_opcode_info(op).size;
+        switch(op) {
+        case OP_get_field:
+        case OP_get_field2:
+        case OP_put_field:
+            ic_count++;
+            break;
+        case OP_get_var:
+        case OP_get_var_undef:
+        case OP_put_var:
+        case OP_put_var_strict:
+            global_ic_count++;
+            break;
+        default:
+            break;
+        }
+    }
+    if (ic_count == 0 && global_ic_count == 0)
+        return;
+    ic = NULL;
+    global_ic = NULL;
+    if (ic_count != 0) {
+        ic = js_mallocz_rt(ctx->rt, sizeof(ic[0]) * ic_count);
+        if (!ic)
+            return;
+    }
+    if (global_ic_count != 0) {
+        global_ic = js_mallocz_rt(ctx->rt, sizeof(global_ic[0]) * global_ic_count);
+        if (!global_ic) {
+            js_free_rt(ctx->rt, ic);
+            return;
+        }
+    }
+    ic_count = 0;
+    global_ic_count = 0;
+    for(pos = 0; pos < b->byte_code_len; pos += len) {
+        op = bc_buf[pos];
+        len = short_opcode_info(op).size;
+        switch(op) {
+        case OP_get_field:
+        case OP_get_field2:
+        case OP_put_field:
+            if (op == OP_get_field)
+                bc_buf[pos] = OP_get_field_ic;
+            else if (op == OP_get_field2)
+                bc_buf[pos] = OP_get_field2_ic;
+            else
+                bc_buf[pos] = OP_put_field_ic;
+            ic[ic_count].atom = get_u32(bc_buf + pos + 1);
+            put_u32(bc_buf + pos + 1, ic_count);
+            ic_count++;
+            break;
+        case OP_get_var:
+        case OP_get_var_undef:
+        case OP_put_var:
+        case OP_put_var_strict:
+            if (op == OP_put_var)
+                bc_buf[pos] = OP_put_var_ic;
+            else if (op == OP_put_var_strict)
+                bc_buf[pos] = OP_put_var_strict_ic;
+            else
+                bc_buf[pos] = OP_get_var_ic;
+            global_ic[global_ic_count].atom = get_u32(bc_buf + pos + 1);
+            global_ic[global_ic_count].opcode = op;
+            put_u32(bc_buf + pos + 1, global_ic_count);
+            global_ic_count++;
+            break;
+        default:
+            break;
+        }
+    }
+    b->ic = ic;
+    b->ic_count = ic_count;
+    b->global_ic = global_ic;
+    b->global_ic_count = global_ic_count;
+}
+
 static JSValue js_create_function(JSContext *ctx, JSFunctionDef *fd)
 {
     JSValue func_obj;
@@ -32683,6 +35001,7 @@ static JSValue js_create_function(JSContext *ctx, JSFunctionDef *fd)
         js_dump_function_bytecode(ctx, b);
     }
 #endif
+    js_bytecode_init_ic(ctx, b);
 
     if (fd->parent) {
         /* remove from parent list */
@@ -32696,6 +35015,23 @@ static JSValue js_create_function(JSContext *ctx, JSFunctionDef *fd)
     return JS_EXCEPTION;
 }
 
+static void js_free_ic(JSRuntime *rt, JSPropertyIC *ic, int ic_count)
+{
+    JSPropertyICWay *w;
+    int i, j;
+
+    for(i = 0; i < ic_count; i++) {
+        JS_FreeAtomRT(rt, ic[i].atom);
+        for(j = 0; j < ic[i].way_count; j++) {
+            w = &ic[i].ways[j];
+            js_free_shape(rt, w->shape);
+            if (w->proto_shape)
+                js_free_shape(rt, w->proto_shape);
+        }
+    }
+    js_free_rt(rt, ic);
+}
+
 static void free_function_bytecode(JSRuntime *rt, JSFunctionBytecode *b)
 {
     int i;
@@ -32708,6 +35044,13 @@ static void free_function_bytecode(JSRuntime *rt, JSFunctionBytecode *b)
     }
 #endif
     free_bytecode_atoms(rt, b->byte_code_buf, b->byte_code_len, TRUE);
+    if (b->ic)
+        js_free_ic(rt, b->ic, b->ic_count);
+    if (b->global_ic) {
+        for(i = 0; i < b->global_ic_count; i++)
+            JS_FreeAtomRT(rt, b->global_ic[i].atom);
+        js_free_rt(rt, b->global_ic);
+    }
 
     if (b->vardefs) {
         for(i = 0; i < b->arg_count + b->var_count; i++) {
@@ -33896,9 +36239,9 @@ typedef enum BCTagEnum {
 } BCTagEnum;
 
 #ifdef CONFIG_BIGNUM
-#define BC_BASE_VERSION 2
+#define BC_BASE_VERSION 4
 #else
-#define BC_BASE_VERSION 1
+#define BC_BASE_VERSION 3
 #endif
 #define BC_BE_VERSION 0x40
 #ifdef WORDS_BIGENDIAN
@@ -34112,22 +36455,39 @@ static void bc_byte_swap(uint8_t *bc_buf, int bc_len)
 }
 
 static int JS_WriteFunctionBytecode(BCWriterState *s,
-                                    const uint8_t *bc_buf1, int bc_len)
+                                    const JSFunctionBytecode *b)
 {
-    int pos, len, op;
+    int pos, len, op, bc_len;
     JSAtom atom;
     uint8_t *bc_buf;
     uint32_t val;
 
+    bc_len = b->byte_code_len;
     bc_buf = js_malloc(s->ctx, bc_len);
     if (!bc_buf)
         return -1;
-    memcpy(bc_buf, bc_buf1, bc_len);
+    memcpy(bc_buf, b->byte_code_buf, bc_len);
 
     pos = 0;
     while (pos < bc_len) {
         op = bc_buf[pos];
         len = short_opcode_info(op).size;
+        /* the inline caches are not serialized */
+        if (op >= OP_get_field_ic && op <= OP_put_field_ic) {
+            static const uint8_t ic_opcodes[] = {
+                OP_get_field, OP_get_field2, OP_put_field,
+            };
+            atom = b->ic[get_u32(bc_buf + pos + 1)].atom;
+            op = ic_opcodes[op - OP_get_field_ic];
+            bc_buf[pos] = op;
+            put_u32(bc_buf + pos + 1, atom);
+        } else if (op >= OP_get_var_ic && op <= OP_put_var_strict_ic) {
+            const JSGlobalVarIC *global_ic;
+            global_ic = &b->global_ic[get_u32(bc_buf + pos + 1)];
+            op = global_ic->opcode;
+            bc_buf[pos] = op;
+            put_u32(bc_buf + pos + 1, global_ic->atom);
+        }
         switch(short_opcode_info(op).fmt) {
         case OP_FMT_atom:
         case OP_FMT_atom_u8:
@@ -34373,7 +36733,7 @@ static int JS_WriteFunctionTag(BCWriterState *s, JSValueConst obj)
         bc_put_u8(s, flags);
     }
 
-    if (JS_WriteFunctionBytecode(s, b->byte_code_buf, b->byte_code_len))
+    if (JS_WriteFunctionBytecode(s, b))
         goto fail;
 
     if (b->has_debug) {
@@ -34685,6 +37045,25 @@ static int JS_WriteObjectRec(BCWriterState *s, JSValueConst obj)
         }
         break;
 #ifdef CONFIG_BIGNUM
+    case JS_TAG_SHORT_BIG_INT:
+        {
+            /* written as a big int */
+            JSValue val;
+            int ret;
+            val = JS_NewBigInt(s->ctx);
+            if (JS_IsException(val))
+                goto fail;
+            if (bf_set_si(JS_GetBigInt(val), JS_VALUE_GET_SHORT_BIG_INT(obj))) {
+                JS_FreeValue(s->ctx, val);
+                JS_ThrowOutOfMemory(s->ctx);
+                goto fail;
+            }
+            ret = JS_WriteBigNum(s, val);
+            JS_FreeValue(s->ctx, val);
+            if (ret)
+                goto fail;
+        }
+        break;
     case JS_TAG_BIG_INT:
     case JS_TAG_BIG_FLOAT:
     case JS_TAG_BIG_DECIMAL:
@@ -35053,6 +37432,11 @@ static int JS_ReadFunctionBytecode(BCReaderState *s, JSFunctionBytecode *b,
     while (pos < bc_len) {
         op = bc_buf[pos];
         len = short_opcode_info(op).size;
+        if (op >= OP_get_field_ic && op <= OP_put_var_strict_ic) {
+            b->byte_code_len = pos;
+            JS_ThrowSyntaxError(s->ctx, "invalid opcode");
+            return -1;
+        }
         switch(short_opcode_info(op).fmt) {
         case OP_FMT_atom:
         case OP_FMT_atom_u8:
@@ -35080,6 +37464,7 @@ static int JS_ReadFunctionBytecode(BCReaderState *s, JSFunctionBytecode *b,
         }
         pos += len;
     }
+    js_bytecode_init_ic(s->ctx, b);
     return 0;
 }
 
@@ -35210,6 +37595,8 @@ static JSValue JS_ReadBigNum(BCReaderState *s, int tag)
         }
     }
     bc_read_trace(s, "}\n");
+    if (tag == BC_TAG_BIG_INT)
+        obj = JS_CompactBigInt1(s->ctx, obj, FALSE);
     return obj;
  fail:
     JS_FreeValue(s->ctx, obj);
@@ -36280,6 +38667,7 @@ static JSValue JS_ToObject(JSContext *ctx, JSValueConst val)
         return JS_DupValue(ctx, val);
 #ifdef CONFIG_BIGNUM
     case JS_TAG_BIG_INT:
+    case JS_TAG_SHORT_BIG_INT:
         obj = JS_NewObjectClass(ctx, JS_CLASS_BIG_INT);
         goto set_value;
     case JS_TAG_BIG_FLOAT:
@@ -37649,8 +40037,9 @@ static JSValue js_function_apply(JSContext *ctx, JSValueConst this_val,
                                  int argc, JSValueConst *argv, int magic)
 {
     JSValueConst this_arg, array_arg;
-    uint32_t len;
-    JSValue *tab, ret;
+    uint32_t len, count32, i;
+    JSValue *tab, *arrp, ret;
+    BOOL is_fast;
 
     if (check_function(ctx, this_val))
         return JS_EXCEPTION;
@@ -37660,15 +40049,35 @@ static JSValue js_function_apply(JSContext *ctx, JSValueConst this_val,
          JS_VALUE_GET_TAG(array_arg) == JS_TAG_NULL) && magic != 2) {
         return JS_Call(ctx, this_val, this_arg, 0, NULL);
     }
-    tab = build_arg_list(ctx, &len, array_arg);
-    if (!tab)
-        return JS_EXCEPTION;
+    is_fast = FALSE;
+    if (js_get_fast_array(ctx, array_arg, &arrp, &count32)) {
+        if (js_get_length32(ctx, &len, array_arg))
+            return JS_EXCEPTION;
+        is_fast = (len == count32 && len <= JS_MAX_LOCAL_VARS &&
+                   !js_check_stack_overflow(ctx->rt, sizeof(tab[0]) * len));
+    }
+    if (is_fast) {
+        /* copy the arguments on the stack: the array may be modified
+           by the callee */
+        tab = alloca(sizeof(tab[0]) * len);
+        for(i = 0; i < len; i++)
+            tab[i] = JS_DupValue(ctx, arrp[i]);
+    } else {
+        tab = build_arg_list(ctx, &len, array_arg);
+        if (!tab)
+            return JS_EXCEPTION;
+    }
     if (magic & 1) {
         ret = JS_CallConstructor2(ctx, this_val, this_arg, len, (JSValueConst *)tab);
     } else {
         ret = JS_Call(ctx, this_val, this_arg, len, (JSValueConst *)tab);
     }
-    free_arg_list(ctx, tab, len);
+    if (is_fast) {
+        for(i = 0; i < len; i++)
+            JS_FreeValue(ctx, tab[i]);
+    } else {
+        free_arg_list(ctx, tab, len);
+    }
     return ret;
 }
 
@@ -39390,7 +41799,7 @@ static int js_array_cmp_generic(const void *a, const void *b, void *opaque) {
          * objects: avoid method call overhead.
          */
         if (!memcmp(&ap->val, &bp->val, sizeof(ap->val)))
-            goto cmp_same;
+            return 0;
         argv[0] = ap->val;
         argv[1] = bp->val;
         res = JS_Call(ctx, psc->method, JS_UNDEFINED, 2, argv);
@@ -39423,26 +41832,76 @@ static int js_array_cmp_generic(const void *a, const void *b, void *opaque) {
         }
         cmp = js_string_compare(ctx, ap->str, bp->str);
     }
-    if (cmp != 0)
-        return cmp;
-cmp_same:
-    /* make sort stable: compare array offsets */
-    return (ap->pos > bp->pos) - (ap->pos < bp->pos);
+    /* the sort is stable, no need to compare the array offsets */
+    return cmp;
 
 exception:
     psc->exception = 1;
     return 0;
 }
 
+/* default order of the arrays of strings */
+static int js_array_cmp_string(const void *a, const void *b, void *opaque) {
+    struct array_sort_context *psc = opaque;
+    return js_string_compare(psc->ctx,
+                             JS_VALUE_GET_STRING(((const ValueSlot *)a)->val),
+                             JS_VALUE_GET_STRING(((const ValueSlot *)b)->val));
+}
+
+static int count_decimal_digits(uint32_t v)
+{
+    int n = 1;
+    while (v >= 10) {
+        v /= 10;
+        n++;
+    }
+    return n;
+}
+
+/* default order of the arrays of int32: compare the decimal
+   representations without building them */
+static int js_array_cmp_int(const void *a, const void *b, void *opaque) {
+    int32_t v1 = JS_VALUE_GET_INT(((const ValueSlot *)a)->val);
+    int32_t v2 = JS_VALUE_GET_INT(((const ValueSlot *)b)->val);
+    uint32_t x, y;
+    uint64_t x1, y1;
+    int dx, dy;
+
+    /* '-' is before the digits */
+    if ((v1 < 0) != (v2 < 0))
+        return v1 < 0 ? -1 : 1;
+    x = v1 < 0 ? -(uint32_t)v1 : v1;
+    y = v2 < 0 ? -(uint32_t)v2 : v2;
+    if (x == y)
+        return 0;
+    /* align the most significant digits */
+    x1 = x;
+    y1 = y;
+    dx = count_decimal_digits(x);
+    dy = count_decimal_digits(y);
+    for(; dx < dy; dx++)
+        x1 *= 10;
+    for(; dy < dx; dy++)
+        y1 *= 10;
+    if (x1 != y1)
+        return x1 < y1 ? -1 : 1;
+    /* one is a prefix of the other one */
+    return x < y ? -1 : 1;
+}
+
 static JSValue js_array_sort(JSContext *ctx, JSValueConst this_val,
                              int argc, JSValueConst *argv)
 {
     struct array_sort_context asc = { ctx, 0, 0, argv[0] };
     JSValue obj = JS_UNDEFINED;
-    ValueSlot *array = NULL;
+    ValueSlot *array = NULL, *tmp;
     size_t array_size = 0, pos = 0, n = 0;
     int64_t i, len, undefined_count = 0;
     int present;
+    JSValue *arrp;
+    uint32_t count32;
+    BOOL all_int, all_string;
+    int (*cmp)(const void *a, const void *b, void *opaque);
 
     if (!JS_IsUndefined(asc.method)) {
         if (check_function(ctx, asc.method))
@@ -39453,42 +41912,85 @@ static JSValue js_array_sort(JSContext *ctx, JSValueConst this_val,
     if (js_get_length64(ctx, &len, obj))
         goto exception;
 
-    /* XXX: should special case fast arrays */
-    for (i = 0; i < len; i++) {
-        if (pos >= array_size) {
-            size_t new_size, slack;
-            ValueSlot *new_array;
-            new_size = (array_size + (array_size >> 1) + 31) & ~15;
-            new_array = js_realloc2(ctx, array, new_size * sizeof(*array), &slack);
-            if (new_array == NULL)
+    if (js_get_fast_array(ctx, obj, &arrp, &count32) && count32 == len) {
+        /* no getter can be called, read the values directly */
+        if (len > 0) {
+            array = js_malloc(ctx, len * sizeof(*array));
+            if (!array)
                 goto exception;
-            new_size += slack / sizeof(*new_array);
-            array = new_array;
-            array_size = new_size;
+            array_size = len;
         }
-        present = JS_TryGetPropertyInt64(ctx, obj, i, &array[pos].val);
-        if (present < 0)
-            goto exception;
-        if (present == 0)
-            continue;
-        if (JS_IsUndefined(array[pos].val)) {
-            undefined_count++;
-            continue;
+        for (i = 0; i < len; i++) {
+            if (JS_IsUndefined(arrp[i])) {
+                undefined_count++;
+                continue;
+            }
+            array[pos].val = JS_DupValue(ctx, arrp[i]);
+            array[pos].str = NULL;
+            array[pos].pos = i;
+            pos++;
         }
-        array[pos].str = NULL;
-        array[pos].pos = i;
-        pos++;
+    } else {
+        for (i = 0; i < len; i++) {
+            if (pos >= array_size) {
+                size_t new_size, slack;
+                ValueSlot *new_array;
+                new_size = (array_size + (array_size >> 1) + 31) & ~15;
+                new_array = js_realloc2(ctx, array, new_size * sizeof(*array), &slack);
+                if (new_array == NULL)
+                    goto exception;
+                new_size += slack / sizeof(*new_array);
+                array = new_array;
+                array_size = new_size;
+            }
+            present = JS_TryGetPropertyInt64(ctx, obj, i, &array[pos].val);
+            if (present < 0)
+                goto exception;
+            if (present == 0)
+                continue;
+            if (JS_IsUndefined(array[pos].val)) {
+                undefined_count++;
+                continue;
+            }
+            array[pos].str = NULL;
+            array[pos].pos = i;
+            pos++;
+        }
+    }
+
+    cmp = js_array_cmp_generic;
+    if (!asc.has_method) {
+        /* the default order of the strings and of the int32 does not
+           need the ToString() conversions */
+        all_int = all_string = TRUE;
+        for (i = 0; i < pos; i++) {
+            uint32_t tag = JS_VALUE_GET_TAG(array[i].val);
+            all_int &= (tag == JS_TAG_INT);
+            all_string &= (tag == JS_TAG_STRING);
+        }
+        if (all_int)
+            cmp = js_array_cmp_int;
+        else if (all_string)
+            cmp = js_array_cmp_string;
+    }
+    if (pos > 1) {
+        tmp = js_malloc(ctx, (pos / 2) * sizeof(*tmp));
+        if (!tmp)
+            goto exception;
+        rmsort(array, pos, sizeof(*array), cmp, &asc, tmp);
+        js_free(ctx, tmp);
     }
-    rqsort(array, pos, sizeof(*array), js_array_cmp_generic, &asc);
     if (asc.exception)
         goto exception;
 
-    /* XXX: should special case fast arrays */
     while (n < pos) {
         if (array[n].str)
             JS_FreeValue(ctx, JS_MKPTR(JS_TAG_STRING, array[n].str));
         if (array[n].pos == n) {
             JS_FreeValue(ctx, array[n].val);
+        } else if (js_get_fast_array(ctx, obj, &arrp, &count32) &&
+                   n < count32) {
+            set_value(ctx, &arrp[n], array[n].val);
         } else {
             if (JS_SetPropertyInt64(ctx, obj, n, array[n].val) < 0) {
                 n++;
@@ -39725,6 +42227,9 @@ static JSValue js_number_constructor(JSContext *ctx, JSValueConst new_target,
             return val;
         switch(JS_VALUE_GET_TAG(val)) {
 #ifdef CONFIG_BIGNUM
+        case JS_TAG_SHORT_BIG_INT:
+            val = JS_NewFloat64(ctx, JS_VALUE_GET_SHORT_BIG_INT(val));
+            break;
         case JS_TAG_BIG_INT:
         case JS_TAG_BIG_FLOAT:
             {
@@ -40441,12 +42946,17 @@ static JSValue js_string_concat(JSContext *ctx, JSValueConst this_val,
 
 static int string_cmp(JSString *p1, JSString *p2, int x1, int x2, int len)
 {
-    int i, c1, c2;
-    for (i = 0; i < len; i++) {
-        if ((c1 = string_get(p1, x1 + i)) != (c2 = string_get(p2, x2 + i)))
-            return c1 - c2;
+    if (!p1->is_wide_char) {
+        if (!p2->is_wide_char)
+            return memcmp(p1->u.str8 + x1, p2->u.str8 + x2, len);
+        else
+            return -memcmp16_8(p2->u.str16 + x2, p1->u.str8 + x1, len);
+    } else {
+        if (!p2->is_wide_char)
+            return memcmp16_8(p1->u.str16 + x1, p2->u.str8 + x2, len);
+        else
+            return memcmp16(p1->u.str16 + x1, p2->u.str16 + x2, len);
     }
-    return 0;
 }
 
 static int string_indexof_char(JSString *p, int c, int from)
@@ -40454,16 +42964,14 @@ static int string_indexof_char(JSString *p, int c, int from)
     /* assuming 0 <= from <= p->len */
     int i, len = p->len;
     if (p->is_wide_char) {
-        for (i = from; i < len; i++) {
-            if (p->u.str16[i] == c)
-                return i;
-        }
+        i = from + str16_chr(p->u.str16 + from, len - from, c);
+        if (i < len)
+            return i;
     } else {
         if ((c & ~0xff) == 0) {
-            for (i = from; i < len; i++) {
-                if (p->u.str8[i] == (uint8_t)c)
-                    return i;
-            }
+            const uint8_t *q = memchr(p->u.str8 + from, c, len - from);
+            if (q)
+                return q - p->u.str8;
         }
     }
     return -1;
@@ -40543,13 +43051,17 @@ static JSValue js_string_indexOf(JSContext *ctx, JSValueConst this_val,
     }
     ret = -1;
     if (len >= v_len && inc * (stop - start) >= 0) {
-        for (i = start;; i += inc) {
-            if (!string_cmp(p, p1, i, 0, v_len)) {
-                ret = i;
-                break;
+        if (inc > 0) {
+            ret = string_indexof(p, p1, start);
+        } else {
+            for (i = start;; i += inc) {
+                if (!string_cmp(p, p1, i, 0, v_len)) {
+                    ret = i;
+                    break;
+                }
+                if (i == stop)
+                    break;
             }
-            if (i == stop)
-                break;
         }
     }
     JS_FreeValue(ctx, str);
@@ -40569,7 +43081,7 @@ static JSValue js_string_includes(JSContext *ctx, JSValueConst this_val,
                                   int argc, JSValueConst *argv, int magic)
 {
     JSValue str, v = JS_UNDEFINED;
-    int i, len, v_len, pos, start, stop, ret;
+    int len, v_len, pos, start, stop, ret;
     JSString *p;
     JSString *p1;
 
@@ -40609,13 +43121,10 @@ static JSValue js_string_includes(JSContext *ctx, JSValueConst this_val,
         start = stop = pos;
     }
     if (start >= 0 && start <= stop) {
-        for (i = start;; i++) {
-            if (!string_cmp(p, p1, i, 0, v_len)) {
-                ret = 1;
-                break;
-            }
-            if (i == stop)
-                break;
+        if (magic == 0) {
+            ret = (string_indexof(p, p1, start) >= 0);
+        } else if (!string_cmp(p, p1, start, 0, v_len)) {
+            ret = 1;
         }
     }
  done:
@@ -43546,6 +46055,134 @@ static int json_parse_expect(JSParseState *s, int tok)
     return json_next_token(s);
 }
 
+/* Read the next token when a property name or '}' is expected. A
+   property name without escape sequences followed by ':' is converted to
+   an atom without creating a string: return 1 with the atom in *pname and
+   the first token of the property value read. Otherwise return 0 with the
+   next token read, or -1 if exception. */
+static int json_next_prop_name(JSParseState *s, JSAtom *pname)
+{
+    const uint8_t *p, *name;
+    size_t len;
+    JSAtom atom;
+
+    p = s->buf_ptr;
+    for(;;) {
+        if (*p == ' ' || *p == '\t') {
+            p++;
+        } else if (*p == '\n' || *p == '\r') {
+            if (p[0] == '\r' && p[1] == '\n')
+                p++;
+            p++;
+            s->line_num++;
+        } else {
+            break;
+        }
+    }
+    s->buf_ptr = p;
+    if (*p == '\"') {
+        name = p + 1;
+        len = str8_plain_len(name, s->buf_end - name, '\"');
+        p = name + len;
+        if (*p == '\"') {
+            p++;
+            while (*p == ' ' || *p == '\t')
+                p++;
+            if (*p == ':') {
+                atom = JS_NewAtomLen(s->ctx, (const char *)name, len);
+                if (atom == JS_ATOM_NULL)
+                    return -1;
+                s->buf_ptr = p + 1;
+                if (json_next_token(s)) {
+                    JS_FreeAtom(s->ctx, atom);
+                    return -1;
+                }
+                *pname = atom;
+                return 1;
+            }
+        }
+    }
+    if (json_next_token(s))
+        return -1;
+    return 0;
+}
+
+typedef struct JSONProp {
+    JSAtom atom;
+    JSValue value;
+} JSONProp;
+
+static inline int json_shape_hash(const JSONProp *props, int count)
+{
+    return (count * 31 + props[0].atom * 17 + props[count - 1].atom) %
+        JSON_SHAPE_CACHE_SIZE;
+}
+
+/* Create the object of the properties parsed by JSON.parse(). The
+   shape of the last object created with the same property names is
+   reused, so that arrays of records are allocated with their final shape
+   instead of adding the properties one by one. The atoms and values of
+   'props' are freed. */
+static JSValue json_build_object(JSContext *ctx, JSONProp *props, int count)
+{
+    JSShape *sh, **psh;
+    JSShapeProperty *prs;
+    JSObject *p;
+    JSValue obj;
+    int i;
+
+    if (count == 0)
+        return JS_NewObject(ctx);
+    psh = &ctx->json_shapes[json_shape_hash(props, count)];
+    sh = *psh;
+    if (sh && sh->prop_count == count) {
+        prs = get_shape_prop(sh);
+        for(i = 0; i < count; i++) {
+            if (prs[i].atom != props[i].atom)
+                break;
+        }
+        if (i == count) {
+            obj = JS_NewObjectFromShape(ctx, js_dup_shape(sh), JS_CLASS_OBJECT);
+            if (JS_IsException(obj))
+                goto fail;
+            p = JS_VALUE_GET_OBJ(obj);
+            for(i = 0; i < count; i++) {
+                p->prop[i].u.value = props[i].value;
+                JS_FreeAtom(ctx, props[i].atom);
+            }
+            return obj;
+        }
+    }
+
+    obj = JS_NewObject(ctx);
+    if (JS_IsException(obj))
+        goto fail;
+    for(i = 0; i < count; i++) {
+        JSValue val = props[i].value;
+        props[i].value = JS_UNDEFINED;
+        if (JS_DefinePropertyValue(ctx, obj, props[i].atom, val,
+                                   JS_PROP_C_W_E) < 0) {
+            JS_FreeValue(ctx, obj);
+            goto fail;
+        }
+    }
+    /* no duplicate names: all the properties are in the shape */
+    sh = JS_VALUE_GET_OBJ(obj)->shape;
+    if (sh->is_hashed && sh->prop_count == count) {
+        js_free_shape_null(ctx->rt, *psh);
+        *psh = js_dup_shape(sh);
+    }
+    for(i = 0; i < count; i++)
+        JS_FreeAtom(ctx, props[i].atom);
+    return obj;
+ fail:
+    for(i = 0; i < count; i++) {
+        JS_FreeAtom(ctx, props[i].atom);
+        JS_FreeValue(ctx, props[i].value);
+    }
+    return JS_EXCEPTION;
+}
+
 static JSValue json_parse_value(JSParseState *s)
 {
     JSContext *ctx = s->ctx;
@@ -43555,58 +46192,84 @@ static JSValue json_parse_value(JSParseState *s)
     switch(s->token.val) {
     case '{':
         {
+            JSONProp props_buf[16], *props, *new_props;
+            int i, count, size;
             JSValue prop_val;
             JSAtom prop_name;
 
-            if (json_next_token(s))
-                goto fail;
-            val = JS_NewObject(ctx);
-            if (JS_IsException(val))
-                goto fail;
-            if (s->token.val != '}') {
-                for(;;) {
+            props = props_buf;
+            size = countof(props_buf);
+            count = 0;
+            for(;;) {
+                ret = json_next_prop_name(s, &prop_name);
+                if (ret < 0)
+                    goto obj_fail;
+                if (ret == 0) {
+                    if (s->token.val == '}' && (count == 0 || s->ext_json))
+                        break;
                     if (s->token.val == TOK_STRING) {
                         prop_name = JS_ValueToAtom(ctx, s->token.u.str.str);
                         if (prop_name == JS_ATOM_NULL)
-                            goto fail;
+                            goto obj_fail;
                     } else if (s->ext_json && s->token.val == TOK_IDENT) {
                         prop_name = JS_DupAtom(ctx, s->token.u.ident.atom);
                     } else {
                         js_parse_error(s, "expecting property name");
-                        goto fail;
+                        goto obj_fail;
                     }
                     if (json_next_token(s))
                         goto fail1;
                     if (json_parse_expect(s, ':'))
                         goto fail1;
-                    prop_val = json_parse_value(s);
-                    if (JS_IsException(prop_val)) {
-                    fail1:
-                        JS_FreeAtom(ctx, prop_name);
-                        goto fail;
-                    }
-                    ret = JS_DefinePropertyValue(ctx, val, prop_name,
-                                                 prop_val, JS_PROP_C_W_E);
+                }
+                prop_val = json_parse_value(s);
+                if (JS_IsException(prop_val)) {
+                fail1:
                     JS_FreeAtom(ctx, prop_name);
-                    if (ret < 0)
-                        goto fail;
-
-                    if (s->token.val != ',')
-                        break;
-                    if (json_next_token(s))
-                        goto fail;
-                    if (s->ext_json && s->token.val == '}')
-                        break;
+                    goto obj_fail;
+                }
+                if (unlikely(count >= size)) {
+                    size = size * 3 / 2;
+                    if (props == props_buf) {
+                        new_props = js_malloc(ctx, sizeof(props[0]) * size);
+                        if (new_props)
+                            memcpy(new_props, props, sizeof(props[0]) * count);
+                    } else {
+                        new_props = js_realloc(ctx, props, sizeof(props[0]) * size);
+                    }
+                    if (!new_props) {
+                        JS_FreeValue(ctx, prop_val);
+                        goto fail1;
+                    }
+                    props = new_props;
                 }
+                props[count].atom = prop_name;
+                props[count].value = prop_val;
+                count++;
+                if (s->token.val != ',')
+                    break;
             }
             if (json_parse_expect(s, '}'))
+                goto obj_fail;
+            val = json_build_object(ctx, props, count);
+            if (props != props_buf)
+                js_free(ctx, props);
+            if (JS_IsException(val))
                 goto fail;
+            break;
+        obj_fail:
+            for(i = 0; i < count; i++) {
+                JS_FreeAtom(ctx, props[i].atom);
+                JS_FreeValue(ctx, props[i].value);
+            }
+            if (props != props_buf)
+                js_free(ctx, props);
+            goto fail;
         }
         break;
     case '[':
         {
             JSValue el;
-            uint32_t idx;
 
             if (json_next_token(s))
                 goto fail;
@@ -43614,19 +46277,20 @@ static JSValue json_parse_value(JSParseState *s)
             if (JS_IsException(val))
                 goto fail;
             if (s->token.val != ']') {
-                idx = 0;
                 for(;;) {
                     el = json_parse_value(s);
                     if (JS_IsException(el))
                         goto fail;
-                    ret = JS_DefinePropertyValueUint32(ctx, val, idx, el, JS_PROP_C_W_E);
+                    /* the array is not visible yet so it stays a fast
+                       array */
+                    ret = add_fast_array_element(ctx, JS_VALUE_GET_OBJ(val),
+                                                 el, 0);
                     if (ret < 0)
                         goto fail;
                     if (s->token.val != ',')
                         break;
                     if (json_next_token(s))
                         goto fail;
-                    idx++;
                     if (s->ext_json && s->token.val == ']')
                         break;
                 }
@@ -43813,6 +46477,7 @@ typedef struct JSONStringifyContext {
     JSValue gap;
     JSValue empty;
     StringBuffer *b;
+    BOOL use_fast_path; /* no replacer nor indentation */
 } JSONStringifyContext;
 
 static JSValue JS_ToQuotedStringFree(JSContext *ctx, JSValue val) {
@@ -43870,6 +46535,7 @@ static JSValue js_json_check(JSContext *ctx, JSONStringifyContext *jsc,
     case JS_TAG_NULL:
 #ifdef CONFIG_BIGNUM
     case JS_TAG_BIG_INT:
+    case JS_TAG_SHORT_BIG_INT:
 #endif
     case JS_TAG_EXCEPTION:
         return val;
@@ -43884,6 +46550,135 @@ exception:
     return JS_EXCEPTION;
 }
 
+/* maximum nesting handled by js_json_to_str_fast(). Deeper values, and
+   in particular the circular references, go through the generic code. */
+#define JSON_FAST_MAX_DEPTH 64
+
+/* TRUE if the toJSON() lookup of the plain objects and arrays cannot
+   find a method */
+static BOOL js_json_fast_protos_ok(JSContext *ctx)
+{
+    JSObject *obj_proto, *array_proto;
+    JSShapeProperty *prs;
+    JSProperty *pr;
+
+    obj_proto = JS_VALUE_GET_OBJ(ctx->class_proto[JS_CLASS_OBJECT]);
+    array_proto = JS_VALUE_GET_OBJ(ctx->class_proto[JS_CLASS_ARRAY]);
+    prs = find_own_property(&pr, obj_proto, JS_ATOM_toJSON);
+    if (prs)
+        return FALSE;
+    prs = find_own_property(&pr, array_proto, JS_ATOM_toJSON);
+    if (prs)
+        return FALSE;
+    return array_proto->shape->proto == obj_proto;
+}
+
+/* Serialize the plain objects and the fast arrays whose properties are
+   data properties, when there is no replacer and no indentation: the
+   properties are read from the shape and no user code can be called.
+   Return 0 if OK, -1 if exception or 1 if the value must be handled by
+   js_json_to_str(). In the last case, the output is partial and must be
+   dropped by the caller. */
+static int js_json_to_str_fast(JSContext *ctx, StringBuffer *b,
+                               JSValueConst val, int depth)
+{
+    JSObject *p;
+    JSShape *sh;
+    JSShapeProperty *prs;
+    JSAtomStruct *as;
+    JSValue v;
+    uint32_t i, len;
+    BOOL has_content;
+    int ret;
+    char buf[24];
+
+    switch(JS_VALUE_GET_NORM_TAG(val)) {
+    case JS_TAG_STRING:
+        return string_buffer_put_quoted(b, JS_VALUE_GET_STRING(val));
+    case JS_TAG_INT:
+        return string_buffer_puts8(b, i64toa(buf + sizeof(buf),
+                                             JS_VALUE_GET_INT(val), 10));
+    case JS_TAG_FLOAT64:
+        if (!isfinite(JS_VALUE_GET_FLOAT64(val)))
+            return string_buffer_puts8(b, "null");
+        return string_buffer_concat_value(b, val);
+    case JS_TAG_BOOL:
+        return string_buffer_puts8(b, JS_VALUE_GET_BOOL(val) ? "true" : "false");
+    case JS_TAG_NULL:
+        return string_buffer_puts8(b, "null");
+    case JS_TAG_OBJECT:
+        break;
+    default:
+        return 1;
+    }
+
+    if (depth >= JSON_FAST_MAX_DEPTH)
+        return 1;
+    p = JS_VALUE_GET_OBJ(val);
+    sh = p->shape;
+    if (p->class_id == JS_CLASS_ARRAY) {
+        /* only the 'length' property */
+        if (!p->fast_array || sh->prop_count != 1 ||
+            sh->proto != JS_VALUE_GET_OBJ(ctx->class_proto[JS_CLASS_ARRAY]))
+            return 1;
+        len = p->u.array.count;
+        if (JS_VALUE_GET_TAG(p->prop[0].u.value) != JS_TAG_INT ||
+            JS_VALUE_GET_INT(p->prop[0].u.value) != len)
+            return 1;
+        if (string_buffer_putc8(b, '['))
+            return -1;
+        for(i = 0; i < len; i++) {
+            if (i > 0 && string_buffer_putc8(b, ','))
+                return -1;
+            v = p->u.array.u.values[i];
+            if (JS_IsUndefined(v) || JS_IsSymbol(v) || JS_IsFunction(ctx, v)) {
+                if (string_buffer_puts8(b, "null"))
+                    return -1;
+            } else {
+                ret = js_json_to_str_fast(ctx, b, v, depth + 1);
+                if (ret)
+                    return ret;
+            }
+        }
+        return string_buffer_putc8(b, ']');
+    }
+
+    if (p->class_id != JS_CLASS_OBJECT ||
+        sh->proto != JS_VALUE_GET_OBJ(ctx->class_proto[JS_CLASS_OBJECT]))
+        return 1;
+    if (string_buffer_putc8(b, '{'))
+        return -1;
+    has_content = FALSE;
+    for(i = 0, prs = get_shape_prop(sh); i < sh->prop_count; i++, prs++) {
+        if (prs->atom == JS_ATOM_NULL)
+            continue;
+        /* the array index keys are enumerated first */
+        if (__JS_AtomIsTaggedInt(prs->atom))
+            return 1;
+        as = ctx->rt->atom_array[prs->atom];
+        if (as->atom_type == JS_ATOM_TYPE_SYMBOL)
+            continue;
+        if (prs->atom == JS_ATOM_toJSON ||
+            (as->len > 0 && is_digit(string_get(as, 0))) ||
+            (prs->flags & JS_PROP_TMASK) != JS_PROP_NORMAL)
+            return 1;
+        if (!(prs->flags & JS_PROP_ENUMERABLE))
+            continue;
+        v = p->prop[i].u.value;
+        if (JS_IsUndefined(v) || JS_IsSymbol(v) || JS_IsFunction(ctx, v))
+            continue;
+        if (has_content && string_buffer_putc8(b, ','))
+            return -1;
+        if (string_buffer_put_quoted(b, as) || string_buffer_putc8(b, ':'))
+            return -1;
+        ret = js_json_to_str_fast(ctx, b, v, depth + 1);
+        if (ret)
+            return ret;
+        has_content = TRUE;
+    }
+    return string_buffer_putc8(b, '}');
+}
+
 static int js_json_to_str(JSContext *ctx, JSONStringifyContext *jsc,
                           JSValueConst holder, JSValue val,
                           JSValueConst indent)
@@ -43904,6 +46699,17 @@ static int js_json_to_str(JSContext *ctx, JSONStringifyContext *jsc,
     case JS_TAG_OBJECT:
         p = JS_VALUE_GET_OBJ(val);
         cl = p->class_id;
+        if (jsc->use_fast_path &&
+            (cl == JS_CLASS_OBJECT || cl == JS_CLASS_ARRAY) &&
+            js_json_fast_protos_ok(ctx)) {
+            uint32_t len0 = jsc->b->len;
+            ret = js_json_to_str_fast(ctx, jsc->b, val, 0);
+            if (ret <= 0) {
+                JS_FreeValue(ctx, val);
+                return ret;
+            }
+            jsc->b->len = len0;
+        }
         if (cl == JS_CLASS_STRING) {
             val = JS_ToStringFree(ctx, val);
             if (JS_IsException(val))
@@ -44042,10 +46848,9 @@ static int js_json_to_str(JSContext *ctx, JSONStringifyContext *jsc,
         JS_FreeValue(ctx, prop);
         return 0;
     case JS_TAG_STRING:
-        val = JS_ToQuotedStringFree(ctx, val);
-        if (JS_IsException(val))
-            goto exception;
-        goto concat_value;
+        ret = string_buffer_put_quoted(jsc->b, JS_VALUE_GET_STRING(val));
+        JS_FreeValue(ctx, val);
+        return ret;
     case JS_TAG_FLOAT64:
         if (!isfinite(JS_VALUE_GET_FLOAT64(val))) {
             val = JS_NULL;
@@ -44061,6 +46866,7 @@ static int js_json_to_str(JSContext *ctx, JSONStringifyContext *jsc,
         return string_buffer_concat_value_free(jsc->b, val);
 #ifdef CONFIG_BIGNUM
     case JS_TAG_BIG_INT:
+    case JS_TAG_SHORT_BIG_INT:
         JS_ThrowTypeError(ctx, "bigint are forbidden in JSON.stringify");
         goto exception;
 #endif
@@ -44094,6 +46900,7 @@ JSValue JS_JSONStringify(JSContext *ctx, JSValueConst obj,
     jsc->gap = JS_UNDEFINED;
     jsc->b = &b_s;
     jsc->empty = JS_AtomToString(ctx, JS_ATOM_empty_string);
+    jsc->use_fast_path = FALSE;
     ret = JS_UNDEFINED;
     wrapper = JS_UNDEFINED;
 
@@ -44179,6 +46986,9 @@ JSValue JS_JSONStringify(JSContext *ctx, JSValueConst obj,
     JS_FreeValue(ctx, space);
     if (JS_IsException(jsc->gap))
         goto exception;
+    jsc->use_fast_path = (JS_IsUndefined(jsc->replacer_func) &&
+                          JS_IsUndefined(jsc->property_list) &&
+                          JS_IsEmptyString(jsc->gap));
     wrapper = JS_NewObject(ctx);
     if (JS_IsException(wrapper))
         goto exception;
@@ -45470,25 +48280,38 @@ static const JSCFunctionListEntry js_symbol_funcs[] = {
 
 /* Set/Map/WeakSet/WeakMap */
 
+/* The records are stored in insertion order in a dense array indexed by
+   an open addressing hash table. A deleted record keeps its slot until
+   the array is compacted, so that neither the hash table nor the
+   iterators are modified by a deletion. */
 typedef struct JSMapRecord {
-    int ref_count; /* used during enumeration to avoid freeing the record */
-    BOOL empty; /* TRUE if the record is deleted */
-    struct JSMapState *map;
-    struct JSMapRecord *next_weak_ref;
-    struct list_head link;
-    struct list_head hash_link;
-    JSValue key;
+    JSValue key; /* JS_UNINITIALIZED if the record is deleted */
     JSValue value;
+    uint32_t hash;
 } JSMapRecord;
 
+/* element of the list of the WeakMap/WeakSet using an object as key */
+typedef struct JSMapWeakRef {
+    struct JSMapWeakRef *next;
+    struct JSMapState *map;
+    JSValue value; /* only used in reset_weak_ref() */
+} JSMapWeakRef;
+
+/* enumeration position of an iterator or of forEach() */
+typedef struct JSMapCursor {
+    struct list_head link; /* JSMapState.cursors */
+    uint32_t pos; /* index of the next record */
+} JSMapCursor;
+
 typedef struct JSMapState {
     BOOL is_weak; /* TRUE if WeakSet/WeakMap */
-    struct list_head records; /* list of JSMapRecord.link */
-    uint32_t record_count;
-    struct list_head *hash_table;
-    uint32_t hash_size; /* must be a power of two */
-    uint32_t record_count_threshold; /* count at which a hash table
-                                        resize is needed */
+    uint32_t record_count; /* number of live records */
+    uint32_t records_len; /* used records, including the deleted ones */
+    uint32_t records_size; /* allocated records */
+    JSMapRecord *records;
+    uint32_t *hash_table; /* record index + 1, 0 if the slot is free */
+    uint32_t hash_size; /* 2 * records_size, power of two */
+    struct list_head cursors; /* list of JSMapCursor.link */
 } JSMapState;
 
 #define MAGIC_SET (1 << 0)
@@ -45510,15 +48333,9 @@ static JSValue js_map_constructor(JSContext *ctx, JSValueConst new_target,
     s = js_mallocz(ctx, sizeof(*s));
     if (!s)
         goto fail;
-    init_list_head(&s->records);
+    init_list_head(&s->cursors);
     s->is_weak = is_weak;
     JS_SetOpaque(obj, s);
-    s->hash_size = 1;
-    s->hash_table = js_malloc(ctx, sizeof(s->hash_table[0]) * s->hash_size);
-    if (!s->hash_table)
-        goto fail;
-    init_list_head(&s->hash_table[0]);
-    s->record_count_threshold = 4;
 
     arr = JS_UNDEFINED;
     if (argc > 0)
@@ -45615,11 +48432,22 @@ static JSValueConst map_normalize_key(JSContext *ctx, JSValueConst key)
     return key;
 }
 
-/* XXX: better hash ? */
+/* final mix of the murmur3 hash, so that the low bits depend on all
+   the bits of the key */
+static inline uint32_t map_hash_mix(uint64_t h)
+{
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
 static uint32_t map_hash_key(JSContext *ctx, JSValueConst key)
 {
     uint32_t tag = JS_VALUE_GET_NORM_TAG(key);
-    uint32_t h;
+    uint64_t h;
     double d;
     JSFloat64Union u;
 
@@ -45632,104 +48460,210 @@ static uint32_t map_hash_key(JSContext *ctx, JSValueConst key)
         break;
     case JS_TAG_OBJECT:
     case JS_TAG_SYMBOL:
-        h = (uintptr_t)JS_VALUE_GET_PTR(key) * 3163;
+        h = (uintptr_t)JS_VALUE_GET_PTR(key);
         break;
     case JS_TAG_INT:
-        d = JS_VALUE_GET_INT(key) * 3163;
-        goto hash_float64;
+        h = (uint32_t)JS_VALUE_GET_INT(key);
+        break;
     case JS_TAG_FLOAT64:
         d = JS_VALUE_GET_FLOAT64(key);
-        /* normalize the NaN */
-        if (isnan(d))
-            d = JS_FLOAT64_NAN;
-    hash_float64:
-        u.d = d;
-        h = (u.u32[0] ^ u.u32[1]) * 3163;
+        /* same hash as the equal JS_TAG_INT value */
+        if (d >= INT32_MIN && d <= INT32_MAX && (int32_t)d == d) {
+            h = (uint32_t)(int32_t)d;
+            tag = JS_TAG_INT;
+        } else {
+            /* normalize the NaN */
+            if (isnan(d))
+                d = JS_FLOAT64_NAN;
+            u.d = d;
+            h = u.u64;
+        }
+        break;
+#ifdef CONFIG_BIGNUM
+    case JS_TAG_SHORT_BIG_INT:
+        h = JS_VALUE_GET_SHORT_BIG_INT(key);
+        break;
+    case JS_TAG_BIG_INT:
+    case JS_TAG_BIG_FLOAT:
+        {
+            JSBigFloat *p = JS_VALUE_GET_PTR(key);
+            const bf_t *a = &p->num;
+            /* the sign of zero and NaN is not significant */
+            if (a->expn == BF_EXP_ZERO || a->expn == BF_EXP_NAN) {
+                h = a->expn;
+            } else {
+                h = ((uint64_t)a->expn << 1) | a->sign;
+                if (a->len > 0)
+                    h ^= (uint64_t)a->tab[a->len - 1] * 3163;
+            }
+        }
         break;
+#endif
     default:
-        h = 0; /* XXX: bignum support */
+        h = 0; /* XXX: bigdecimal support */
         break;
     }
-    h ^= tag;
-    return h;
+    return map_hash_mix(h ^ ((uint64_t)tag << 32));
+}
+
+/* SameValueZero() of 'key' with the key of a record of the same hash */
+static inline BOOL map_key_equal(JSContext *ctx, JSValueConst key1,
+                                 JSValueConst key2)
+{
+    uint32_t tag = JS_VALUE_GET_TAG(key1);
+
+    if (tag == JS_VALUE_GET_TAG(key2)) {
+        switch(tag) {
+        case JS_TAG_OBJECT:
+        case JS_TAG_SYMBOL:
+            return JS_VALUE_GET_PTR(key1) == JS_VALUE_GET_PTR(key2);
+        case JS_TAG_INT:
+        case JS_TAG_BOOL:
+            return JS_VALUE_GET_INT(key1) == JS_VALUE_GET_INT(key2);
+        case JS_TAG_STRING:
+            return JS_VALUE_GET_PTR(key1) == JS_VALUE_GET_PTR(key2) ||
+                js_string_compare(ctx, JS_VALUE_GET_STRING(key1),
+                                  JS_VALUE_GET_STRING(key2)) == 0;
+        default:
+            break;
+        }
+    }
+    return js_same_value_zero(ctx, key1, key2);
+}
+
+static inline BOOL map_record_is_deleted(const JSMapRecord *mr)
+{
+    return JS_IsUninitialized(mr->key);
 }
 
+/* 'h' is map_hash_key(ctx, key) */
 static JSMapRecord *map_find_record(JSContext *ctx, JSMapState *s,
-                                    JSValueConst key)
+                                    JSValueConst key, uint32_t h)
 {
-    struct list_head *el;
     JSMapRecord *mr;
-    uint32_t h;
-    h = map_hash_key(ctx, key) & (s->hash_size - 1);
-    list_for_each(el, &s->hash_table[h]) {
-        mr = list_entry(el, JSMapRecord, hash_link);
-        if (js_same_value_zero(ctx, mr->key, key))
+    uint32_t i, idx, mask;
+
+    if (s->record_count == 0)
+        return NULL;
+    mask = s->hash_size - 1;
+    for(i = h & mask;; i = (i + 1) & mask) {
+        idx = s->hash_table[i];
+        if (idx == 0)
+            return NULL;
+        mr = &s->records[idx - 1];
+        if (mr->hash == h && !map_record_is_deleted(mr) &&
+            map_key_equal(ctx, key, mr->key))
             return mr;
     }
-    return NULL;
 }
 
-static void map_hash_resize(JSContext *ctx, JSMapState *s)
+/* Remove the deleted records and resize the record array so that at
+   least half of it is free. The enumeration positions are updated, in
+   O(number of cursors * number of records) but there is rarely more
+   than one. */
+static int map_resize(JSContext *ctx, JSMapState *s)
 {
-    uint32_t new_hash_size, i, h;
-    size_t slack;
-    struct list_head *new_hash_table, *el;
-    JSMapRecord *mr;
-
-    /* XXX: no reporting of memory allocation failure */
-    if (s->hash_size == 1)
-        new_hash_size = 4;
-    else
-        new_hash_size = s->hash_size * 2;
-    new_hash_table = js_realloc2(ctx, s->hash_table,
-                                 sizeof(new_hash_table[0]) * new_hash_size, &slack);
-    if (!new_hash_table)
-        return;
-    new_hash_size += slack / sizeof(*new_hash_table);
+    uint32_t new_size, new_hash_size, i, j, n, mask;
+    uint32_t *hash_table;
+    JSMapRecord *records;
+    struct list_head *el;
+    JSMapCursor *c;
 
-    for(i = 0; i < new_hash_size; i++)
-        init_list_head(&new_hash_table[i]);
+    new_size = 4;
+    while (new_size < 2 * s->record_count) {
+        if (new_size >= (1U << 30)) {
+            JS_ThrowRangeError(ctx, "invalid map size");
+            return -1;
+        }
+        new_size *= 2;
+    }
+    new_hash_size = new_size * 2;
+    hash_table = js_mallocz(ctx, sizeof(hash_table[0]) * new_hash_size);
+    if (!hash_table)
+        return -1;
+    if (new_size > s->records_size) {
+        records = js_realloc(ctx, s->records,
+                             sizeof(records[0]) * new_size);
+        if (!records) {
+            js_free(ctx, hash_table);
+            return -1;
+        }
+        s->records = records;
+    }
 
-    list_for_each(el, &s->records) {
-        mr = list_entry(el, JSMapRecord, link);
-        if (!mr->empty) {
-            h = map_hash_key(ctx, mr->key) & (new_hash_size - 1);
-            list_add_tail(&mr->hash_link, &new_hash_table[h]);
+    if (s->record_count != s->records_len) {
+        list_for_each(el, &s->cursors) {
+            c = list_entry(el, JSMapCursor, link);
+            n = 0;
+            for(i = 0; i < min_uint32(c->pos, s->records_len); i++) {
+                if (!map_record_is_deleted(&s->records[i]))
+                    n++;
+            }
+            c->pos = n;
+        }
+        for(i = j = 0; i < s->records_len; i++) {
+            if (!map_record_is_deleted(&s->records[i]))
+                s->records[j++] = s->records[i];
         }
+        s->records_len = j;
     }
-    s->hash_table = new_hash_table;
+
+    if (new_size < s->records_size) {
+        /* if the shrink fails, the larger array is kept */
+        records = js_realloc(ctx, s->records,
+                             sizeof(records[0]) * new_size);
+        if (records)
+            s->records = records;
+    }
+
+    mask = new_hash_size - 1;
+    for(j = 0; j < s->records_len; j++) {
+        for(i = s->records[j].hash & mask; hash_table[i] != 0;
+            i = (i + 1) & mask)
+            continue;
+        hash_table[i] = j + 1;
+    }
+    js_free(ctx, s->hash_table);
+    s->hash_table = hash_table;
     s->hash_size = new_hash_size;
-    s->record_count_threshold = new_hash_size * 2;
+    s->records_size = new_size;
+    return 0;
 }
 
+/* 'h' is map_hash_key(ctx, key). The value of the record is undefined */
 static JSMapRecord *map_add_record(JSContext *ctx, JSMapState *s,
-                                   JSValueConst key)
+                                   JSValueConst key, uint32_t h)
 {
-    uint32_t h;
+    uint32_t i, mask;
     JSMapRecord *mr;
 
-    mr = js_malloc(ctx, sizeof(*mr));
-    if (!mr)
-        return NULL;
-    mr->ref_count = 1;
-    mr->map = s;
-    mr->empty = FALSE;
+    if (s->records_len >= s->records_size) {
+        if (map_resize(ctx, s))
+            return NULL;
+    }
     if (s->is_weak) {
         JSObject *p = JS_VALUE_GET_OBJ(key);
+        JSMapWeakRef *wr;
         /* Add the weak reference */
-        mr->next_weak_ref = p->first_weak_ref;
-        p->first_weak_ref = mr;
+        wr = js_malloc(ctx, sizeof(*wr));
+        if (!wr)
+            return NULL;
+        wr->map = s;
+        wr->value = JS_UNDEFINED;
+        wr->next = p->first_weak_ref;
+        p->first_weak_ref = wr;
     } else {
         JS_DupValue(ctx, key);
     }
+    mr = &s->records[s->records_len];
     mr->key = (JSValue)key;
-    h = map_hash_key(ctx, key) & (s->hash_size - 1);
-    list_add_tail(&mr->hash_link, &s->hash_table[h]);
-    list_add_tail(&mr->link, &s->records);
+    mr->value = JS_UNDEFINED;
+    mr->hash = h;
+    mask = s->hash_size - 1;
+    for(i = h & mask; s->hash_table[i] != 0; i = (i + 1) & mask)
+        continue;
+    s->hash_table[i] = ++s->records_len;
     s->record_count++;
-    if (s->record_count >= s->record_count_threshold) {
-        map_hash_resize(ctx, s);
-    }
     return mr;
 }
 
@@ -45737,77 +48671,77 @@ static JSMapRecord *map_add_record(JSContext *ctx, JSMapState *s,
    reference list. we don't use a doubly linked list to
    save space, assuming a given object has few weak
        references to it */
-static void delete_weak_ref(JSRuntime *rt, JSMapRecord *mr)
+static void delete_weak_ref(JSRuntime *rt, JSMapState *s, JSValueConst key)
 {
-    JSMapRecord **pmr, *mr1;
+    JSMapWeakRef **pwr, *wr;
     JSObject *p;
 
-    p = JS_VALUE_GET_OBJ(mr->key);
-    pmr = &p->first_weak_ref;
+    p = JS_VALUE_GET_OBJ(key);
+    pwr = &p->first_weak_ref;
     for(;;) {
-        mr1 = *pmr;
-        assert(mr1 != NULL);
-        if (mr1 == mr)
+        wr = *pwr;
+        assert(wr != NULL);
+        if (wr->map == s)
             break;
-        pmr = &mr1->next_weak_ref;
+        pwr = &wr->next;
     }
-    *pmr = mr1->next_weak_ref;
+    *pwr = wr->next;
+    js_free_rt(rt, wr);
 }
 
 static void map_delete_record(JSRuntime *rt, JSMapState *s, JSMapRecord *mr)
 {
-    if (mr->empty)
+    JSValue key, value;
+
+    if (map_record_is_deleted(mr))
         return;
-    list_del(&mr->hash_link);
+    key = mr->key;
+    value = mr->value;
+    /* the record stays in the hash table until the next resize */
+    mr->key = JS_UNINITIALIZED;
+    mr->value = JS_UNDEFINED;
+    s->record_count--;
     if (s->is_weak) {
-        delete_weak_ref(rt, mr);
-    } else {
-        JS_FreeValueRT(rt, mr->key);
-    }
-    JS_FreeValueRT(rt, mr->value);
-    if (--mr->ref_count == 0) {
-        list_del(&mr->link);
-        js_free_rt(rt, mr);
+        delete_weak_ref(rt, s, key);
     } else {
-        /* keep a zombie record for iterators */
-        mr->empty = TRUE;
-        mr->key = JS_UNDEFINED;
-        mr->value = JS_UNDEFINED;
-    }
-    s->record_count--;
-}
-
-static void map_decref_record(JSRuntime *rt, JSMapRecord *mr)
-{
-    if (--mr->ref_count == 0) {
-        /* the record can be safely removed */
-        assert(mr->empty);
-        list_del(&mr->link);
-        js_free_rt(rt, mr);
+        JS_FreeValueRT(rt, key);
     }
+    JS_FreeValueRT(rt, value);
 }
 
 static void reset_weak_ref(JSRuntime *rt, JSObject *p)
 {
-    JSMapRecord *mr, *mr_next;
+    JSMapWeakRef *wr, *wr_next;
     JSMapState *s;
+    JSMapRecord *mr;
+    uint32_t i, idx, mask, h;
 
     /* first pass to remove the records from the WeakMap/WeakSet
-       lists */
-    for(mr = p->first_weak_ref; mr != NULL; mr = mr->next_weak_ref) {
-        s = mr->map;
+       tables */
+    h = map_hash_key(NULL, JS_MKPTR(JS_TAG_OBJECT, p));
+    for(wr = p->first_weak_ref; wr != NULL; wr = wr->next) {
+        s = wr->map;
         assert(s->is_weak);
-        assert(!mr->empty); /* no iterator on WeakMap/WeakSet */
-        list_del(&mr->hash_link);
-        list_del(&mr->link);
+        mask = s->hash_size - 1;
+        for(i = h & mask;; i = (i + 1) & mask) {
+            idx = s->hash_table[i];
+            assert(idx != 0);
+            mr = &s->records[idx - 1];
+            if (!map_record_is_deleted(mr) && JS_VALUE_GET_OBJ(mr->key) == p)
+                break;
+        }
+        wr->value = mr->value;
+        mr->key = JS_UNINITIALIZED;
+        mr->value = JS_UNDEFINED;
+        s->record_count--;
     }
 
     /* second pass to free the values to avoid modifying the weak
        reference list while traversing it. */
-    for(mr = p->first_weak_ref; mr != NULL; mr = mr_next) {
-        mr_next = mr->next_weak_ref;
-        JS_FreeValueRT(rt, mr->value);
-        js_free_rt(rt, mr);
+    for(wr = p->first_weak_ref; wr != NULL; wr = wr_next) {
+        wr_next = wr->next;
+        JS_FreeValueRT(rt, wr->value);
+        js_free_rt(rt, wr);
     }
 
     p->first_weak_ref = NULL; /* fail safe */
@@ -45819,6 +48753,7 @@ static JSValue js_map_set(JSContext *ctx, JSValueConst this_val,
     JSMapState *s = JS_GetOpaque2(ctx, this_val, JS_CLASS_MAP + magic);
     JSMapRecord *mr;
     JSValueConst key, value;
+    uint32_t h;
 
     if (!s)
         return JS_EXCEPTION;
@@ -45829,11 +48764,12 @@ static JSValue js_map_set(JSContext *ctx, JSValueConst this_val,
         value = JS_UNDEFINED;
     else
         value = argv[1];
-    mr = map_find_record(ctx, s, key);
+    h = map_hash_key(ctx, key);
+    mr = map_find_record(ctx, s, key, h);
     if (mr) {
         JS_FreeValue(ctx, mr->value);
     } else {
-        mr = map_add_record(ctx, s, key);
+        mr = map_add_record(ctx, s, key, h);
         if (!mr)
             return JS_EXCEPTION;
     }
@@ -45851,7 +48787,7 @@ static JSValue js_map_get(JSContext *ctx, JSValueConst this_val,
     if (!s)
         return JS_EXCEPTION;
     key = map_normalize_key(ctx, argv[0]);
-    mr = map_find_record(ctx, s, key);
+    mr = map_find_record(ctx, s, key, map_hash_key(ctx, key));
     if (!mr)
         return JS_UNDEFINED;
     else
@@ -45868,7 +48804,7 @@ static JSValue js_map_has(JSContext *ctx, JSValueConst this_val,
     if (!s)
         return JS_EXCEPTION;
     key = map_normalize_key(ctx, argv[0]);
-    mr = map_find_record(ctx, s, key);
+    mr = map_find_record(ctx, s, key, map_hash_key(ctx, key));
     return JS_NewBool(ctx, (mr != NULL));
 }
 
@@ -45882,7 +48818,7 @@ static JSValue js_map_delete(JSContext *ctx, JSValueConst this_val,
     if (!s)
         return JS_EXCEPTION;
     key = map_normalize_key(ctx, argv[0]);
-    mr = map_find_record(ctx, s, key);
+    mr = map_find_record(ctx, s, key, map_hash_key(ctx, key));
     if (!mr)
         return JS_FALSE;
     map_delete_record(ctx->rt, s, mr);
@@ -45893,14 +48829,26 @@ static JSValue js_map_clear(JSContext *ctx, JSValueConst this_val,
                             int argc, JSValueConst *argv, int magic)
 {
     JSMapState *s = JS_GetOpaque2(ctx, this_val, JS_CLASS_MAP + magic);
-    struct list_head *el, *el1;
-    JSMapRecord *mr;
+    struct list_head *el;
+    JSMapCursor *c;
+    uint32_t i;
 
     if (!s)
         return JS_EXCEPTION;
-    list_for_each_safe(el, el1, &s->records) {
-        mr = list_entry(el, JSMapRecord, link);
-        map_delete_record(ctx->rt, s, mr);
+    /* no resize can happen while the records are deleted */
+    for(i = 0; i < s->records_len; i++) {
+        map_delete_record(ctx->rt, s, &s->records[i]);
+    }
+    js_free(ctx, s->records);
+    js_free(ctx, s->hash_table);
+    s->records = NULL;
+    s->hash_table = NULL;
+    s->records_len = 0;
+    s->records_size = 0;
+    s->hash_size = 0;
+    list_for_each(el, &s->cursors) {
+        c = list_entry(el, JSMapCursor, link);
+        c->pos = 0;
     }
     return JS_UNDEFINED;
 }
@@ -45919,7 +48867,7 @@ static JSValue js_map_forEach(JSContext *ctx, JSValueConst this_val,
     JSMapState *s = JS_GetOpaque2(ctx, this_val, JS_CLASS_MAP + magic);
     JSValueConst func, this_arg;
     JSValue ret, args[3];
-    struct list_head *el;
+    JSMapCursor cursor;
     JSMapRecord *mr;
 
     if (!s)
@@ -45931,33 +48879,32 @@ static JSValue js_map_forEach(JSContext *ctx, JSValueConst this_val,
         this_arg = JS_UNDEFINED;
     if (check_function(ctx, func))
         return JS_EXCEPTION;
-    /* Note: the list can be modified while traversing it, but the
-       current element is locked */
-    el = s->records.next;
-    while (el != &s->records) {
-        mr = list_entry(el, JSMapRecord, link);
-        if (!mr->empty) {
-            mr->ref_count++;
-            /* must duplicate in case the record is deleted */
-            args[1] = JS_DupValue(ctx, mr->key);
-            if (magic)
-                args[0] = args[1];
-            else
-                args[0] = JS_DupValue(ctx, mr->value);
-            args[2] = (JSValue)this_val;
-            ret = JS_Call(ctx, func, this_arg, 3, (JSValueConst *)args);
-            JS_FreeValue(ctx, args[0]);
-            if (!magic)
-                JS_FreeValue(ctx, args[1]);
-            el = el->next;
-            map_decref_record(ctx->rt, mr);
-            if (JS_IsException(ret))
-                return ret;
-            JS_FreeValue(ctx, ret);
-        } else {
-            el = el->next;
+    /* Note: the map can be modified by the callback, the cursor
+       position is updated if the records are moved */
+    cursor.pos = 0;
+    list_add_tail(&cursor.link, &s->cursors);
+    while (cursor.pos < s->records_len) {
+        mr = &s->records[cursor.pos++];
+        if (map_record_is_deleted(mr))
+            continue;
+        /* must duplicate in case the record is deleted */
+        args[1] = JS_DupValue(ctx, mr->key);
+        if (magic)
+            args[0] = args[1];
+        else
+            args[0] = JS_DupValue(ctx, mr->value);
+        args[2] = (JSValue)this_val;
+        ret = JS_Call(ctx, func, this_arg, 3, (JSValueConst *)args);
+        JS_FreeValue(ctx, args[0]);
+        if (!magic)
+            JS_FreeValue(ctx, args[1]);
+        if (JS_IsException(ret)) {
+            list_del(&cursor.link);
+            return ret;
         }
+        JS_FreeValue(ctx, ret);
     }
+    list_del(&cursor.link);
     return JS_UNDEFINED;
 }
 
@@ -45965,25 +48912,25 @@ static void js_map_finalizer(JSRuntime *rt, JSValue val)
 {
     JSObject *p;
     JSMapState *s;
-    struct list_head *el, *el1;
     JSMapRecord *mr;
+    uint32_t i;
 
     p = JS_VALUE_GET_OBJ(val);
     s = p->u.map_state;
     if (s) {
         /* if the object is deleted we are sure that no iterator is
            using it */
-        list_for_each_safe(el, el1, &s->records) {
-            mr = list_entry(el, JSMapRecord, link);
-            if (!mr->empty) {
+        for(i = 0; i < s->records_len; i++) {
+            mr = &s->records[i];
+            if (!map_record_is_deleted(mr)) {
                 if (s->is_weak)
-                    delete_weak_ref(rt, mr);
+                    delete_weak_ref(rt, s, mr->key);
                 else
                     JS_FreeValueRT(rt, mr->key);
                 JS_FreeValueRT(rt, mr->value);
             }
-            js_free_rt(rt, mr);
         }
+        js_free_rt(rt, s->records);
         js_free_rt(rt, s->hash_table);
         js_free_rt(rt, s);
     }
@@ -45993,13 +48940,13 @@ static void js_map_mark(JSRuntime *rt, JSValueConst val, JS_MarkFunc *mark_func)
 {
     JSObject *p = JS_VALUE_GET_OBJ(val);
     JSMapState *s;
-    struct list_head *el;
     JSMapRecord *mr;
+    uint32_t i;
 
     s = p->u.map_state;
     if (s) {
-        list_for_each(el, &s->records) {
-            mr = list_entry(el, JSMapRecord, link);
+        for(i = 0; i < s->records_len; i++) {
+            mr = &s->records[i];
             if (!s->is_weak)
                 JS_MarkValue(rt, mr->key, mark_func);
             JS_MarkValue(rt, mr->value, mark_func);
@@ -46012,7 +48959,7 @@ static void js_map_mark(JSRuntime *rt, JSValueConst val, JS_MarkFunc *mark_func)
 typedef struct JSMapIteratorData {
     JSValue obj;
     JSIteratorKindEnum kind;
-    JSMapRecord *cur_record;
+    JSMapCursor cursor; /* in the cursor list of 'obj' if it is defined */
 } JSMapIteratorData;
 
 static void js_map_iterator_finalizer(JSRuntime *rt, JSValue val)
@@ -46025,8 +48972,8 @@ static void js_map_iterator_finalizer(JSRuntime *rt, JSValue val)
     if (it) {
         /* During the GC sweep phase the Map finalizer may be
            called before the Map iterator finalizer */
-        if (JS_IsLiveObject(rt, it->obj) && it->cur_record) {
-            map_decref_record(rt, it->cur_record);
+        if (JS_IsLiveObject(rt, it->obj)) {
+            list_del(&it->cursor.link);
         }
         JS_FreeValueRT(rt, it->obj);
         js_free_rt(rt, it);
@@ -46040,7 +48987,6 @@ static void js_map_iterator_mark(JSRuntime *rt, JSValueConst val,
     JSMapIteratorData *it;
     it = p->u.map_iterator_data;
     if (it) {
-        /* the record is already marked by the object */
         JS_MarkValue(rt, it->obj, mark_func);
     }
 }
@@ -46068,7 +49014,8 @@ static JSValue js_create_map_iterator(JSContext *ctx, JSValueConst this_val,
     }
     it->obj = JS_DupValue(ctx, this_val);
     it->kind = kind;
-    it->cur_record = NULL;
+    it->cursor.pos = 0;
+    list_add_tail(&it->cursor.link, &s->cursors);
     JS_SetOpaque(enum_obj, it);
     return enum_obj;
  fail:
@@ -46082,7 +49029,6 @@ static JSValue js_map_iterator_next(JSContext *ctx, JSValueConst this_val,
     JSMapIteratorData *it;
     JSMapState *s;
     JSMapRecord *mr;
-    struct list_head *el;
 
     it = JS_GetOpaque2(ctx, this_val, JS_CLASS_MAP_ITERATOR + magic);
     if (!it) {
@@ -46093,17 +49039,10 @@ static JSValue js_map_iterator_next(JSContext *ctx, JSValueConst this_val,
         goto done;
     s = JS_GetOpaque(it->obj, JS_CLASS_MAP + magic);
     assert(s != NULL);
-    if (!it->cur_record) {
-        el = s->records.next;
-    } else {
-        mr = it->cur_record;
-        el = mr->link.next;
-        map_decref_record(ctx->rt, mr); /* the record can be freed here */
-    }
     for(;;) {
-        if (el == &s->records) {
+        if (it->cursor.pos >= s->records_len) {
             /* no more record  */
-            it->cur_record = NULL;
+            list_del(&it->cursor.link);
             JS_FreeValue(ctx, it->obj);
             it->obj = JS_UNDEFINED;
         done:
@@ -46111,16 +49050,11 @@ static JSValue js_map_iterator_next(JSContext *ctx, JSValueConst this_val,
             *pdone = TRUE;
             return JS_UNDEFINED;
         }
-        mr = list_entry(el, JSMapRecord, link);
-        if (!mr->empty)
+        mr = &s->records[it->cursor.pos++];
+        if (!map_record_is_deleted(mr))
             break;
-        /* get the next record */
-        el = mr->link.next;
     }
 
-    /* lock the record so that it won't be freed */
-    mr->ref_count++;
-    it->cur_record = mr;
     *pdone = FALSE;
 
     if (it->kind == JS_ITERATOR_KIND_KEY) {
@@ -47080,6 +50014,30 @@ static __exception int perform_promise_then(JSContext *ctx,
     JSPromiseReactionData *rd_array[2], *rd;
     int i, j;
 
+    if (s->promise_state != JS_PROMISE_PENDING) {
+        /* the reaction job is enqueued without allocating the
+           reaction records */
+        JSValueConst args[5], handler;
+        if (s->promise_state == JS_PROMISE_REJECTED && !s->is_handled) {
+            JSRuntime *rt = ctx->rt;
+            if (rt->host_promise_rejection_tracker) {
+                rt->host_promise_rejection_tracker(ctx, promise, s->promise_result,
+                                                   TRUE, rt->host_promise_rejection_tracker_opaque);
+            }
+        }
+        i = s->promise_state - JS_PROMISE_FULFILLED;
+        handler = resolve_reject[i];
+        if (!JS_IsFunction(ctx, handler))
+            handler = JS_UNDEFINED;
+        args[0] = cap_resolving_funcs[0];
+        args[1] = cap_resolving_funcs[1];
+        args[2] = handler;
+        args[3] = JS_NewBool(ctx, i);
+        args[4] = s->promise_result;
+        s->is_handled = TRUE;
+        return JS_EnqueueJob(ctx, promise_reaction_job, 5, args);
+    }
+
     rd_array[0] = NULL;
     rd_array[1] = NULL;
     for(i = 0; i < 2; i++) {
@@ -47099,29 +50057,8 @@ static __exception int perform_promise_then(JSContext *ctx,
         rd_array[i] = rd;
     }
 
-    if (s->promise_state == JS_PROMISE_PENDING) {
-        for(i = 0; i < 2; i++)
-            list_add_tail(&rd_array[i]->link, &s->promise_reactions[i]);
-    } else {
-        JSValueConst args[5];
-        if (s->promise_state == JS_PROMISE_REJECTED && !s->is_handled) {
-            JSRuntime *rt = ctx->rt;
-            if (rt->host_promise_rejection_tracker) {
-                rt->host_promise_rejection_tracker(ctx, promise, s->promise_result,
-                                                   TRUE, rt->host_promise_rejection_tracker_opaque);
-            }
-        }
-        i = s->promise_state - JS_PROMISE_FULFILLED;
-        rd = rd_array[i];
-        args[0] = rd->resolving_funcs[0];
-        args[1] = rd->resolving_funcs[1];
-        args[2] = rd->handler;
-        args[3] = JS_NewBool(ctx, i);
-        args[4] = s->promise_result;
-        JS_EnqueueJob(ctx, promise_reaction_job, 5, args);
-        for(i = 0; i < 2; i++)
-            promise_reaction_data_free(ctx->rt, rd_array[i]);
-    }
+    for(i = 0; i < 2; i++)
+        list_add_tail(&rd_array[i]->link, &s->promise_reactions[i]);
     s->is_handled = TRUE;
     return 0;
 }
@@ -49124,6 +52061,7 @@ static JSValue JS_ToBigIntCtorFree(JSContext *ctx, JSValue val)
         val = JS_NewBigInt64(ctx, JS_VALUE_GET_INT(val));
         break;
     case JS_TAG_BIG_INT:
+    case JS_TAG_SHORT_BIG_INT:
         break;
     case JS_TAG_FLOAT64:
     case JS_TAG_BIG_FLOAT:
@@ -49696,9 +52634,14 @@ static JSValue js_bigfloat_constructor(JSContext *ctx,
             }
             break;
         case JS_TAG_INT:
+        case JS_TAG_SHORT_BIG_INT:
             {
                 bf_t *r;
-                int32_t v = JS_VALUE_GET_INT(val);
+                int64_t v;
+                if (JS_VALUE_GET_TAG(val) == JS_TAG_INT)
+                    v = JS_VALUE_GET_INT(val);
+                else
+                    v = JS_VALUE_GET_SHORT_BIG_INT(val);
                 val = JS_NewBigFloat(ctx);
                 if (JS_IsException(val))
                     break;
@@ -50392,6 +53335,7 @@ static JSValue JS_ToBigDecimalFree(JSContext *ctx, JSValue val,
         break;
     case JS_TAG_FLOAT64:
     case JS_TAG_BIG_INT:
+    case JS_TAG_SHORT_BIG_INT:
     case JS_TAG_BIG_FLOAT:
         val = JS_ToStringFree(ctx, val);
         if (JS_IsException(val))
@@ -50896,7 +53840,7 @@ static void JS_AddIntrinsicBasicObjects(JSContext *ctx)
                                JS_CLASS_ARRAY);
 
     ctx->array_shape = js_new_shape2(ctx, get_proto_obj(ctx->class_proto[JS_CLASS_ARRAY]),
-                                     JS_PROP_INITIAL_HASH_SIZE, 1);
+                                     1);
     add_shape_property(ctx, &ctx->array_shape, NULL,
                        JS_ATOM_length, JS_PROP_WRITABLE | JS_PROP_LENGTH);
 
@@ -50931,6 +53875,8 @@ void JS_AddIntrinsicBaseObjects(JSContext *ctx)
 
     ctx->global_obj = JS_NewObject(ctx);
     ctx->global_var_obj = JS_NewObjectProto(ctx, JS_NULL);
+    js_shape_set_global(ctx, ctx->global_obj);
+    js_shape_set_global(ctx, ctx->global_var_obj);
 
     /* Object */
     obj = JS_NewGlobalCConstructor(ctx, "Object", js_object_constructor, 1,
@@ -52157,6 +55103,17 @@ static JSValue js_typed_array_indexOf(JSContext *ctx, JSValueConst this_val,
         is_int = (v64 == d);
     } else
 #ifdef CONFIG_BIGNUM
+    if (tag == JS_TAG_SHORT_BIG_INT) {
+        v64 = JS_VALUE_GET_SHORT_BIG_INT(argv[0]);
+        if (p->class_id == JS_CLASS_BIG_UINT64_ARRAY) {
+            if (v64 < 0)
+                goto done;
+        } else if (p->class_id != JS_CLASS_BIG_INT64_ARRAY) {
+            goto done;
+        }
+        d = 0;
+        is_bigint = 1;
+    } else
     if (tag == JS_TAG_BIG_INT) {
         JSBigFloat *p1 = JS_VALUE_GET_PTR(argv[0]);
 
@@ -52659,6 +55616,176 @@ static JSValue js_TA_get_float64(JSContext *ctx, const void *a) {
     return __JS_NewFloat64(ctx, *(const double *)a);
 }
 
+/* Radix sort of the typed arrays without comparison function: the
+   values are converted in place to unsigned keys having the same order,
+   sorted with a LSD radix sort on their bytes, and converted back. */
+
+#define TA_RADIX_SORT_MIN_LEN 256
+
+#define DEF_TA_RADIX_SORT(name, type)                                   \
+static void name(type *a, type *tmp, size_t len)                        \
+{                                                                       \
+    size_t count[sizeof(type)][256], i, j, k, sum, c;                   \
+    type *src, *dst, *t;                                                \
+                                                                        \
+    memset(count, 0, sizeof(count));                                    \
+    for(i = 0; i < len; i++) {                                          \
+        for(k = 0; k < sizeof(type); k++)                               \
+            count[k][(a[i] >> (8 * k)) & 0xff]++;                       \
+    }                                                                   \
+    src = a;                                                            \
+    dst = tmp;                                                          \
+    for(k = 0; k < sizeof(type); k++) {                                 \
+        /* skip the byte if it is the same in all the keys */           \
+        if (count[k][(a[0] >> (8 * k)) & 0xff] == len)                  \
+            continue;                                                   \
+        sum = 0;                                                        \
+        for(j = 0; j < 256; j++) {                                      \
+            c = count[k][j];                                            \
+            count[k][j] = sum;                                          \
+            sum += c;                                                   \
+        }                                                               \
+        for(i = 0; i < len; i++)                                        \
+            dst[count[k][(src[i] >> (8 * k)) & 0xff]++] = src[i];       \
+        t = src;                                                        \
+        src = dst;                                                      \
+        dst = t;                                                        \
+    }                                                                   \
+    if (src != a)                                                       \
+        memcpy(a, src, len * sizeof(type));                             \
+}
+
+DEF_TA_RADIX_SORT(js_TA_radix_sort16, uint16_t)
+DEF_TA_RADIX_SORT(js_TA_radix_sort32, uint32_t)
+DEF_TA_RADIX_SORT(js_TA_radix_sort64, uint64_t)
+
+/* return -1 if exception */
+static int js_TA_radix_sort(JSContext *ctx, void *array_ptr, size_t len,
+                            int class_id)
+{
+    size_t i, count[256];
+    void *tmp;
+
+    switch(class_id) {
+    case JS_CLASS_INT8_ARRAY:
+    case JS_CLASS_UINT8C_ARRAY:
+    case JS_CLASS_UINT8_ARRAY:
+        {
+            uint8_t *a = array_ptr, flip;
+            /* counting sort */
+            flip = (class_id == JS_CLASS_INT8_ARRAY) ? 0x80 : 0;
+            memset(count, 0, sizeof(count));
+            for(i = 0; i < len; i++)
+                count[a[i] ^ flip]++;
+            for(i = 0; i < 256; i++) {
+                memset(a, i ^ flip, count[i]);
+                a += count[i];
+            }
+        }
+        return 0;
+    default:
+        break;
+    }
+
+    tmp = js_malloc(ctx, len << typed_array_size_log2(class_id));
+    if (!tmp)
+        return -1;
+    switch(class_id) {
+    case JS_CLASS_INT16_ARRAY:
+    case JS_CLASS_UINT16_ARRAY:
+        {
+            uint16_t *a = array_ptr, flip;
+            flip = (class_id == JS_CLASS_INT16_ARRAY) ? 0x8000 : 0;
+            for(i = 0; i < len; i++)
+                a[i] ^= flip;
+            js_TA_radix_sort16(a, tmp, len);
+            for(i = 0; i < len; i++)
+                a[i] ^= flip;
+        }
+        break;
+    case JS_CLASS_INT32_ARRAY:
+    case JS_CLASS_UINT32_ARRAY:
+        {
+            uint32_t *a = array_ptr, flip;
+            flip = (class_id == JS_CLASS_INT32_ARRAY) ? 0x80000000 : 0;
+            for(i = 0; i < len; i++)
+                a[i] ^= flip;
+            js_TA_radix_sort32(a, tmp, len);
+            for(i = 0; i < len; i++)
+                a[i] ^= flip;
+        }
+        break;
+#ifdef CONFIG_BIGNUM
+    case JS_CLASS_BIG_INT64_ARRAY:
+    case JS_CLASS_BIG_UINT64_ARRAY:
+        {
+            uint64_t *a = array_ptr, flip;
+            flip = (class_id == JS_CLASS_BIG_INT64_ARRAY) ? (1ULL << 63) : 0;
+            for(i = 0; i < len; i++)
+                a[i] ^= flip;
+            js_TA_radix_sort64(a, tmp, len);
+            for(i = 0; i < len; i++)
+                a[i] ^= flip;
+        }
+        break;
+#endif
+    case JS_CLASS_FLOAT32_ARRAY:
+        {
+            uint32_t *a = array_ptr, v;
+            /* -0 is before +0 and the NaNs are at the end */
+            for(i = 0; i < len; i++) {
+                v = a[i];
+                if ((v & 0x7fffffff) > 0x7f800000)
+                    v = 0xffffffff;
+                else if (v & 0x80000000)
+                    v = ~v;
+                else
+                    v |= 0x80000000;
+                a[i] = v;
+            }
+            js_TA_radix_sort32(a, tmp, len);
+            for(i = 0; i < len; i++) {
+                v = a[i];
+                if (v & 0x80000000)
+                    v &= 0x7fffffff;
+                else
+                    v = ~v;
+                a[i] = v;
+            }
+        }
+        break;
+    case JS_CLASS_FLOAT64_ARRAY:
+        {
+            uint64_t *a = array_ptr, v;
+            const uint64_t sign = 1ULL << 63;
+            for(i = 0; i < len; i++) {
+                v = a[i];
+                if ((v & ~sign) > 0x7ff0000000000000)
+                    v = UINT64_MAX;
+                else if (v & sign)
+                    v = ~v;
+                else
+                    v |= sign;
+                a[i] = v;
+            }
+            js_TA_radix_sort64(a, tmp, len);
+            for(i = 0; i < len; i++) {
+                v = a[i];
+                if (v & sign)
+                    v &= ~sign;
+                else
+                    v = ~v;
+                a[i] = v;
+            }
+        }
+        break;
+    default:
+        abort();
+    }
+    js_free(ctx, tmp);
+    return 0;
+}
+
 struct TA_sort_context {
     JSContext *ctx;
     int exception;
@@ -52702,10 +55829,6 @@ static int js_TA_cmp_generic(const void *a, const void *b, void *opaque) {
                 cmp = (val > 0) - (val < 0);
             }
         }
-        if (cmp == 0) {
-            /* make sort stable: compare array offsets */
-            cmp = (a_idx > b_idx) - (a_idx < b_idx);
-        }
         if (validate_typed_array(ctx, psc->arr) < 0) {
             psc->exception = 1;
         }
@@ -52793,16 +55916,17 @@ static JSValue js_typed_array_sort(JSContext *ctx, JSValueConst this_val,
             void *array_tmp;
             size_t i, j;
 
-            /* XXX: a stable sort would use less memory */
-            array_idx = js_malloc(ctx, len * sizeof(array_idx[0]));
+            /* the comparison function may modify the array, so the
+               indexes are sorted */
+            array_idx = js_malloc(ctx, (len + len / 2) * sizeof(array_idx[0]));
             if (!array_idx)
                 return JS_EXCEPTION;
             for(i = 0; i < len; i++)
                 array_idx[i] = i;
             tsc.array_ptr = array_ptr;
             tsc.elt_size = elt_size;
-            rqsort(array_idx, len, sizeof(array_idx[0]),
-                   js_TA_cmp_generic, &tsc);
+            rmsort(array_idx, len, sizeof(array_idx[0]),
+                   js_TA_cmp_generic, &tsc, array_idx + len);
             if (tsc.exception)
                 goto fail;
             array_tmp = js_malloc(ctx, len * elt_size);
@@ -52842,6 +55966,9 @@ static JSValue js_typed_array_sort(JSContext *ctx, JSValueConst this_val,
             }
             js_free(ctx, array_tmp);
             js_free(ctx, array_idx);
+        } else if (len >= TA_RADIX_SORT_MIN_LEN) {
+            if (js_TA_radix_sort(ctx, array_ptr, len, p->class_id))
+                return JS_EXCEPTION;
         } else {
             rqsort(array_ptr, len, elt_size, cmpfun, &tsc);
             if (tsc.exception)
@@ -54100,6 +57227,41 @@ void *JS_GetJSModuleDefMetaComponent(JSModuleDef *m)
     return m->metaComponent;
 }
 
+/* same as JS_SetPropertyFunctionList() but the property names are
+   already interned: atoms[i] is the name of tab[i] */
+void JS_SetPropertyFunctionListAtoms(JSContext *ctx, JSValueConst obj,
+                                     const JSAtom *atoms,
+                                     const JSCFunctionListEntry *tab, int len)
+{
+    int i;
+
+    for (i = 0; i < len; i++)
+        JS_InstantiateFunctionListItem(ctx, obj, atoms[i], &tab[i]);
+}
+
+/* find the loaded COMO module named 'module_name'. Return -1 if an
+   exception is raised, otherwise 0 with the module or NULL in *pm */
+int JS_FindComoModule(JSContext *ctx, const char *module_name,
+                      JSModuleDef **pm)
+{
+    struct list_head *el;
+    JSAtom name;
+
+    *pm = NULL;
+    name = JS_NewAtom(ctx, module_name);
+    if (name == JS_ATOM_NULL)
+        return -1;
+    list_for_each(el, &ctx->loaded_modules) {
+        JSModuleDef *m = list_entry(el, JSModuleDef, link);
+        if (m->metaComponent != NULL && m->module_name == name) {
+            *pm = m;
+            break;
+        }
+    }
+    JS_FreeAtom(ctx, name);
+    return 0;
+}
+
 int JS_FindComoClass(JSContext *ctx, const char *className)
 {
     int js_findComoClass(void *metaComponent_, const char *className);
@@ -83,7 +83,8 @@ enum {
     JS_TAG_UNINITIALIZED = 4,
     JS_TAG_CATCH_OFFSET = 5,
     JS_TAG_EXCEPTION   = 6,
-    JS_TAG_FLOAT64     = 7,
+    JS_TAG_SHORT_BIG_INT = 7, /* BigInt which fits in JS_SHORT_BIG_INT_BITS */
+    JS_TAG_FLOAT64     = 8,
     /* any larger tag is FLOAT64 if JS_NAN_BOXING */
 };
 
@@ -113,6 +114,9 @@ typedef const struct __JSValue *JSValueConst;
 #define JS_MKVAL(tag, val) (JSValue)(intptr_t)(((val) << 4) | (tag))
 #define JS_MKPTR(tag, p) (JSValue)((intptr_t)(p) | (tag))
 
+#define JS_SHORT_BIG_INT_BITS 32
+#define JS_VALUE_GET_SHORT_BIG_INT(v) JS_VALUE_GET_INT(v)
+
 #define JS_TAG_IS_FLOAT64(tag) ((unsigned)(tag) == JS_TAG_FLOAT64)
 
 #define JS_NAN JS_MKVAL(JS_TAG_FLOAT64, 1)
@@ -141,6 +145,9 @@ typedef uint64_t JSValue;
 #define JS_MKVAL(tag, val) (((uint64_t)(tag) << 32) | (uint32_t)(val))
 #define JS_MKPTR(tag, ptr) (((uint64_t)(tag) << 32) | (uintptr_t)(ptr))
 
+#define JS_SHORT_BIG_INT_BITS 32
+#define JS_VALUE_GET_SHORT_BIG_INT(v) JS_VALUE_GET_INT(v)
+
 #define JS_FLOAT64_TAG_ADDEND (0x7ff80000 - JS_TAG_FIRST + 1) /* quiet NaN encoding */
 
 static inline double JS_VALUE_GET_FLOAT64(JSValue v)
@@ -198,6 +205,7 @@ typedef union JSValueUnion {
     int32_t int32;
     double float64;
     void *ptr;
+    int64_t short_big_int;
 } JSValueUnion;
 
 typedef struct JSValue {
@@ -218,6 +226,9 @@ typedef struct JSValue {
 #define JS_MKVAL(tag, val) (JSValue){ (JSValueUnion){ .int32 = val }, tag }
 #define JS_MKPTR(tag, p) (JSValue){ (JSValueUnion){ .ptr = p }, tag }
 
+#define JS_SHORT_BIG_INT_BITS 64
+#define JS_VALUE_GET_SHORT_BIG_INT(v) ((v).u.short_big_int)
+
 #define JS_TAG_IS_FLOAT64(tag) ((unsigned)(tag) == JS_TAG_FLOAT64)
 
 #define JS_NAN (JSValue){ .u.float64 = JS_FLOAT64_NAN, JS_TAG_FLOAT64 }
@@ -333,6 +344,12 @@ JSRuntime *JS_NewRuntime(void);
 void JS_SetRuntimeInfo(JSRuntime *rt, const char *info);
 void JS_SetMemoryLimit(JSRuntime *rt, size_t limit);
 void JS_SetGCThreshold(JSRuntime *rt, size_t gc_threshold);
+/* number of GC object allocations between two collections of the
+   recently allocated objects, 0 to disable them */
+void JS_SetGCYoungThreshold(JSRuntime *rt, int count);
+/* account for memory held by JS objects outside of the JS allocator so
+   that it is taken into account by the GC trigger */
+void JS_AdjustExternalMemory(JSRuntime *rt, int64_t delta);
 /* use 0 to disable maximum stack size check */
 void JS_SetMaxStackSize(JSRuntime *rt, size_t stack_size);
 /* should be called when changing thread to update the stack top value
@@ -410,6 +427,11 @@ typedef struct JSMemoryUsage {
     int64_t c_func_count, array_count;
     int64_t fast_array_count, fast_array_elements;
     int64_t binary_object_count, binary_object_size;
+    int64_t external_memory_size;
+    int64_t gc_count, gc_young_count;
+    /* GC pauses in microseconds. The percentiles are computed over the
+       last collections. */
+    int64_t gc_pause_p50, gc_pause_p90, gc_pause_p99, gc_pause_max;
 } JSMemoryUsage;
 
 void JS_ComputeMemoryUsage(JSRuntime *rt, JSMemoryUsage *s);
@@ -572,7 +594,7 @@ static inline JS_BOOL JS_IsNumber(JSValueConst v)
 static inline JS_BOOL JS_IsBigInt(JSContext *ctx, JSValueConst v)
 {
     int tag = JS_VALUE_GET_TAG(v);
-    return tag == JS_TAG_BIG_INT;
+    return tag == JS_TAG_BIG_INT || tag == JS_TAG_SHORT_BIG_INT;
 }
 
 static inline JS_BOOL JS_IsBigFloat(JSValueConst v)
@@ -873,6 +895,9 @@ int JS_EnqueueJob(JSContext *ctx, JSJobFunc *job_func, int argc, JSValueConst *a
 
 JS_BOOL JS_IsJobPending(JSRuntime *rt);
 int JS_ExecutePendingJob(JSRuntime *rt, JSContext **pctx);
+/* execute at most 'max_jobs' jobs (all if < 0). Return the number of
+   executed jobs or < 0 if exception */
+int JS_ExecutePendingJobs(JSRuntime *rt, int max_jobs, JSContext **pctx);
 
 /* Object Writer/Reader (currently only used to handle precompiled code) */
 #define JS_WRITE_OBJ_BYTECODE  (1 << 0) /* allow function/module */
@@ -21,8 +21,58 @@
 
 extern "C" int JS_FindComoClass(JSContext *ctx, const char *className);
 
+// ComoArena
+///////////////////////////////
+ComoArena::~ComoArena()
+{
+    for (size_t i = 0;  i < blocks.size();  i++)
+        free(blocks[i]);
+}
+
+void *ComoArena::Alloc(size_t size)
+{
+    // keep the returned blocks aligned for JSCFunctionListEntry
+    size = (size + sizeof(double) - 1) & ~(sizeof(double) - 1);
+    if (size > left) {
+        size_t blockSize = (size > BLOCK_SIZE) ? size : BLOCK_SIZE;
+        char *block = (char *)malloc(blockSize);
+        if (block == nullptr)
+            return nullptr;
+        blocks.push_back(block);
+        cur = block;
+        left = blockSize;
+    }
+    void *ptr = cur;
+    cur += size;
+    left -= size;
+    return ptr;
+}
+
+char *ComoArena::StrDup(const char *str)
+{
+    size_t len = strlen(str) + 1;
+    char *ptr = (char *)Alloc(len);
+    if (ptr != nullptr)
+        memcpy(ptr, str, len);
+    return ptr;
+}
+
 // MetaComponent
 ///////////////////////////////
+MetaComponent::~MetaComponent()
+{
+    Logger::V("como_quickjs", "delete MetaComponent object");
+
+    for (size_t i = 0;  i < como_classes.size();  i++) {
+        std::vector<JSAtom> &atoms = como_classes[i]->methodAtoms;
+        for (size_t j = 0;  j < atoms.size();  j++)
+            JS_FreeAtom(ctx, atoms[j]);
+        atoms.clear();
+    }
+
+    delete previous;
+}
+
 std::string MetaComponent::GetName()
 {
     String str;
@@ -112,6 +162,66 @@ void MetaCoclass::GetMethodName(int idxMethod, char *buf)
     strncpy(buf, str.string(), MAX_METHOD_NAME_LENGTH-1);
 }
 
+void MetaCoclass::GetDirectInvokers()
+{
+    directInvokers.assign(methodNumber, nullptr);
+
+    Integer interfaceNumber;
+    metaCoclass->GetInterfaceNumber(interfaceNumber);
+    Array<IMetaInterface*> interfaces(interfaceNumber);
+    metaCoclass->GetAllInterfaces(interfaces);
+    for (Integer i = 0;  i < interfaces.GetLength();  i++) {
+        InterfaceID iid;
+        interfaces[i]->GetInterfaceID(iid);
+
+        Integer number;
+        interfaces[i]->GetMethodNumber(number);
+        Array<IMetaMethod*> itfMethods(number);
+        interfaces[i]->GetAllMethods(itfMethods);
+        for (Integer j = 0;  j < number;  j++) {
+            String name, signature;
+            itfMethods[j]->GetName(name);
+            itfMethods[j]->GetSignature(signature);
+
+            ComoDirectInvoker invoker = ComoFindDirectMethod(iid,
+                                    std::string(name.string()),
+                                    std::string(signature.string()));
+            if (invoker == nullptr)
+                continue;
+
+            for (Integer k = 0;  k < methodNumber;  k++) {
+                if (directInvokers[k] != nullptr)
+                    continue;
+
+                String name_, signature_;
+                methods[k]->GetName(name_);
+                methods[k]->GetSignature(signature_);
+                if (name_.Equals(name) && signature_.Equals(signature))
+                    directInvokers[k] = invoker;
+            }
+        }
+    }
+}
+
+// true when both coclasses have the same method table, so that the
+// prototype of one can be used for the objects of the other
+bool MetaCoclass::SameMethods(MetaCoclass *other)
+{
+    if (methodNumber != other->methodNumber)
+        return false;
+
+    for (Integer i = 0;  i < methodNumber;  i++) {
+        String name, signature, otherName, otherSignature;
+        methods[i]->GetName(name);
+        methods[i]->GetSignature(signature);
+        other->methods[i]->GetName(otherName);
+        other->methods[i]->GetSignature(otherSignature);
+        if (!name.Equals(otherName) || !signature.Equals(otherSignature))
+            return false;
+    }
+    return true;
+}
+
 AutoPtr<IInterface> MetaCoclass::CreateObject()
 {
     AutoPtr<IInterface> object(nullptr);
@@ -122,6 +232,23 @@ AutoPtr<IInterface> MetaCoclass::CreateObject()
     return object;
 }
 
+Long MetaCoclass::GetNativeMemorySize(ComoJsObjectStub *stub)
+{
+    if ((idxNativeMemorySize < 0) || (stub->thisObject == nullptr))
+        return 0;
+
+    int64_t size;
+    JSValue val = stub->methodimpl(methods[idxNativeMemorySize], 0, nullptr, false);
+    int ret = JS_ToInt64(ctx, &size, val);
+    JS_FreeValue(ctx, val);
+    if (ret) {
+        // the accounting is only a hint, don't fail the construction
+        JS_FreeValue(ctx, JS_GetException(ctx));
+        return 0;
+    }
+    return (size < 0) ? 0 : size;
+}
+
 void MetaCoclass::constructObj(ComoJsObjectStub* stub, int argc, JSValueConst *argv)
 {
     if ((argc > 1) && JS_IsString(argv[0])) {
@@ -164,12 +291,16 @@ void MetaCoclass::constructObj(ComoJsObjectStub* stub, int argc, JSValueConst *a
 ComoJsObjectStub::ComoJsObjectStub(JSContext *ctx_, MetaCoclass *mCoclass)
     : ctx(ctx_)
     , thisObject(nullptr),
+    externalMemorySize(0),
+    metaCoclass(mCoclass),
     methods(mCoclass->methods)
 {}
 
 ComoJsObjectStub::ComoJsObjectStub(JSContext *ctx_, MetaCoclass *mCoclass, AutoPtr<IInterface> thisObject_)
     : ctx(ctx_)
     , thisObject(thisObject_),
+    externalMemorySize(0),
+    metaCoclass(mCoclass),
     methods(mCoclass->methods)
 {}
 
@@ -263,51 +394,51 @@ JSValue ComoJsObjectStub::methodimpl(IMetaMethod *method, int argc, JSValueConst
             }
             switch (kind) {
                 case TypeKind::Byte:
-                    if (JS_ToInt32(ctx, &iValue, argv[inParam++]))
+                    if (jsToInteger(ctx, &iValue, argv[inParam++]))
                         iValue = -1;
 
-                    argList->SetInputArgumentOfByte(i, iValue);
+                    argList->SetInputArgumentOfByte(i, (Byte)iValue);
                     break;
                 case TypeKind::Short:
-                    if (JS_ToInt32(ctx, &iValue, argv[inParam++]))
+                    if (jsToInteger(ctx, &iValue, argv[inParam++]))
                         iValue = -1;
 
-                    argList->SetInputArgumentOfShort(i, iValue);
+                    argList->SetInputArgumentOfShort(i, (Short)iValue);
                     break;
                 case TypeKind::Integer:
-                    if (JS_ToInt32(ctx, &iValue, argv[inParam++]))
+                    if (jsToInteger(ctx, &iValue, argv[inParam++]))
                         iValue = -1;
 
                     argList->SetInputArgumentOfInteger(i, iValue);
                     break;
                 case TypeKind::Long:
-                    if (JS_ToInt64(ctx, &lValue, argv[inParam++]))
+                    if (jsToLong(ctx, &lValue, argv[inParam++]))
                         lValue = -1;
 
                     argList->SetInputArgumentOfLong(i, lValue);
                     break;
                 case TypeKind::Float:
-                    if (JS_ToFloat64(ctx, &dValue, argv[inParam++]))
+                    if (jsToDouble(ctx, &dValue, argv[inParam++]))
                         dValue = -1;
 
-                    argList->SetInputArgumentOfFloat(i, dValue);
+                    argList->SetInputArgumentOfFloat(i, (Float)dValue);
                     break;
                 case TypeKind::Double:
-                    if (JS_ToFloat64(ctx, &dValue, argv[inParam++]))
+                    if (jsToDouble(ctx, &dValue, argv[inParam++]))
                         dValue = -1;
 
-                    argList->SetInputArgumentOfFloat(i, dValue);
+                    argList->SetInputArgumentOfDouble(i, dValue);
                     break;
                 case TypeKind::Char:
-                    if (JS_ToInt32(ctx, &iValue, argv[inParam++]))
+                    if (jsToInteger(ctx, &iValue, argv[inParam++]))
                         iValue = -1;
 
                     argList->SetInputArgumentOfChar(i, (Char)iValue);
                     break;
                 case TypeKind::Boolean:
-                    bValue = JS_ToBool(ctx, argv[inParam++]);
+                    bValue = jsToBoolean(ctx, argv[inParam++]);
 
-                    argList->SetInputArgumentOfChar(i, bValue);
+                    argList->SetInputArgumentOfBoolean(i, bValue);
                     break;
                 case TypeKind::String:
                     argList->SetInputArgumentOfString(i, JS_ToCString(ctx, argv[inParam++]));
@@ -332,11 +463,11 @@ JSValue ComoJsObjectStub::methodimpl(IMetaMethod *method, int argc, JSValueConst
             switch (kind) {
                 case TypeKind::Byte:
                     outResult[i] = reinterpret_cast<HANDLE>(malloc(sizeof(Byte)));
-                    argList->SetOutputArgumentOfInteger(i, outResult[i]);
+                    argList->SetOutputArgumentOfByte(i, outResult[i]);
                     break;
                 case TypeKind::Short:
                     outResult[i] = reinterpret_cast<HANDLE>(malloc(sizeof(Short)));
-                    argList->SetOutputArgumentOfInteger(i, outResult[i]);
+                    argList->SetOutputArgumentOfShort(i, outResult[i]);
                     break;
                 case TypeKind::Integer:
                     outResult[i] = reinterpret_cast<HANDLE>(malloc(sizeof(Integer)));
@@ -344,23 +475,23 @@ JSValue ComoJsObjectStub::methodimpl(IMetaMethod *method, int argc, JSValueConst
                     break;
                 case TypeKind::Long:
                     outResult[i] = reinterpret_cast<HANDLE>(malloc(sizeof(Long)));
-                    argList->SetOutputArgumentOfInteger(i, outResult[i]);
+                    argList->SetOutputArgumentOfLong(i, outResult[i]);
                     break;
                 case TypeKind::Float:
                     outResult[i] = reinterpret_cast<HANDLE>(malloc(sizeof(Float)));
-                    argList->SetOutputArgumentOfInteger(i, outResult[i]);
+                    argList->SetOutputArgumentOfFloat(i, outResult[i]);
                     break;
                 case TypeKind::Double:
                     outResult[i] = reinterpret_cast<HANDLE>(malloc(sizeof(Double)));
-                    argList->SetOutputArgumentOfInteger(i, outResult[i]);
+                    argList->SetOutputArgumentOfDouble(i, outResult[i]);
                     break;
                 case TypeKind::Char:
                     outResult[i] = reinterpret_cast<HANDLE>(malloc(sizeof(Char)));
-                    argList->SetOutputArgumentOfInteger(i, outResult[i]);
+                    argList->SetOutputArgumentOfChar(i, outResult[i]);
                     break;
                 case TypeKind::Boolean:
                     outResult[i] = reinterpret_cast<HANDLE>(malloc(sizeof(Boolean)));
-                    argList->SetOutputArgumentOfInteger(i, outResult[i]);
+                    argList->SetOutputArgumentOfBoolean(i, outResult[i]);
                     break;
                 case TypeKind::String:
                     outResult[i] = reinterpret_cast<HANDLE>(malloc(sizeof(String)));
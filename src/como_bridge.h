@@ -20,6 +20,7 @@
 #include <vector>
 #include <comoapi.h>
 #include "como_pytypes.h"
+#include "como_invoker.h"
 
 class MetaConstant;
 class MetaType;
@@ -27,8 +28,39 @@ class MetaValue;
 class MetaCoclass;
 
 #define MAX_METHOD_NAME_LENGTH 1024
+
+// A coclass may report the size of the native memory held by one of its
+// objects with a method of this name and signature, i.e.
+// GetNativeMemorySize(Long& size). The size is fed to the JS GC trigger
+// through JS_AdjustExternalMemory().
+#define NATIVE_MEMORY_SIZE_METHOD "GetNativeMemorySize"
+#define NATIVE_MEMORY_SIZE_SIGNATURE "&J"
+
 extern std::map<std::string, ComoJsObjectStub> g_como_classes;
 
+// ComoArena
+///////////////////////////////
+// Bump allocator for the data living as long as a MetaComponent (prototype
+// function tables and method names). Everything is released at once when
+// the arena is destroyed.
+class ComoArena {
+public:
+    ComoArena() : cur(nullptr), left(0) {}
+    ~ComoArena();
+    ComoArena(const ComoArena &) = delete;
+    ComoArena &operator=(const ComoArena &) = delete;
+
+    void *Alloc(size_t size);
+    char *StrDup(const char *str);
+
+private:
+    static const size_t BLOCK_SIZE = 16 * 1024;
+
+    std::vector<char*> blocks;
+    char *cur;
+    size_t left;
+};
+
 // MetaComponent
 ///////////////////////////////
 
@@ -40,7 +72,8 @@ class MetaComponent {
 public:
     MetaComponent(JSContext *ctx_, const std::string &componentPath_)
                 : ctx(ctx_)
-                , componentPath(componentPath_) {
+                , componentPath(componentPath_)
+                , previous(nullptr) {
         String path(componentPath.c_str());
         CoGetComponentMetadataWithPath(path, nullptr, componentHandle);
         GetAllCoclasses();
@@ -50,14 +83,13 @@ public:
                                    AutoPtr<IMetaComponent> componentHandle_)
                 : ctx(ctx_)
                 , componentHandle(componentHandle_)
-                , componentPath(componentPath_) {
+                , componentPath(componentPath_)
+                , previous(nullptr) {
         String path(componentPath.c_str());
         GetAllCoclasses();
     }
 
-    ~MetaComponent() {
-        Logger::V("como_quickjs", "delete MetaComponent object");
-    }
+    ~MetaComponent();
 
     std::string GetName();
     std::string GetComponentID();
@@ -65,7 +97,10 @@ public:
 
     std::string componentPath;
     std::vector<MetaCoclass*> como_classes;
-    std::vector<void*> vector_void_p;
+    ComoArena arena;
+    // component replaced by this one on reload, kept alive for the objects
+    // created from it
+    MetaComponent *previous;
 private:
     JSContext *ctx;
     void GetAllCoclasses();
@@ -80,7 +115,8 @@ class MetaCoclass {
 public:
     MetaCoclass(JSContext *ctx_, AutoPtr<IMetaCoclass> metaCoclass_)
             : ctx(ctx_)
-            , metaCoclass(metaCoclass_) {
+            , metaCoclass(metaCoclass_)
+            , classId(0) {
         metaCoclass_->GetMethodNumber(methodNumber);
         Array<IMetaMethod*> methods_(methodNumber);
         ECode ec = metaCoclass_->GetAllMethods(methods_);
@@ -112,6 +148,20 @@ public:
             throw std::runtime_error("COMO class GetAllConstructors: " + className);
         }
         constrs = constrs_;
+
+        idxNativeMemorySize = -1;
+        for (Integer i = 0;  i < methodNumber;  i++) {
+            String name, signature;
+            methods[i]->GetName(name);
+            methods[i]->GetSignature(signature);
+            if (name.Equals(NATIVE_MEMORY_SIZE_METHOD) &&
+                signature.Equals(NATIVE_MEMORY_SIZE_SIGNATURE)) {
+                idxNativeMemorySize = i;
+                break;
+            }
+        }
+
+        GetDirectInvokers();
     }
 
     std::string GetName();
@@ -120,13 +170,23 @@ public:
     int GetMethodParameterNumber(int idxMethod);
     AutoPtr<IInterface> CreateObject();
     void constructObj(ComoJsObjectStub *stub, int argc, JSValueConst *argv);
+    Long GetNativeMemorySize(ComoJsObjectStub *stub);
+    bool SameMethods(MetaCoclass *other);
 
     Integer methodNumber;
+    Integer idxNativeMemorySize;
     Integer constrsNumber;
     AutoPtr<IMetaCoclass> metaCoclass;
+    JSClassID classId;
     Array<IMetaMethod*> methods;
+    // per method, nullptr when it has to go through IMetaMethod::Invoke()
+    std::vector<ComoDirectInvoker> directInvokers;
+    // interned method names, owned by the MetaCoclass
+    std::vector<JSAtom> methodAtoms;
 
 private:
+    void GetDirectInvokers();
+
     JSContext *ctx;
     Array<IMetaConstructor*> constrs;
     Array<Boolean> overridesInfo;
@@ -0,0 +1,126 @@
+//=========================================================================
+// Copyright (C) 2021 The C++ Component Model(COMO) Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//=========================================================================
+
+/* Generate the direct invokers (see como_invoker.h) of a COMO component.
+ *
+ * usage: como_gen_invokers component.so header.h... > invokers.cpp
+ *
+ * The headers are the C++ headers declaring the interfaces of the
+ * component. The generated file is compiled into the program embedding
+ * como_quickjs. Only the methods whose parameters are all scalars or
+ * strings, with at most one out parameter, get a wrapper. The
+ * others (overloaded methods, arrays, HANDLE, IDs, and interface or enum
+ * parameters, which the signature doesn't tell apart) are left to
+ * IMetaMethod::Invoke().
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <set>
+#include <comoapi.h>
+#include "utils.h"
+
+using namespace como;
+
+static bool isScalarType(char c)
+{
+    return strchr("BSIJFDCZT", c) != nullptr;
+}
+
+static bool isSupportedMethod(IMetaMethod *method)
+{
+    String signature;
+    method->GetSignature(signature);
+
+    std::vector<std::string> types;
+    breakSignature(signature, types);
+
+    int outArgs = 0;
+    for (size_t i = 0;  i < types.size();  i++) {
+        const std::string &t = types[i];
+        if ((t.size() == 1) && isScalarType(t[0]))
+            continue;
+        if ((t.size() == 2) && (t[0] == '&') && isScalarType(t[1])) {
+            outArgs++;
+            continue;
+        }
+        return false;
+    }
+    return outArgs <= 1;
+}
+
+static void genInterface(IMetaInterface *itf)
+{
+    String name, ns;
+    itf->GetName(name);
+    itf->GetNamespace(ns);
+    if (ns.EndsWith("::"))
+        ns = ns.Substring(0, ns.GetByteLength() - 2);
+
+    Integer number;
+    itf->GetMethodNumber(number);
+    Array<IMetaMethod*> methods(number);
+    itf->GetAllMethods(methods);
+
+    std::set<std::string> names, overloaded;
+    for (Integer i = 0;  i < number;  i++) {
+        String methodName;
+        methods[i]->GetName(methodName);
+        if (! names.insert(methodName.string()).second)
+            overloaded.insert(methodName.string());
+    }
+
+    for (Integer i = 0;  i < number;  i++) {
+        String methodName, signature;
+        methods[i]->GetName(methodName);
+        methods[i]->GetSignature(signature);
+        if (overloaded.count(methodName.string()) || !isSupportedMethod(methods[i]))
+            continue;
+
+        printf("COMO_JS_DIRECT_METHOD(%s, %s, %s, \"%s\")\n", ns.string(),
+               name.string(), methodName.string(), signature.string());
+    }
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2) {
+        fprintf(stderr, "usage: como_gen_invokers component.so header.h...\n");
+        return 1;
+    }
+
+    AutoPtr<IMetaComponent> mc;
+    ECode ec = CoGetComponentMetadataWithPath(String(argv[1]), nullptr, mc);
+    if (FAILED(ec) || (mc == nullptr)) {
+        fprintf(stderr, "como_gen_invokers: can't load the metadata of %s\n", argv[1]);
+        return 1;
+    }
+
+    printf("// Generated by como_gen_invokers from %s, do not edit.\n\n", argv[1]);
+    printf("#include \"como_invoker.h\"\n");
+    for (int i = 2;  i < argc;  i++)
+        printf("#include \"%s\"\n", argv[i]);
+    printf("\n");
+
+    Integer number;
+    mc->GetInterfaceNumber(number);
+    Array<IMetaInterface*> interfaces(number);
+    mc->GetAllInterfaces(interfaces);
+    for (Integer i = 0;  i < number;  i++)
+        genInterface(interfaces[i]);
+
+    return 0;
+}
@@ -0,0 +1,53 @@
+//=========================================================================
+// Copyright (C) 2021 The C++ Component Model(COMO) Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//=========================================================================
+
+#include <comoapi.h>
+#include "como_invoker.h"
+
+struct ComoDirectMethodEntry {
+    InterfaceID iid;
+    std::string name;
+    std::string signature;
+    ComoDirectInvoker invoker;
+};
+
+// registrations are done by static constructors, so the table must be
+// constructed on first use
+static std::vector<ComoDirectMethodEntry> &directMethods()
+{
+    static std::vector<ComoDirectMethodEntry> entries;
+    return entries;
+}
+
+void ComoRegisterDirectMethod(const InterfaceID &iid, const char *name,
+                              const char *signature, ComoDirectInvoker invoker)
+{
+    directMethods().push_back({iid, name, signature, invoker});
+}
+
+// only used when a coclass is loaded, not on the call path
+ComoDirectInvoker ComoFindDirectMethod(const InterfaceID &iid,
+                                       const std::string &name,
+                                       const std::string &signature)
+{
+    std::vector<ComoDirectMethodEntry> &entries = directMethods();
+    for (size_t i = 0;  i < entries.size();  i++) {
+        ComoDirectMethodEntry &e = entries[i];
+        if ((e.iid == iid) && (e.name == name) && (e.signature == signature))
+            return e.invoker;
+    }
+    return nullptr;
+}
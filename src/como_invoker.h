@@ -0,0 +1,230 @@
+//=========================================================================
+// Copyright (C) 2021 The C++ Component Model(COMO) Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//=========================================================================
+
+#ifndef __COMO_INVOKER_H__
+#define __COMO_INVOKER_H__
+
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <comoapi.h>
+#include "quickjs.h"
+#include "utils.h"
+
+/* Direct invocation of COMO interface methods.
+ *
+ * IMetaMethod::Invoke() marshals every call through an IArgumentList. For
+ * the interfaces whose C++ header is available when the bridge is built,
+ * como_gen_invokers emits one COMO_JS_DIRECT_METHOD() line per method; it
+ * instantiates a wrapper which converts the JS arguments and calls the
+ * method through the interface vtable. MetaCoclass picks the wrapper up
+ * when the coclass implements the registered InterfaceID, and falls back
+ * to the reflective path otherwise.
+ */
+
+typedef JSValue (*ComoDirectInvoker)(JSContext *ctx, IInterface *object,
+                                     int argc, JSValueConst *argv);
+
+void ComoRegisterDirectMethod(const InterfaceID &iid, const char *name,
+                              const char *signature, ComoDirectInvoker invoker);
+ComoDirectInvoker ComoFindDirectMethod(const InterfaceID &iid,
+                                       const std::string &name,
+                                       const std::string &signature);
+
+// JS <-> COMO conversion of one parameter
+///////////////////////////////
+template<typename T, typename Enable = void>
+struct ComoJsParam;
+
+// Byte, Short, Integer, Long, Char, Boolean (in)
+template<typename T>
+struct ComoJsParam<T, typename std::enable_if<std::is_arithmetic<T>::value>::type> {
+    typedef T Storage;
+    static const bool isOut = false;
+
+    static bool Load(JSContext *ctx, JSValueConst val, Storage &out)
+    {
+        if (std::is_same<T, bool>::value) {
+            out = jsToBoolean(ctx, val);
+            return true;
+        }
+        if (std::is_floating_point<T>::value) {
+            double d;
+            if (jsToDouble(ctx, &d, val))
+                return false;
+            out = (T)d;
+            return true;
+        }
+        if (sizeof(T) > sizeof(int32_t)) {
+            int64_t l;
+            if (jsToLong(ctx, &l, val))
+                return false;
+            out = (T)l;
+            return true;
+        }
+        int32_t i;
+        if (jsToInteger(ctx, &i, val))
+            return false;
+        out = (T)i;
+        return true;
+    }
+};
+
+// String (in)
+template<>
+struct ComoJsParam<const String &> {
+    typedef String Storage;
+    static const bool isOut = false;
+
+    static bool Load(JSContext *ctx, JSValueConst val, Storage &out)
+    {
+        const char *str = JS_ToCString(ctx, val);
+        if (str == nullptr)
+            return false;
+        out = str;
+        JS_FreeCString(ctx, str);
+        return true;
+    }
+};
+
+// Byte&, Short&, Integer&, Long&, Float&, Double&, Char&, Boolean& (out)
+template<typename T>
+struct ComoJsParam<T &, typename std::enable_if<std::is_arithmetic<T>::value>::type> {
+    typedef T Storage;
+    static const bool isOut = true;
+
+    static JSValue Store(JSContext *ctx, const Storage &val)
+    {
+        if (std::is_same<T, bool>::value)
+            return JS_NewBool(ctx, val);
+        if (std::is_floating_point<T>::value)
+            return JS_NewFloat64(ctx, (double)val);
+        if (sizeof(T) > sizeof(int32_t))
+            return JS_NewInt64(ctx, (int64_t)val);
+        return JS_NewInt32(ctx, (int32_t)val);
+    }
+};
+
+// String& (out)
+template<>
+struct ComoJsParam<String &> {
+    typedef String Storage;
+    static const bool isOut = true;
+
+    static JSValue Store(JSContext *ctx, const Storage &val)
+    {
+        return JS_NewString(ctx, val.string());
+    }
+};
+
+template<typename P, bool isOut = ComoJsParam<P>::isOut>
+struct ComoJsParamIO {
+    static bool Load(JSContext *ctx, int argc, JSValueConst *argv, int &idx,
+                     typename ComoJsParam<P>::Storage &out)
+    {
+        if (idx >= argc) {
+            JS_ThrowTypeError(ctx, "too few COMO input parameters");
+            return false;
+        }
+        return ComoJsParam<P>::Load(ctx, argv[idx++], out);
+    }
+
+    static void Store(JSContext *ctx, const typename ComoJsParam<P>::Storage &val,
+                      JSValue &result)
+    {}
+};
+
+template<typename P>
+struct ComoJsParamIO<P, true> {
+    static bool Load(JSContext *ctx, int argc, JSValueConst *argv, int &idx,
+                     typename ComoJsParam<P>::Storage &out)
+    {
+        return true;
+    }
+
+    static void Store(JSContext *ctx, const typename ComoJsParam<P>::Storage &val,
+                      JSValue &result)
+    {
+        JS_FreeValue(ctx, result);
+        result = ComoJsParam<P>::Store(ctx, val);
+    }
+};
+
+// wrapper for one method, F is the type of the member function pointer M
+///////////////////////////////
+template<typename F, F M>
+struct ComoDirectCall;
+
+template<typename I, typename... Args, ECode (I::*M)(Args...)>
+struct ComoDirectCall<ECode (I::*)(Args...), M> {
+    typedef std::tuple<typename ComoJsParam<Args>::Storage...> Storages;
+
+    template<std::size_t... Is>
+    static JSValue Call(JSContext *ctx, I *itf, int argc, JSValueConst *argv,
+                        std::index_sequence<Is...>)
+    {
+        Storages storages{};
+        bool ok = true;
+        int idx = 0;
+        int dummy[] = { 0, (ok = ok && ComoJsParamIO<Args>::Load(ctx, argc, argv, idx,
+                                                        std::get<Is>(storages)), 0)... };
+        (void)dummy;
+        if (!ok)
+            return JS_EXCEPTION;
+
+        // like IMetaMethod::Invoke() in methodimpl, the ECode is not
+        // reported to JS
+        (itf->*M)(std::get<Is>(storages)...);
+
+        JSValue result = JS_UNDEFINED;
+        int dummy2[] = { 0, (ComoJsParamIO<Args>::Store(ctx, std::get<Is>(storages),
+                                                        result), 0)... };
+        (void)dummy2;
+        return result;
+    }
+
+    static JSValue Invoke(JSContext *ctx, IInterface *object,
+                          int argc, JSValueConst *argv)
+    {
+        I *itf = I::Probe(object);
+        if (itf == nullptr)
+            return JS_ThrowTypeError(ctx, "COMO object does not implement the interface");
+        return Call(ctx, itf, argc, argv, std::index_sequence_for<Args...>());
+    }
+};
+
+class ComoDirectMethodRegistrar {
+public:
+    ComoDirectMethodRegistrar(const InterfaceID &iid, const char *name,
+                              const char *signature, ComoDirectInvoker invoker)
+    {
+        ComoRegisterDirectMethod(iid, name, signature, invoker);
+    }
+};
+
+#define COMO_JS_CONCAT_(a, b) a##b
+#define COMO_JS_CONCAT(a, b) COMO_JS_CONCAT_(a, b)
+
+/* ns: C++ namespace of the interface, itf: interface name, method: method
+   name (must not be overloaded), signature: COMO signature of the method */
+#define COMO_JS_DIRECT_METHOD(ns, itf, method, signature)                     \
+    static ComoDirectMethodRegistrar COMO_JS_CONCAT(s_como_direct_, __LINE__)( \
+        ns::IID_##itf, #method, signature,                                    \
+        &ComoDirectCall<decltype(&ns::itf::method), &ns::itf::method>::Invoke);
+
+#endif
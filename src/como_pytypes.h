@@ -34,6 +34,8 @@ public:
 
     AutoPtr<IInterface> thisObject;
     std::string className;
+    Long externalMemorySize;
+    MetaCoclass *metaCoclass;
     Array<IMetaMethod*> methods;
 
 private:
@@ -14,6 +14,7 @@
 // limitations under the License.
 //=========================================================================
 
+#include <dlfcn.h>
 #include <comoapi.h>
 #include "como_bridge.h"
 #include "como_quickjs.h"
@@ -22,22 +23,67 @@ using namespace como;
 
 static JSCFunctionListEntry *genComoProtoFuncs(JSContext *ctx, MetaComponent *metaComponent,
                                                MetaCoclass *metaCoclass);
+extern "C" int js_findComoClass(void *metaComponent_, const char *className);
 
 static void js_como_finalizer(JSRuntime *rt, JSValue val)
 {
     ComoJsObjectStub *stub = (ComoJsObjectStub *)JS_GetRawOpaque(val);
     // Note: 'stub' can be NULL in case JS_SetOpaque() was not called
     if (stub != nullptr) {
+        if (stub->externalMemorySize != 0)
+            JS_AdjustExternalMemory(rt, -stub->externalMemorySize);
         delete stub;
     }
 }
 
+// let the GC know about the native memory held behind stub->thisObject
+static void js_como_account_memory(JSContext *ctx, MetaCoclass *metaCoclass,
+                                   ComoJsObjectStub *stub)
+{
+    stub->externalMemorySize = metaCoclass->GetNativeMemorySize(stub);
+    if (stub->externalMemorySize != 0)
+        JS_AdjustExternalMemory(JS_GetRuntime(ctx), stub->externalMemorySize);
+}
+
+// 1 if proto is the current prototype of class_id, inherits from it or
+// is not an object, 0 if not, -1 on exception. After a reload, a
+// constructor or a subclass saved before it leads to the previous
+// prototype, whose methods are numbered after the previous MetaCoclass.
+static int js_como_is_current_proto(JSContext *ctx, JSClassID class_id,
+                                    JSValueConst proto)
+{
+    if (!JS_IsObject(proto))
+        return 1;
+
+    JSValue class_proto = JS_GetClassProto(ctx, class_id);
+    JSValue p = JS_DupValue(ctx, proto);
+    int ret = 0;
+
+    while (JS_IsObject(p)) {
+        if (JS_VALUE_GET_PTR(p) == JS_VALUE_GET_PTR(class_proto)) {
+            ret = 1;
+            break;
+        }
+        JSValue p1 = JS_GetPrototype(ctx, p);
+        JS_FreeValue(ctx, p);
+        p = p1;
+        if (JS_IsException(p)) {
+            ret = -1;
+            break;
+        }
+    }
+    JS_FreeValue(ctx, p);
+    JS_FreeValue(ctx, class_proto);
+    return ret;
+}
+
 static JSValue js_como_ctor(JSContext *ctx, JSValueConst new_target,
                             int argc, JSValueConst *argv,
                             int magic)
 {
     JSValue obj = JS_UNDEFINED;
     JSValue proto;
+    int ret;
 
     JSClassID class_id = magic;
     /* this doesn't work
@@ -48,6 +94,20 @@ static JSValue js_como_ctor(JSContext *ctx, JSValueConst new_target,
     MetaCoclass *metaCoclass = (MetaCoclass *)JS_GetClassComoClass(ctx, class_id);
     ComoJsObjectStub *stub;
 
+    // using new_target to get the prototype is necessary when the
+    // class is extended.
+    proto = JS_GetPropertyStr(ctx, new_target, "prototype");
+    if (JS_IsException(proto))
+        return JS_EXCEPTION;
+    ret = js_como_is_current_proto(ctx, class_id, proto);
+    if (ret <= 0) {
+        JS_FreeValue(ctx, proto);
+        if (ret == 0)
+            JS_ThrowTypeError(ctx, "COMO class %s was reloaded, use its new constructor",
+                              metaCoclass->GetName().c_str());
+        return JS_EXCEPTION;
+    }
+
     if (argc == 0) {
         AutoPtr<IInterface> thisObject = metaCoclass->CreateObject();
         if (thisObject == nullptr)
@@ -61,19 +121,17 @@ static JSValue js_como_ctor(JSContext *ctx, JSValueConst new_target,
             goto fail;
         metaCoclass->constructObj(stub, argc, argv);
     }
+    js_como_account_memory(ctx, metaCoclass, stub);
 
-    // using new_target to get the prototype is necessary when the
-    // class is extended.
-    proto = JS_GetPropertyStr(ctx, new_target, "prototype");
-    if (JS_IsException(proto))
-        goto fail;
     obj = JS_NewObjectProtoClass(ctx, proto, class_id);
     JS_FreeValue(ctx, proto);
+    proto = JS_UNDEFINED;
     if (JS_IsException(obj))
         goto fail;
     JS_SetOpaque(obj, stub);
     return obj;
  fail:
+    JS_FreeValue(ctx, proto);
     JS_FreeValue(ctx, obj);
     return JS_EXCEPTION;
 }
@@ -85,6 +143,14 @@ static JSValue js_como_method(JSContext *ctx, JSValueConst this_val,
     ComoJsObjectStub *stub = (ComoJsObjectStub *)JS_GetRawOpaque(this_val);
     if (!stub)
         return JS_EXCEPTION;
+    // a method of a prototype replaced by a reload may be called on an
+    // object of the new class
+    if (magic >= stub->metaCoclass->methodNumber)
+        return JS_ThrowTypeError(ctx, "COMO method not found in the reloaded class");
+
+    ComoDirectInvoker invoker = stub->metaCoclass->directInvokers[magic];
+    if (invoker != nullptr)
+        return invoker(ctx, stub->thisObject, argc, argv);
     return stub->methodimpl(stub->methods[magic], argc, argv, false);
 }
 
@@ -108,14 +174,75 @@ extern "C" int js_exportComoClasses(JSContext *ctx, JSModuleDef *m, const char *
     return 0;
 }
 
+// Create the prototype and the constructor of metaCoclass for class_id,
+// without registering them. Return the constructor and the prototype in
+// *pproto, JS_EXCEPTION on error.
+static JSValue js_como_build_class(JSContext *ctx, MetaComponent *metaComponent,
+                                   MetaCoclass *metaCoclass, JSClassID class_id,
+                                   JSValue *pproto)
+{
+    JSCFunctionListEntry *js_como_proto_funcs;
+    JSValue como_proto, como_class;
+    std::string className = metaCoclass->GetName();
+
+    js_como_proto_funcs = genComoProtoFuncs(ctx, metaComponent, metaCoclass);
+    if (js_como_proto_funcs == nullptr)
+        return JS_ThrowOutOfMemory(ctx);
+
+    como_proto = JS_NewObject(ctx);
+    if (JS_IsException(como_proto))
+        return JS_EXCEPTION;
+    JS_SetPropertyFunctionListAtoms(ctx, como_proto, metaCoclass->methodAtoms.data(),
+                                    js_como_proto_funcs, metaCoclass->methodNumber);
+
+    // int arg_count = p->u.cfunc.length;
+    const int arg_count = 0;
+    como_class = JS_NewCFunctionMagic(ctx, js_como_ctor, className.c_str(), arg_count,
+                                      JS_CFUNC_constructor_magic, class_id);
+    if (JS_IsException(como_class)) {
+        JS_FreeValue(ctx, como_proto);
+        return JS_EXCEPTION;
+    }
+
+    // set proto.constructor and ctor.prototype
+    JS_SetConstructor(ctx, como_class, como_proto);
+
+    *pproto = como_proto;
+    return como_class;
+}
+
+// Make class_id use metaCoclass and the prototype built by
+// js_como_build_class(). Takes ownership of como_proto.
+static void js_como_bind_class(JSContext *ctx, MetaCoclass *metaCoclass,
+                               JSClassID class_id, JSValue como_proto)
+{
+    JS_SetClassProto(ctx, class_id, como_proto);
+    JS_SetClassComoClass(ctx, class_id, metaCoclass);
+    metaCoclass->classId = class_id;
+}
+
+// Create the prototype and the constructor of metaCoclass, registered as
+// class_id. Return the constructor, JS_EXCEPTION on error.
+static JSValue js_como_new_class(JSContext *ctx, MetaComponent *metaComponent,
+                                 MetaCoclass *metaCoclass, JSClassID class_id)
+{
+    JSValue como_proto, como_class;
+
+    como_class = js_como_build_class(ctx, metaComponent, metaCoclass, class_id,
+                                     &como_proto);
+    if (JS_IsException(como_class))
+        return JS_EXCEPTION;
+    js_como_bind_class(ctx, metaCoclass, class_id, como_proto);
+    return como_class;
+}
+
 extern "C" int js_como_init(JSContext *ctx, JSModuleDef *m)
 {
     JSClassDef js_como_class = {
         .finalizer = js_como_finalizer,
     };
 
-    JSCFunctionListEntry *js_como_proto_funcs;
-    JSValue como_proto, como_class;
+    JSValue como_class;
     JSClassID class_id;
     MetaComponent *metaComponent = (MetaComponent *)JS_GetJSModuleDefMetaComponent(m);
     if (metaComponent == nullptr)
@@ -134,49 +261,142 @@ extern "C" int js_como_init(JSContext *ctx, JSModuleDef *m)
         js_como_class.class_name = szClassName;
         JS_NewClass(JS_GetRuntime(ctx), class_id, &js_como_class);
 
-        js_como_proto_funcs = genComoProtoFuncs(ctx, metaComponent, metaCoclass);
-        if (js_como_proto_funcs == nullptr)
-            return 0;
+        como_class = js_como_new_class(ctx, metaComponent, metaCoclass, class_id);
+        if (JS_IsException(como_class))
+            return -1;
+
+        JS_SetModuleExport(ctx, m, szClassName, como_class);
+    }
 
-        // vector.push_back(), will put the elements of js_como_proto_funcs which should be freed
-        // before js_como_proto_funcs itself.
-        metaComponent->vector_void_p.push_back((void*)js_como_proto_funcs);
+    return 0;
+}
 
-        como_proto = JS_NewObject(ctx);
-        JS_SetPropertyFunctionList(ctx, como_proto, js_como_proto_funcs, metaCoclass->methodNumber);
+extern "C" int js_reloadComoModule(JSContext *ctx, const char *module_name, const char *filename)
+{
+    JSModuleDef *m;
+    if (JS_FindComoModule(ctx, module_name, &m))
+        return -1;
+    if (m == nullptr) {
+        JS_ThrowReferenceError(ctx, "COMO module '%s' is not loaded", module_name);
+        return -1;
+    }
+    MetaComponent *oldComponent = (MetaComponent *)JS_GetJSModuleDefMetaComponent(m);
+
+    // the previous image is never unloaded, existing objects still use it
+    void *hd = dlopen(filename, RTLD_NOW | RTLD_LOCAL);
+    if ((hd == nullptr) || (dlsym(hd, "soGetComoVersion") == nullptr)) {
+        if (hd != nullptr)
+            dlclose(hd);
+        JS_ThrowReferenceError(ctx, "could not load COMO component '%s'", filename);
+        return -1;
+    }
 
-        // int arg_count = p->u.cfunc.length;
-        const int arg_count = 0;
-        como_class = JS_NewCFunctionMagic(ctx, js_como_ctor, szClassName, arg_count, JS_CFUNC_constructor_magic, class_id);
+    AutoPtr<IMetaComponent> mc;
+    ECode ec = CoGetComponentMetadataFromFile(reinterpret_cast<HANDLE>(hd), nullptr, mc);
+    if (FAILED(ec) || (mc == nullptr)) {
+        dlclose(hd);
+        JS_ThrowReferenceError(ctx, "could not get the metadata of '%s'", filename);
+        return -1;
+    }
+    MetaComponent *metaComponent = new MetaComponent(ctx, oldComponent->componentPath, mc);
+
+    // build all the classes first, so that a failure leaves the module
+    // bound to the old component
+    struct ReloadedClass {
+        MetaCoclass *metaCoclass;
+        JSClassID class_id;
+        JSValue como_proto;     // JS_UNDEFINED if the methods are unchanged
+        JSValue como_class;
+    };
+    std::vector<ReloadedClass> classes;
+    bool failed = false;
+    for (int i = 0;  i < metaComponent->como_classes.size();  i++) {
+        MetaCoclass *metaCoclass = metaComponent->como_classes[i];
+        std::string className = metaCoclass->GetName();
 
-        // set proto.constructor and ctor.prototype
-        JS_SetConstructor(ctx, como_class, como_proto);
-        JS_SetClassProto(ctx, class_id, como_proto);
+        int idx = js_findComoClass(oldComponent, className.c_str());
+        if (idx < 0) {
+            // the exports of a module are fixed once it is instantiated
+            Logger::W("como_quickjs", "reload: class %s is not exported by %s\n",
+                      className.c_str(), module_name);
+            continue;
+        }
+        MetaCoclass *oldCoclass = oldComponent->como_classes[idx];
+        JSClassID class_id = oldCoclass->classId;
+
+        if (metaCoclass->SameMethods(oldCoclass)) {
+            Logger::V("como_quickjs", "reload class, className: %s (unchanged)\n",
+                      className.c_str());
+            classes.push_back({ metaCoclass, class_id, JS_UNDEFINED, JS_UNDEFINED });
+            continue;
+        }
+
+        Logger::V("como_quickjs", "reload class, className: %s\n", className.c_str());
+        JSValue como_proto;
+        JSValue como_class = js_como_build_class(ctx, metaComponent, metaCoclass,
+                                                 class_id, &como_proto);
+        if (JS_IsException(como_class)) {
+            failed = true;
+            break;
+        }
+        classes.push_back({ metaCoclass, class_id, como_proto, como_class });
+    }
 
-        JS_SetClassComoClass(ctx, class_id, metaCoclass);
+    if (failed) {
+        for (size_t i = 0;  i < classes.size();  i++) {
+            JS_FreeValue(ctx, classes[i].como_class);
+            JS_FreeValue(ctx, classes[i].como_proto);
+        }
+        delete metaComponent;
+        dlclose(hd);
+        return -1;
+    }
 
-        JS_SetModuleExport(ctx, m, szClassName, como_class);
+    for (size_t i = 0;  i < classes.size();  i++) {
+        ReloadedClass &c = classes[i];
+        if (JS_IsUndefined(c.como_class)) {
+            JS_SetClassComoClass(ctx, c.class_id, c.metaCoclass);
+            c.metaCoclass->classId = c.class_id;
+            continue;
+        }
+        js_como_bind_class(ctx, c.metaCoclass, c.class_id, c.como_proto);
+        JS_SetModuleExport(ctx, m, c.metaCoclass->GetName().c_str(), c.como_class);
     }
 
+    metaComponent->previous = oldComponent;
+    JS_SetJSModuleDefMetaComponent(m, metaComponent);
+
     return 0;
 }
 
+// The table and the method names are allocated in the arena of the
+// MetaComponent: the prototype keeps pointers to the entries until its
+// methods are instantiated.
 static JSCFunctionListEntry *genComoProtoFuncs(JSContext *ctx, MetaComponent *metaComponent, MetaCoclass *metaCoclass)
 {
     JSCFunctionListEntry *js_como_proto_funcs;
-    js_como_proto_funcs = (JSCFunctionListEntry *)calloc(metaCoclass->methodNumber, sizeof(JSCFunctionListEntry));
+    size_t size = metaCoclass->methodNumber * sizeof(JSCFunctionListEntry);
+    js_como_proto_funcs = (JSCFunctionListEntry *)metaComponent->arena.Alloc(size);
     if (js_como_proto_funcs == nullptr)
         return nullptr;
+    memset(js_como_proto_funcs, 0, size);
 
     JSCFunctionListEntry *jscfle;
     char buf[MAX_METHOD_NAME_LENGTH];
+    metaCoclass->methodAtoms.reserve(metaCoclass->methodNumber);
     for (int i = 0;  i < metaCoclass->methodNumber; i++) {
         metaCoclass->GetMethodName(i, buf);
         Logger::V("como_quickjs", "load method, methodName: %s\n", buf);
         jscfle = &js_como_proto_funcs[i];
 
-        jscfle->name = strdup(buf);
-        metaComponent->vector_void_p.push_back((void*)jscfle->name);
+        jscfle->name = metaComponent->arena.StrDup(buf);
+        if (jscfle->name == nullptr)
+            return nullptr;
+
+        JSAtom atom = JS_NewAtom(ctx, jscfle->name);
+        if (atom == JS_ATOM_NULL)
+            return nullptr;
+        metaCoclass->methodAtoms.push_back(atom);
 
         jscfle->prop_flags = JS_PROP_WRITABLE | JS_PROP_CONFIGURABLE;
         jscfle->def_type = JS_DEF_CFUNC;
@@ -191,12 +411,7 @@ static JSCFunctionListEntry *genComoProtoFuncs(JSContext *ctx, MetaComponent *me
 
 extern "C" void freeMetaComponent(void *metaComponent)
 {
-    std::vector<void*> vector_void_p = ((MetaComponent*)metaComponent)->vector_void_p;
-
-
-    for (int i = 0;  i < vector_void_p.size(); i++)
-        free(vector_void_p[i]);
-
+    // the arena of the MetaComponent is released by its destructor
     delete (MetaComponent*)metaComponent;
 }
 
@@ -225,6 +440,7 @@ JSValue js_box_JSValue(JSContext *ctx, int class_id, AutoPtr<IInterface> thisObj
     stub = new ComoJsObjectStub(ctx, metaCoclass, thisObject);
     if (stub == nullptr)
         goto jb_fail;
+    js_como_account_memory(ctx, metaCoclass, stub);
 
     JS_SetOpaque(obj, stub);
     return obj;
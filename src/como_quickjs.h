@@ -37,9 +37,24 @@ JSClassID JS_GetJSObjectClassID(JSObject *obj);
 const char *JS_GetModuleNameCString(JSContext *ctx, JSModuleDef *m);
 void JS_SetJSModuleDefMetaComponent(JSModuleDef *m, void *metaComponent);
 void *JS_GetJSModuleDefMetaComponent(JSModuleDef *m);
+void JS_SetPropertyFunctionListAtoms(JSContext *ctx, JSValueConst obj,
+                                     const JSAtom *atoms,
+                                     const JSCFunctionListEntry *tab, int len);
+int JS_FindComoModule(JSContext *ctx, const char *module_name,
+                      JSModuleDef **pm);
 /* COMO
  */
 
+/* Reload the component of the COMO module 'module_name' from 'filename'.
+ * The classes whose methods changed get a new prototype and constructor,
+ * the others only create their new objects from the new component.
+ * Existing objects keep using the component they were created from.
+ * 'filename' must differ from the path of the loaded image, otherwise
+ * dlopen() returns the image already loaded.
+ * Return 0 on success, -1 with a pending exception otherwise.
+ */
+int js_reloadComoModule(JSContext *ctx, const char *module_name, const char *filename);
+
 #ifdef __cplusplus
 } /* extern "C" { */
 #endif
@@ -25,4 +25,48 @@ std::map<std::string, JSValue> constantsToMap(JSContext *ctx, Array<IMetaConstan
 
 void breakSignature(String &signature, std::vector<std::string> &signatureVector);
 
+/* Width-exact marshallers for COMO scalar parameters. The tagged values
+ * which need no coercion (JS_TAG_INT, JS_TAG_FLOAT64, JS_TAG_BOOL) are
+ * read directly, anything else goes through the generic JS_ToXxx()
+ * conversion. They return -1 with a pending exception on failure.
+ */
+static inline int jsToInteger(JSContext *ctx, int32_t *pres, JSValueConst val)
+{
+    if (JS_VALUE_GET_TAG(val) == JS_TAG_INT) {
+        *pres = JS_VALUE_GET_INT(val);
+        return 0;
+    }
+    return JS_ToInt32(ctx, pres, val);
+}
+
+static inline int jsToLong(JSContext *ctx, int64_t *pres, JSValueConst val)
+{
+    if (JS_VALUE_GET_TAG(val) == JS_TAG_INT) {
+        *pres = JS_VALUE_GET_INT(val);
+        return 0;
+    }
+    return JS_ToInt64(ctx, pres, val);
+}
+
+static inline int jsToDouble(JSContext *ctx, double *pres, JSValueConst val)
+{
+    int tag = JS_VALUE_GET_TAG(val);
+    if (JS_TAG_IS_FLOAT64(tag)) {
+        *pres = JS_VALUE_GET_FLOAT64(val);
+        return 0;
+    }
+    if (tag == JS_TAG_INT) {
+        *pres = JS_VALUE_GET_INT(val);
+        return 0;
+    }
+    return JS_ToFloat64(ctx, pres, val);
+}
+
+static inline bool jsToBoolean(JSContext *ctx, JSValueConst val)
+{
+    if (JS_VALUE_GET_TAG(val) == JS_TAG_BOOL)
+        return JS_VALUE_GET_BOOL(val);
+    return JS_ToBool(ctx, val);
+}
+
 #endif
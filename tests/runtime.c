@@ -0,0 +1,107 @@
+/*
+ * QuickJS: runtime internals module (test only)
+ *
+ * Copyright (c) 2017-2021 Fabrice Bellard
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include "../quickjs-libc.h"
+#include "../cutils.h"
+
+static JSValue js_runtime_memoryUsage(JSContext *ctx, JSValueConst this_val,
+                                      int argc, JSValueConst *argv)
+{
+    JSMemoryUsage s;
+    JSValue obj;
+
+    JS_ComputeMemoryUsage(JS_GetRuntime(ctx), &s);
+    obj = JS_NewObject(ctx);
+    if (JS_IsException(obj))
+        return obj;
+    JS_SetPropertyStr(ctx, obj, "malloc_size", JS_NewInt64(ctx, s.malloc_size));
+    JS_SetPropertyStr(ctx, obj, "obj_count", JS_NewInt64(ctx, s.obj_count));
+    JS_SetPropertyStr(ctx, obj, "gc_count", JS_NewInt64(ctx, s.gc_count));
+    JS_SetPropertyStr(ctx, obj, "gc_young_count", JS_NewInt64(ctx, s.gc_young_count));
+    return obj;
+}
+
+static JSValue js_runtime_setGCThreshold(JSContext *ctx, JSValueConst this_val,
+                                         int argc, JSValueConst *argv)
+{
+    int64_t v;
+
+    if (JS_ToInt64(ctx, &v, argv[0]))
+        return JS_EXCEPTION;
+    JS_SetGCThreshold(JS_GetRuntime(ctx), v);
+    return JS_UNDEFINED;
+}
+
+static JSValue js_runtime_setGCYoungThreshold(JSContext *ctx, JSValueConst this_val,
+                                              int argc, JSValueConst *argv)
+{
+    int v;
+
+    if (JS_ToInt32(ctx, &v, argv[0]))
+        return JS_EXCEPTION;
+    JS_SetGCYoungThreshold(JS_GetRuntime(ctx), v);
+    return JS_UNDEFINED;
+}
+
+static JSValue js_runtime_executePendingJobs(JSContext *ctx, JSValueConst this_val,
+                                             int argc, JSValueConst *argv)
+{
+    JSContext *ctx1;
+    int max_jobs, ret;
+
+    if (JS_ToInt32(ctx, &max_jobs, argv[0]))
+        return JS_EXCEPTION;
+    ret = JS_ExecutePendingJobs(JS_GetRuntime(ctx), max_jobs, &ctx1);
+    if (ret < 0)
+        return JS_EXCEPTION;
+    return JS_NewInt32(ctx, ret);
+}
+
+static const JSCFunctionListEntry js_runtime_funcs[] = {
+    JS_CFUNC_DEF("memoryUsage", 0, js_runtime_memoryUsage ),
+    JS_CFUNC_DEF("setGCThreshold", 1, js_runtime_setGCThreshold ),
+    JS_CFUNC_DEF("setGCYoungThreshold", 1, js_runtime_setGCYoungThreshold ),
+    JS_CFUNC_DEF("executePendingJobs", 1, js_runtime_executePendingJobs ),
+};
+
+static int js_runtime_init(JSContext *ctx, JSModuleDef *m)
+{
+    return JS_SetModuleExportList(ctx, m, js_runtime_funcs,
+                                  countof(js_runtime_funcs));
+}
+
+#ifdef JS_SHARED_LIBRARY
+#define JS_INIT_MODULE js_init_module
+#else
+#define JS_INIT_MODULE js_init_module_runtime
+#endif
+
+JSModuleDef *JS_INIT_MODULE(JSContext *ctx, const char *module_name)
+{
+    JSModuleDef *m;
+    m = JS_NewCModule(ctx, module_name, js_runtime_init);
+    if (!m)
+        return NULL;
+    JS_AddModuleExportList(ctx, m, js_runtime_funcs, countof(js_runtime_funcs));
+    return m;
+}
@@ -99,6 +99,49 @@ function test_bigint1()
     assert(r, 4294967296n, "1 << 32n === 4294967296n");
 }
 
+/* values around the int64 limits */
+function test_bigint_short()
+{
+    var a, b, m;
+
+    a = 2n ** 63n - 1n;
+    assert(a.toString(), "9223372036854775807");
+    assert((a + 1n).toString(), "9223372036854775808");
+    assert(a + 1n - 1n === a);
+    assert(-a - 1n === -(2n ** 63n));
+    assert((-a - 2n).toString(), "-9223372036854775809");
+    assert(a * 2n / 2n === a);
+    assert((-a - 1n) / -1n === a + 1n);
+    assert((-a - 1n) % -1n === 0n);
+    assert(-7n / 2n === -3n);
+    assert(-7n % 2n === -1n);
+    assert(1n << 63n === a + 1n);
+    assert(1n << 62n === 2n ** 62n);
+    assert(-1n >> 100n === -1n);
+    assert((a + 1n) >> 1n === 2n ** 62n);
+    assert(~a === -a - 1n);
+    assert((-5n & 0xffn) === 251n);
+    assert(BigInt.asUintN(64, -1n) === 2n ** 64n - 1n);
+    assert(BigInt.asIntN(64, 2n ** 64n - 1n) === -1n);
+
+    b = 2n ** 64n;
+    assert(b / 2n ** 32n === 2n ** 32n);
+    assert(b - b === 0n);
+    assert(Object.is(b - b, 0n));
+
+    m = new Map();
+    m.set(2n ** 70n / 2n ** 10n, 1);
+    assert(m.get(2n ** 60n), 1);
+    m.set(-(2n ** 64n), 2);
+    assert(m.get(-(2n ** 64n)), 2);
+
+    a = new BigInt64Array([1n, -(2n ** 63n)]);
+    assert(a.indexOf(-(2n ** 63n)), 1);
+    a = new BigUint64Array([1n, 2n ** 64n - 1n]);
+    assert(a.indexOf(2n ** 64n - 1n), 1);
+    assert(a.indexOf(-1n), -1);
+}
+
 function test_bigint2()
 {
     assert(BigInt(""), 0n);
@@ -320,6 +363,7 @@ function test_bigdecimal()
 }
 
 test_bigint1();
+test_bigint_short();
 test_bigint2();
 test_bigint_ext();
 test_bigfloat();
@@ -153,7 +153,7 @@ function test_enum()
 
 function test_array()
 {
-    var a, err;
+    var a, err, i;
 
     a = [1, 2, 3];
     assert(a.length, 3, "array");
@@ -193,11 +193,24 @@ function test_array()
         err = true;
     }
     assert(err && a.toString() === "1,2,3,4");
+
+    a = [10, 9, 1, -1, -10, -2, 100, 0, 21, 3, 30, 300, 299];
+    assert(a.sort().join(), "-1,-10,-2,0,1,10,100,21,299,3,30,300,9");
+    a = ["b", undefined, "a", "ab", ""];
+    assert(a.sort().join(), ",a,ab,b,");
+    a = [];
+    for(i = 0; i < 100; i++)
+        a.push({ k: i % 3, i: i });
+    a.sort(function(x, y) { return x.k - y.k; });
+    for(i = 1; i < a.length; i++) {
+        assert(a[i - 1].k < a[i].k ||
+               (a[i - 1].k == a[i].k && a[i - 1].i < a[i].i), true, "stable");
+    }
 }
 
 function test_string()
 {
-    var a;
+    var a, i;
     a = String("abc");
     assert(a.length, 3, "string");
     assert(a[1], "b", "string");
@@ -302,6 +315,20 @@ function test_string()
     assert(eval('"\0"'), "\0");
 
     assert("abc".padStart(Infinity, ""), "abc");
+
+    /* long strings, to cover the vectorized loops and their tails */
+    for(i = 0; i < 40; i++) {
+        a = "a".repeat(i);
+        assert((a + "b").indexOf("b"), i);
+        assert((a + "\u0101").indexOf("\u0101"), i);
+        assert((a + "\u0101" + a + "b").indexOf("b"), 2 * i + 1);
+        assert((a + "\u0101" + a + "b").lastIndexOf("a" + "b"), i > 0 ? 2 * i : -1);
+        assert((a + "b") < (a + "c"), true);
+        assert(("\u0101" + a + "b") > ("\u0101" + a + "a"), true);
+        assert(("\u0101" + a + "b") === ("\u0101" + a + "b"), true);
+        assert((a + "\u00e9").split("\u00e9")[0], a);
+        assert((a + "\u0101").substring(0, i), a);
+    }
 }
 
 function test_math()
@@ -452,6 +479,24 @@ function test_typed_array()
     assert(a.toString(), "1,2,3,4");
     a.set([10, 11], 2);
     assert(a.toString(), "1,2,10,11");
+
+    /* radix sort */
+    a = new Float64Array(300);
+    for(i = 0; i < a.length; i++)
+        a[i] = (i * 37) % 300 - 150;
+    a[1] = NaN;
+    a[2] = -0;
+    a.sort();
+    assert(a[0], -150);
+    assert(1 / a[148], -Infinity);
+    assert(1 / a[149], Infinity);
+    assert(a[298], 149);
+    assert(isNaN(a[299]));
+    a = new Int16Array(300);
+    for(i = 0; i < a.length; i++)
+        a[i] = (i * 37) % 300 - 150;
+    a.sort();
+    assert(a[0] == -150 && a[150] == 0 && a[299] == 149);
 }
 
 function test_json()
@@ -477,6 +522,34 @@ function test_json()
   3
  ]
 ]`);
+
+    /* records with the same property names */
+    a = JSON.parse('[{"a":1,"b":"x"},{"a":2,"b":"y"},{"b":3,"a":4},{"a":5,"a":6}]');
+    assert(a[1].a, 2);
+    assert(a[1].b, "y");
+    assert(Object.keys(a[2]).join(), "b,a");
+    assert(Object.keys(a[3]).join(), "a");
+    assert(a[3].a, 6);
+    a[1].c = 1;
+    assert(Object.keys(a[0]).join(), "a,b");
+    a = JSON.parse('{"__proto__":1}');
+    assert(Object.getPrototypeOf(a), Object.prototype);
+    assert(Object.keys(a).join(), "__proto__");
+
+    assert(JSON.parse("[123456789,-123456789,1234567890,-0,1.5,1e2]").join(),
+           "123456789,-123456789,1234567890,0,1.5,100");
+    assert(1 / JSON.parse("-0"), -Infinity);
+
+    assert(JSON.stringify({a:"x\"\n\u0001\ud800é", b:[1.5,NaN,undefined,
+                                                     function(){}],
+                           c:undefined, d:Symbol(), 1:2}),
+           '{"1":2,"a":"x\\"\\n\\u0001\\ud800é","b":[1.5,null,null,null]}');
+    a = {x:{}};
+    a.x.y = a;
+    assert_throws(TypeError, () => JSON.stringify(a));
+    Array.prototype.toJSON = function() { return 1; };
+    assert(JSON.stringify({a:[]}), '{"a":1}');
+    delete Array.prototype.toJSON;
 }
 
 function test_date()
@@ -600,6 +673,29 @@ function test_map()
     });
 
     assert(a.size, 0);
+
+    a = new Map([[1, "a"], [1.0, "b"], [-0, "c"], [NaN, "d"], ["1", "e"]]);
+    assert(a.size, 4);
+    assert(a.get(1), "b");
+    assert(a.get(0), "c");
+    assert(a.get(0 / 0), "d");
+    assert(a.get("1"), "e");
+
+    /* iterator live while the records are compacted */
+    a = new Set();
+    for(i = 0; i < 10; i++)
+        a.add(i);
+    o = a.values();
+    assert(o.next().value, 0);
+    for(i = 0; i < 100; i++) {
+        a.delete(i);
+        a.add(i + 100);
+    }
+    assert(o.next().value, 100);
+    a.clear();
+    a.add(1);
+    assert(o.next().value, 1);
+    assert(o.next().done, true);
 }
 
 function test_weak_map()
@@ -667,6 +763,60 @@ function test_generator()
     assert(v.value === undefined && v.done === true);
 }
 
+/* interleaving of await chains on plain values, native promises and
+   thenables. The result is checked when all the jobs have run. An
+   exception in a job does not change the exit status of qjs, so the
+   failure exits explicitly. */
+function test_async_order()
+{
+    var log = [];
+    var thenable = { then(resolve) { log.push("then"); resolve("t"); } };
+
+    async function f1() {
+        var v;
+        log.push("f1");
+        v = await 1;
+        log.push("f1:" + v);
+        v = await Promise.resolve(2);
+        log.push("f1:" + v);
+        v = await thenable;
+        log.push("f1:" + v);
+        return "r1";
+    }
+    async function f2() {
+        var v;
+        log.push("f2");
+        v = await Promise.resolve("a");
+        log.push("f2:" + v);
+        v = await f3();
+        log.push("f2:" + v);
+        try {
+            await Promise.reject("e");
+        } catch (e) {
+            log.push("f2:catch " + e);
+        }
+        return "r2";
+    }
+    async function f3() {
+        await null;
+        log.push("f3");
+        return "b";
+    }
+
+    Promise.resolve().then(() => log.push("p1")).then(() => log.push("p2"))
+        .then(() => log.push("p3")).then(() => log.push("p4"));
+    Promise.all([f1(), f2()]).then(function (r) {
+        log.push(r.join("+"));
+        assert(log.join(","),
+               "f1,f2,sync,p1,f1:1,f2:a,p2,f1:2,f3,p3,then,f2:b,p4," +
+               "f1:t,f2:catch e,r1+r2");
+    }).catch(function (e) {
+        print(e);
+        import("std").then(function (std) { std.exit(1); });
+    });
+    log.push("sync");
+}
+
 test();
 test_function();
 test_enum();
@@ -683,3 +833,4 @@ test_symbol();
 test_map();
 test_weak_map();
 test_generator();
+test_async_order();
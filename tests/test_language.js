@@ -220,11 +220,21 @@ function test_op2()
 
 function test_delete()
 {
-    var a, err;
+    var a, err, i;
 
     a = {x: 1, y: 1};
     assert((delete a.x), true, "delete");
     assert(("x" in a), false, "delete");
+
+    /* small objects get a hash table when they grow and lose it when
+       they are compacted */
+    a = {};
+    for(i = 0; i < 20; i++)
+        a["p" + i] = i;
+    for(i = 0; i < 18; i++)
+        assert((delete a["p" + i]), true, "delete");
+    assert(Object.keys(a).toString(), "p18,p19");
+    assert(a.p19 === 19 && !("p0" in a), true, "delete");
     
     /* the following are not tested by test262 */
     assert(delete "abc"[100], true);
@@ -266,6 +276,17 @@ function test_arguments()
         assert(arguments[1], 3, "arguments");
     }
     f2(1, 3);
+
+    /* the parameters are aliased in the mapped arguments only */
+    function f3(a) { a = 2; return arguments[0]; }
+    function f4(a) { "use strict"; a = 2; return arguments[0]; }
+    function f5(a, b) { return arguments[arguments.length - 1]; }
+    function f6() { return arguments["0"] + typeof arguments[1] + arguments[-1]; }
+    assert(f3(1), 2);
+    assert(f4(1), 1);
+    assert(f5(1), 1);
+    assert(f5(1, 2, 3), 3);
+    assert(f6(1), "1undefinedundefined");
 }
 
 function test_class()
@@ -357,6 +378,17 @@ function test_object_literal()
 
     a = { x, get, set, async };
     assert(JSON.stringify(a), '{"x":0,"get":1,"set":2,"async":3}');
+
+    /* objects created from the same literal share the property layout */
+    for(var i = 0; i < 2; i++) {
+        a = { b: i, 1: i + 1, c: function() {} };
+        a.d = 3;
+        delete a.b;
+    }
+    assert(JSON.stringify(a), '{"1":2,"d":3}');
+    assert(a.c.name, "c");
+    a = { b: 1, b: 2, c: 3 };
+    assert(JSON.stringify(a), '{"b":2,"c":3}');
 }
 
 function test_regexp_skip()
@@ -395,6 +427,16 @@ function test_spread()
 
     x = [ ...[ , ] ];
     assert(Object.getOwnPropertyNames(x).toString(), "0,length");
+
+    x = [1, 2, 3];
+    assert([ , ...x].toString(), ",1,2,3");
+    x.length = 4;
+    assert(Math.max(...x.slice(0, 3), 0), 3);
+    assert([...x].length, 4);
+    x = [1, 2];
+    x.push.apply(x, x);
+    assert(x.toString(), "1,2,1,2");
+    assert(((...a) => a.length)(...x, ...x), 8);
 }
 
 function test_function_length()
@@ -526,6 +568,187 @@ function test_function_expr_name()
     assert_throws(TypeError, f);
 }
 
+function test_property_cache()
+{
+    var i, r, a, o, proto;
+
+    function get_x(o) { return o.x; }
+    function set_x(o, v) { o.x = v; }
+
+    /* polymorphic own properties */
+    a = [ { x: 1 }, { y: 0, x: 2 }, { z: 0, y: 0, x: 3 },
+          { w: 0, z: 0, y: 0, x: 4 }, { v: 0, x: 5 } ];
+    r = 0;
+    for(i = 0; i < 50; i++)
+        r += get_x(a[i % a.length]);
+    assert(r, 150);
+
+    /* property in the prototype, then shadowed and deleted */
+    proto = { x: 10 };
+    o = Object.create(proto);
+    for(i = 0; i < 3; i++)
+        assert(get_x(o), 10);
+    proto.x = 11;
+    assert(get_x(o), 11);
+    o.x = 12;
+    assert(get_x(o), 12);
+    delete o.x;
+    assert(get_x(o), 11);
+    Object.defineProperty(proto, "x", { get: function() { return 13; } });
+    assert(get_x(o), 13);
+    Object.setPrototypeOf(o, { x: 14 });
+    assert(get_x(o), 14);
+
+    /* setters and read-only properties */
+    o = { x: 1 };
+    for(i = 0; i < 3; i++)
+        set_x(o, i);
+    assert(o.x, 2);
+    Object.defineProperty(o, "x", { writable: false });
+    set_x(o, 5);
+    assert(o.x, 2);
+    o = { set x(v) { this.y = v; } };
+    set_x(o, 6);
+    assert(o.y, 6);
+
+    /* arrays and primitives */
+    a = [1, 2];
+    assert(a.push(3), 3);
+    assert(get_x(1), undefined);
+    assert("abc".length, 3);
+}
+
+function test_global_var_cache()
+{
+    var i;
+
+    function get_g() { return test_global_g; }
+    function set_g(v) { test_global_g = v; }
+    function set_g_strict(v) { "use strict"; test_global_g = v; }
+
+    globalThis.test_global_g = 1;
+    for(i = 0; i < 3; i++)
+        assert(get_g(), 1);
+    set_g(2);
+    assert(get_g(), 2);
+    set_g_strict(3);
+    assert(get_g(), 3);
+
+    delete globalThis.test_global_g;
+    assert_throws(ReferenceError, get_g);
+    assert_throws(ReferenceError, set_g_strict);
+
+    Object.defineProperty(globalThis, "test_global_g",
+                          { value: 4, writable: true, configurable: true });
+    assert(get_g(), 4);
+    Object.defineProperty(globalThis, "test_global_g", { writable: false });
+    set_g(5);
+    assert(get_g(), 4);
+    assert_throws(TypeError, set_g_strict);
+    Object.defineProperty(globalThis, "test_global_g",
+                          { get: function() { return 6; } });
+    assert(get_g(), 6);
+    delete globalThis.test_global_g;
+}
+
+function test_string_append()
+{
+    var s, t, i;
+
+    function append_closure(n) {
+        var r = "";
+        function f(x) { r = r + x; }
+        for(var i = 0; i < n; i++)
+            f("ab");
+        return r;
+    }
+
+    function append_arg(a, b) {
+        a = a + b;
+        return arguments[0];
+    }
+
+    s = "";
+    for(i = 0; i < 1000; i++)
+        s += "x" + (i % 10);
+    assert(s.length, 2000);
+    assert(s.substring(18, 22), "x9x0");
+
+    /* a copy of the string must not be modified */
+    t = s;
+    s += "end";
+    assert(t.length, 2000);
+    assert(s.length, 2003);
+
+    /* 8 bit and 16 bit characters */
+    s = "\u0100";
+    for(i = 0; i < 100; i++)
+        s = s + "a";
+    assert(s.length, 101);
+    assert(s.charCodeAt(100), 0x61);
+    s = "a";
+    for(i = 0; i < 100; i++)
+        s = s + "\u0100";
+    assert(s.length, 101);
+    assert(s.charCodeAt(100), 0x100);
+
+    assert(append_closure(100).length, 200);
+    assert(append_arg("a", "b"), "ab");
+}
+
+function test_constant_folding()
+{
+    var a, i, f;
+
+    assert(3 * 4 + 1, 13);
+    assert(-3 * 4, -12);
+    assert(1 / (0 * -1), -Infinity);
+    assert(2147483647 + 1, 2147483648);
+    assert(65536 * 65536, 4294967296);
+    assert(1 << 31, -2147483648);
+    assert(1 << 33, 2);
+    assert(-8 >> 1, -4);
+    assert("ab" + "cd" + "e", "abcde");
+    assert("a" + 1 + 2, "a12");
+    a = { ["k" + "x"]: 1, [1 + 1]: 2 };
+    assert(a.kx, 1);
+    assert(a[2], 2);
+
+    /* TDZ checks must be kept when the variable may be uninitialized */
+    assert_throws(ReferenceError, function() { var r = x; let x = 1; return r; });
+    a = [];
+    for(i = 0; i < 2; i++) {
+        f = function() { return y; };
+        assert_throws(ReferenceError, f);
+        let y = i;
+        a.push(f() + y);
+    }
+    assert(a.join(), "0,2");
+}
+
+function test_tail_call()
+{
+    "use strict";
+    var a, o;
+
+    function count(n, acc) { if (n === 0) return acc; return count(n - 1, acc + 1); }
+    function even(n) { return n === 0 ? true : odd(n - 1); }
+    function odd(n) { return n === 0 ? false : even(n - 1); }
+    function more(a) { if (a === 0) return arguments.length; return more(a - 1, 1, 2, 3); }
+    function fewer(a, b, c, d) { if (a === 0) return [b, c, d].join(); return fewer(a - 1, 1); }
+    function clos(n, fs) { let v = n; fs.push(() => v); if (n === 0) return fs; return clos(n - 1, fs); }
+
+    /* the frame is reused: no stack overflow */
+    assert(count(1000000, 0), 1000000);
+    assert(even(100001), false);
+    o = { n: 0, step(k) { if (k === 0) return this.n; this.n++; return this.step(k - 1); } };
+    assert(o.step(100000), 100000);
+    assert(more(10), 4);
+    assert(fewer(10, 1, 2, 3), "1,,");
+    a = clos(3, []);
+    assert(a.map(f => f()).join(), "3,2,1,0");
+}
+
 test_op1();
 test_cvt();
 test_eq();
@@ -545,3 +768,8 @@ test_spread();
 test_function_length();
 test_argument_scope();
 test_function_expr_name();
+test_property_cache();
+test_global_var_cache();
+test_string_append();
+test_constant_folding();
+test_tail_call();
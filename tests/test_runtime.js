@@ -0,0 +1,88 @@
+import * as rt from "./runtime.so";
+
+function assert(actual, expected, message) {
+    if (arguments.length == 1)
+        expected = true;
+
+    if (actual === expected)
+        return;
+
+    throw Error("assertion failed: got |" + actual + "|" +
+                ", expected |" + expected + "|" +
+                (message ? " (" + message + ")" : ""));
+}
+
+/* allocate 'n' objects which are freed immediately */
+function churn(n)
+{
+    var i, o;
+    for(i = 0; i < n; i++)
+        o = {};
+}
+
+/* old objects released by young garbage must be freed by the young
+   collections */
+function test_young_gc()
+{
+    var arr, a, b, u0, u1, i, n = 20000;
+
+    rt.setGCThreshold(2 ** 52); /* no full collection */
+    rt.setGCYoungThreshold(1000);
+
+    arr = [];
+    for(i = 0; i < n; i++)
+        arr.push({ i: i });
+    churn(2000); /* 'arr' and its elements become old */
+
+    /* young cycle holding the only reference to 'arr' */
+    a = {};
+    b = { a: a, arr: arr };
+    a.b = b;
+    arr = null;
+
+    u0 = rt.memoryUsage();
+    a = b = null;
+    churn(2000);
+    u1 = rt.memoryUsage();
+
+    assert(u1.gc_count, u0.gc_count, "full collection");
+    assert(u1.gc_young_count > u0.gc_young_count, true, "young collection");
+    assert(u1.obj_count < u0.obj_count - n, true,
+           "obj_count " + u0.obj_count + " -> " + u1.obj_count);
+}
+
+function test_job_budget()
+{
+    var log = [], i;
+
+    for(i = 0; i < 5; i++)
+        Promise.resolve(i).then(function (v) { log.push(v); });
+    assert(rt.executePendingJobs(2), 2);
+    assert(log.join(), "0,1");
+    assert(rt.executePendingJobs(-1), 3);
+    assert(log.join(), "0,1,2,3,4");
+    assert(rt.executePendingJobs(-1), 0);
+}
+
+/* the memory of the job queue is released only after several drains
+   not using it */
+function test_job_queue_shrink()
+{
+    var s0, s1, s2, i, n = 10000;
+
+    s0 = rt.memoryUsage().malloc_size;
+    for(i = 0; i < n; i++)
+        Promise.resolve(i).then(function () {});
+    assert(rt.executePendingJobs(-1), n);
+    s1 = rt.memoryUsage().malloc_size;
+    assert(s1 - s0 > n * 16, true, "queue released by the drain");
+    for(i = 0; i < 200; i++)
+        rt.executePendingJobs(-1);
+    s2 = rt.memoryUsage().malloc_size;
+    assert(s2 - s0 < (s1 - s0) / 8, true,
+           "queue not released " + s1 + " -> " + s2);
+}
+
+test_young_gc();
+test_job_budget();
+test_job_queue_shrink();
@@ -77,6 +77,41 @@ function test_file2()
     f.close();
 }
 
+function test_utf8()
+{
+    var f, str, tab, i, size;
+    tab = [ "\u00e9", "a\u00e9", "caf\u00e9 ".repeat(10),
+            "\u65e5\u672c\u8a9e".repeat(10), "a\ud83d\ude00b",
+            "x".repeat(40) + "\u00ff\u0100" ];
+    for(i = 0; i < tab.length; i++) {
+        str = tab[i];
+        f = std.tmpfile();
+        f.puts(str);
+        size = f.tell();
+        f.seek(0, std.SEEK_SET);
+        assert(f.readAsString(), str);
+        f.close();
+        assert(size, unescape(encodeURIComponent(str)).length);
+    }
+
+    /* unmatched surrogates are kept */
+    f = std.tmpfile();
+    f.puts("a\ud800b");
+    assert(f.tell(), 5);
+    f.seek(0, std.SEEK_SET);
+    assert(f.readAsString(), "a\ud800b");
+    f.close();
+
+    /* invalid sequences */
+    f = std.tmpfile();
+    tab = [ 0x61, 0xff, 0x62, 0xc3, 0x63, 0xe0, 0x80, 0x80, 0x64 ];
+    for(i = 0; i < tab.length; i++)
+        f.putByte(tab[i]);
+    f.seek(0, std.SEEK_SET);
+    assert(f.readAsString(), "a\ufffdb\ufffdc\ufffdd");
+    f.close();
+}
+
 function test_getline()
 {
     var f, line, line_count, lines, i;
@@ -273,6 +308,7 @@ function test_timer()
 test_printf();
 test_file1();
 test_file2();
+test_utf8();
 test_getline();
 test_popen();
 test_os();